@@ -372,6 +372,21 @@ pub unsafe extern "C" fn astonia_net_send(
     }
 }
 
+/// # Safety
+/// Safe if sock is valid when passed in. It can be null, but it has to always
+/// be valid (the caller must not free it, and leave freeing up to
+/// astonia_net_close). If a null pointer is passed, we will return -1.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn astonia_net_set_nodelay(sock: *mut AstoniaSock, on: c_int) -> c_int {
+    let Some(s) = (unsafe { sock.as_mut() }) else {
+        return -1;
+    };
+    match s.mio.set_nodelay(on != 0) {
+        Ok(()) => 0,
+        Err(_) => -1,
+    }
+}
+
 /// # Safety
 /// Safe if sock is valid when passed in. It can be null, but it has to always
 /// be valid (the caller must not free it, and leave freeing up to
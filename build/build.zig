@@ -54,6 +54,7 @@ pub fn build(b: *std.Build) void {
         "src/gui/context.c",
         "src/gui/hover.c",
         "src/gui/minimap.c",
+        "src/gui/mapdb.c",
 
         // CLIENT
         "src/client/client.c",
@@ -71,14 +72,19 @@ pub fn build(b: *std.Build) void {
         "src/game/memory.c",
         "src/game/sprite.c",
         "src/game/sprite_config.c",
+        "src/game/profile.c",
+        "src/game/logging.c",
 
         // MODDER core
         "src/modder/modder.c",
+        "src/modder/telemetry.c",
 
         // SDL layer
         "src/sdl/sdl_core.c",
         "src/sdl/sdl_texture.c",
         "src/sdl/sdl_image.c",
+        "src/sdl/sdl_smooth.c",
+        "src/sdl/sdl_gx.c",
         "src/sdl/sdl_effects.c",
         "src/sdl/sdl_draw.c",
         "src/sdl/sound.c",
@@ -23,6 +23,11 @@ ptrdiff_t astonia_net_recv(astonia_sock *s, void *dst, size_t cap);
    Returns >0 = bytes sent, 0 = treated as closed, -1 = would-block/error. */
 ptrdiff_t astonia_net_send(astonia_sock *s, const void *src, size_t len);
 
+/* Enable (on != 0) or disable TCP_NODELAY. The client batches its commands
+   once per frame, so Nagle's algorithm only adds latency to those writes.
+   Returns 0 on success, -1 on error. */
+int astonia_net_set_nodelay(astonia_sock *s, int on);
+
 /* If the local address is IPv4, write it (network byte order) to *out_be.
    Returns 0 on success, -1 on error or if local address is IPv6. */
 int astonia_net_local_ipv4(astonia_sock *s, uint32_t *out_be);
@@ -0,0 +1,71 @@
+#pragma once
+#include <stdint.h>
+
+/* Telemetry the client publishes in shared memory for overlays and monitoring
+   tools. The region is the POSIX shared memory object "/moac-<pid>" (Linux,
+   macOS) or the file mapping "MOACT<pid>" (Windows), sizeof(struct telemetry)
+   bytes, updated once per displayed frame. The client only publishes it when
+   started with option bit 20 (GO_TELEMETRY) set.
+
+   Readers map it read-only and copy what they need under the seqlock:
+
+       do {
+           do seq = __atomic_load_n(&t->seq, __ATOMIC_ACQUIRE); while (seq & 1);
+           copy fields
+           __atomic_thread_fence(__ATOMIC_ACQUIRE);
+       } while (__atomic_load_n(&t->seq, __ATOMIC_RELAXED) != seq);
+
+   Check magic and version before anything else. Later versions only append
+   fields, size is the number of bytes the client filled in. */
+
+#define TELEMETRY_MAGIC   0x43414f4du /* "MOAC" */
+#define TELEMETRY_VERSION 1u
+
+#define TELEMETRY_DIST 12 /* tiles around the player in the map view */
+#define TELEMETRY_DIM  (TELEMETRY_DIST * 2 + 1)
+
+struct telemetry_tile {
+	uint16_t gsprite; /* ground */
+	uint16_t fsprite; /* foreground */
+	uint32_t isprite; /* item */
+	uint32_t csprite; /* character, 0 if none */
+	uint32_t flags; /* CMF_* */
+	uint8_t health; /* character health in percent */
+	uint8_t light; /* 0 invisible, 1 dark to 15 bright */
+	uint8_t pad[2];
+};
+
+struct telemetry {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	uint32_t pid;
+	uint32_t seq; /* odd while the client is writing */
+	uint32_t connected; /* logged in and receiving ticks */
+
+	/* player */
+	uint32_t tick;
+	uint16_t originx, originy; /* map position of the view center */
+	uint16_t hp, hp_max;
+	uint16_t mana, mana_max;
+	uint16_t endurance, endurance_max;
+	uint16_t lifeshield, rage;
+	uint32_t experience;
+	uint32_t gold;
+
+	/* performance */
+	uint32_t fps; /* target frames per second */
+	uint32_t frametime; /* ms between the last two frames */
+	uint32_t ticktime; /* ms between the last two ticks */
+	uint32_t tick_interval; /* ms between the last two tick batches from the server */
+	uint32_t tick_queue; /* ticks received but not yet shown */
+	uint32_t pad0;
+	uint64_t frames; /* since start */
+	uint64_t texc_hit; /* texture cache lookups since start */
+	uint64_t texc_miss;
+	uint64_t texc_pre; /* misses that were prefetches */
+	uint64_t mem_used; /* bytes held by the client allocator */
+
+	/* map view, TELEMETRY_DIM rows of TELEMETRY_DIM tiles, player in the middle */
+	struct telemetry_tile map[TELEMETRY_DIM * TELEMETRY_DIM];
+};
@@ -121,8 +121,9 @@ DLL_IMPORT unsigned int csprite; // and sprite
 
 DLL_IMPORT int originx;
 DLL_IMPORT int originy;
-DLL_IMPORT struct map map[MAPDX * MAPDY];
-DLL_IMPORT struct map map2[MAPDX * MAPDY];
+DLL_IMPORT unsigned int map_dist;
+DLL_IMPORT struct map *map; // MAPDX * MAPDY tiles
+DLL_IMPORT struct map *map2;
 
 DLL_IMPORT int value[2][V_MAX];
 DLL_IMPORT int item[MAX_INVENTORYSIZE];
@@ -23,10 +23,11 @@
 #endif
 
 #define V_MAX 200
-#define DIST  ((unsigned int)25)
-#define MAPDX (DIST * 2 + 1)
-#define MAPDY (DIST * 2 + 1)
-#define MAXMN (MAPDX * MAPDY)
+#define DIST     (map_dist) // view distance, chosen at login
+#define DIST_MAX 60u
+#define MAPDX    (DIST * 2 + 1)
+#define MAPDY    (DIST * 2 + 1)
+#define MAXMN    ((DIST_MAX * 2 + 1) * (DIST_MAX * 2 + 1)) // no tile, past the end of any map
 
 #define V3_INVENTORYSIZE 110
 #define V3_CONTAINERSIZE (V3_INVENTORYSIZE)
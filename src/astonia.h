@@ -45,7 +45,11 @@ typedef int32_t svval_t; // skill index, server side (V3_HP, V3_BLESS *or* V35_H
 #define MPT    (1000 / TICKS) // milliseconds per tick
 #define MPF    (1000 / FRAMES) // milliseconds per frame
 
-#define DIST ((unsigned int)25)
+#define TICK_FRAC 1024 // fixed point base for the position of a frame between two ticks
+
+#define DIST         (map_dist) // view distance of map, it is DIST*2+1 tiles wide
+#define DIST_DEFAULT 25u // view distance until the server agrees to another one
+#define DIST_MAX     60u // largest view distance the client will handle
 #define FDX  40 // width of a map tile
 #define FDY  20 // height of a map tile
 
@@ -139,6 +143,7 @@ typedef int32_t svval_t; // skill index, server side (V3_HP, V3_BLESS *or* V35_H
 DLL_EXPORT extern int __yres;
 extern int quit;
 DLL_EXPORT extern int frames_per_second;
+DLL_EXPORT extern unsigned int map_dist;
 extern char *localdata;
 
 #define GO_DARK       (1ull << 0) // Dark GUI by Tegra
@@ -161,6 +166,7 @@ extern char *localdata;
 #define GO_LOWLIGHT   (1ull << 17) // Simplify Light calculations for slow CPUs
 #define GO_NOMAP      (1ull << 18) // Disable minimap completely
 #define GO_WHEELSPEED (1ull << 19) // Mouse wheel toggles movement speed (fast/normal/stealth)
+#define GO_TELEMETRY  (1ull << 20) // Publish telemetry in shared memory for overlays (include/astonia_telemetry.h)
 
 #define GO_NOTSET (1ull << 63) // No -o given on command line
 
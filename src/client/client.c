@@ -24,6 +24,9 @@
 #include "gui/gui.h"
 #include "modder/modder.h"
 #include "protocol.h"
+#include "game/profile.h"
+
+void resize_game(void);
 
 unsigned int display_gfx = 0;
 uint32_t display_time = 0;
@@ -69,6 +72,13 @@ static unsigned char inbuf[MAX_INBUF];
 static size_t outused;
 static unsigned char outbuf[MAX_OUTBUF];
 
+// Commands queued since the last flush start at outmark. Everything before it
+// may already be partially on the wire and must not be touched.
+static size_t outmark;
+static size_t lastcmd_off = SIZE_MAX; // offset of the newest command in this batch
+static size_t lastcmd_len;
+int coalesced_cmds = 0; // commands merged into a queued one since startup
+
 DLL_EXPORT uint16_t act;
 DLL_EXPORT uint16_t actx;
 DLL_EXPORT uint16_t acty;
@@ -78,8 +88,25 @@ DLL_EXPORT unsigned int csprite; // and sprite
 
 DLL_EXPORT uint16_t originx;
 DLL_EXPORT uint16_t originy;
-DLL_EXPORT struct map map[MAPDX * MAPDY];
-DLL_EXPORT struct map map2[MAPDX * MAPDY];
+DLL_EXPORT struct map *map;
+DLL_EXPORT struct map *map2;
+
+// map2 is decoded ahead of map, so it switches to a new view distance a few
+// ticks earlier. DIST (map_dist) is the size of map and of the quick list.
+DLL_EXPORT unsigned int map_dist = DIST_DEFAULT;
+unsigned int map2_dist = DIST_DEFAULT;
+DLL_EXPORT unsigned int want_dist = DIST_DEFAULT; // asked of the server after login
+
+// Tiles holding a character, one index each for map and map2. Kept up to date
+// by the protocol decoders so the per-tick passes don't walk the whole map.
+struct map_live {
+	map_index_t *mn;
+	map_index_t *old; // scratch for map_live_move()
+	unsigned short *pos; // position in mn plus one, 0 if not listed
+	int cnt;
+};
+
+static struct map_live map_live, map2_live;
 
 DLL_EXPORT uint16_t value[2][V_MAX];
 DLL_EXPORT uint32_t item[MAX_INVENTORYSIZE];
@@ -123,17 +150,85 @@ DLL_EXPORT int frames_per_second = TICKS;
 DLL_EXPORT int _inventorysize = V3_INVENTORYSIZE;
 DLL_EXPORT int _containersize = V3_CONTAINERSIZE;
 
-// Unaligned load/store helpers
+// Commands where a newer one of the same kind replaces the older one still
+// waiting in the batch (only the last move target or speed mode matters).
+static int cmd_supersedes(unsigned char cmd)
+{
+	switch (cmd) {
+	case CL_MOVE:
+	case CL_SPEED:
+	case CL_STOP:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+// Commands that are harmless to drop when an identical copy is already
+// waiting in the batch (mouse spam on the same tile or item).
+static int cmd_dedups(unsigned char cmd)
+{
+	switch (cmd) {
+	case CL_TAKE:
+	case CL_USE:
+	case CL_KILL:
+	case CL_GIVE:
+	case CL_LOOK_MAP:
+	case CL_LOOK_ITEM:
+	case CL_LOOK_CHAR:
+	case CL_LOOK_INV:
+	case CL_LOOK_CONTAINER:
+	case CL_PING:
+	case CL_GETQUESTLOG:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+// Queue a command for the next flush in poll_network(). Commands are batched
+// per frame; a command that supersedes or repeats the newest queued one is
+// merged into it instead of growing the batch.
 DLL_EXPORT void client_send(void *buf, size_t len)
 {
+	const unsigned char *cmd = buf;
+
+	if (!len) {
+		return;
+	}
+
+	if (lastcmd_off != SIZE_MAX && lastcmd_off >= outmark && lastcmd_len == len &&
+	    outbuf[lastcmd_off] == cmd[0]) {
+		if (cmd_supersedes(cmd[0])) {
+			memcpy(outbuf + lastcmd_off, buf, len);
+			coalesced_cmds++;
+			return;
+		}
+		if (cmd_dedups(cmd[0]) && !memcmp(outbuf + lastcmd_off, buf, len)) {
+			coalesced_cmds++;
+			return;
+		}
+	}
+
 	if (len > MAX_OUTBUF - outused) {
 		return;
 	}
 
 	memcpy(outbuf + outused, buf, len);
+	lastcmd_off = outused;
+	lastcmd_len = len;
 	outused += len;
 }
 
+// Close the current command batch. Called once per frame after the send, so
+// anything queued from now on goes out with the next frame.
+static void client_flush_mark(void)
+{
+	outmark = outused;
+	lastcmd_off = SIZE_MAX;
+	lastcmd_len = 0;
+}
+
 void bzero_client(int part)
 {
 	if (part == 0) {
@@ -156,6 +251,7 @@ void bzero_client(int part)
 
 		outused = 0;
 		bzero(outbuf, sizeof(outbuf));
+		client_flush_mark();
 	}
 
 	if (part == 1) {
@@ -168,7 +264,7 @@ void bzero_client(int part)
 
 		originx = 0;
 		originy = 0;
-		bzero(map, sizeof(map));
+		map_resize(DIST_DEFAULT);
 
 		bzero(value, sizeof(value));
 		bzero(item, sizeof(item));
@@ -344,6 +440,10 @@ int poll_network(void)
 		}
 #endif
 
+		// we flush one batch of commands per frame ourselves, so don't let
+		// Nagle hold that batch back waiting for the server's ACK
+		astonia_net_set_nodelay(sock, 1);
+
 		// statechange
 		sockstate = 2;
 	}
@@ -418,6 +518,7 @@ int poll_network(void)
 			outused -= (size_t)n;
 			sent_bytes += n;
 		}
+		client_flush_mark();
 	}
 
 	// recv
@@ -466,25 +567,166 @@ int poll_network(void)
 	return 0;
 }
 
+static struct map_live *map_live_of(struct map *cmap)
+{
+	return cmap == map2 ? &map2_live : &map_live;
+}
+
+// (re)allocates a map for view distance dist, cleared either way
+static void map_alloc(struct map **pmap, struct map_live *l, unsigned int *pdist, unsigned int dist)
+{
+	size_t n = (size_t)(dist * 2 + 1) * (dist * 2 + 1);
+
+	if (*pmap && *pdist == dist) {
+		bzero(*pmap, n * sizeof(struct map));
+		bzero(l->pos, n * sizeof(unsigned short));
+		l->cnt = 0;
+		return;
+	}
+
+	xfree(*pmap);
+	xfree(l->mn);
+	xfree(l->old);
+	xfree(l->pos);
+
+	*pmap = xmalloc(n * sizeof(struct map), MEM_GAME);
+	l->mn = xmalloc(n * sizeof(map_index_t), MEM_GAME);
+	l->old = xmalloc(n * sizeof(map_index_t), MEM_GAME);
+	l->pos = xmalloc(n * sizeof(unsigned short), MEM_GAME);
+	l->cnt = 0;
+
+	*pdist = dist;
+}
+
+void map_init(void)
+{
+	map_alloc(&map, &map_live, &map_dist, map_dist);
+	map_alloc(&map2, &map2_live, &map2_dist, map2_dist);
+}
+
+static void map_free(struct map **pmap, struct map_live *l)
+{
+	xfree(*pmap);
+	*pmap = NULL;
+
+	xfree(l->mn);
+	xfree(l->old);
+	xfree(l->pos);
+	bzero(l, sizeof(*l));
+}
+
+void map_exit(void)
+{
+	map_free(&map, &map_live);
+	map_free(&map2, &map2_live);
+}
+
+// clears map and switches it to view distance dist, the quick list follows
+void map_resize(unsigned int dist)
+{
+	unsigned int old = map_dist;
+
+	map_alloc(&map, &map_live, &map_dist, dist);
+	if (map_dist != old) {
+		resize_game();
+	}
+}
+
+// clears map2 and switches it to view distance dist
+void map2_resize(unsigned int dist)
+{
+	map_alloc(&map2, &map2_live, &map2_dist, dist);
+}
+
+map_index_t map_width(struct map *cmap)
+{
+	return (cmap == map2 ? map2_dist : map_dist) * 2 + 1;
+}
+
+map_index_t map_size(struct map *cmap)
+{
+	return map_width(cmap) * map_width(cmap);
+}
+
+static void map_live_add(struct map_live *l, map_index_t mn)
+{
+	if (l->pos[mn]) {
+		return;
+	}
+	l->mn[l->cnt++] = mn;
+	l->pos[mn] = (unsigned short)l->cnt;
+}
+
+static void map_live_del(struct map_live *l, map_index_t mn)
+{
+	int i;
+
+	if (!l->pos[mn]) {
+		return;
+	}
+	i = l->pos[mn] - 1;
+	l->mn[i] = l->mn[--l->cnt];
+	l->pos[l->mn[i]] = (unsigned short)(i + 1);
+	l->pos[mn] = 0;
+}
+
+// call after changing the character on tile mn
+void map_live_update(struct map *cmap, map_index_t mn)
+{
+	if (mn >= map_size(cmap)) {
+		return;
+	}
+
+	if (cmap[mn].csprite) {
+		map_live_add(map_live_of(cmap), mn);
+	} else {
+		map_live_del(map_live_of(cmap), mn);
+	}
+}
+
+// call after memmove(cmap+dst,cmap+src,cnt*sizeof(struct map)). tiles the move did
+// not overwrite keep their old contents, so their entries stay.
+void map_live_move(struct map *cmap, map_index_t dst, map_index_t src, map_index_t cnt)
+{
+	struct map_live *l = map_live_of(cmap);
+	map_index_t *old = l->old;
+	int i, n;
+
+	n = l->cnt;
+	for (i = 0; i < n; i++) {
+		old[i] = l->mn[i];
+		l->pos[old[i]] = 0;
+	}
+	l->cnt = 0;
+
+	for (i = 0; i < n; i++) {
+		if (old[i] >= src && old[i] < src + cnt) {
+			map_live_add(l, old[i] - src + dst);
+		}
+		if (old[i] < dst || old[i] >= dst + cnt) {
+			map_live_add(l, old[i]);
+		}
+	}
+}
+
 static void auto_tick(struct map *cmap)
 {
-	unsigned int x, y;
+	struct map_live *l = map_live_of(cmap);
 	map_index_t mn;
+	int i;
 
 	// automatically tick map
-	for (y = 0; y < MAPDY; y++) {
-		for (x = 0; x < MAPDX; x++) {
-			mn = mapmn(x, y);
-			if (!(cmap[mn].csprite)) {
-				continue;
-			}
+	for (i = 0; i < l->cnt; i++) {
+		mn = l->mn[i];
+		if (!(cmap[mn].csprite)) {
+			continue;
+		}
 
-			cmap[mn].step++;
-			if (cmap[mn].step < cmap[mn].duration) {
-				continue;
-			}
-			cmap[mn].step = 0;
+		cmap[mn].step++;
+		if (cmap[mn].step < cmap[mn].duration) {
+			continue;
 		}
+		cmap[mn].step = 0;
 	}
 }
 
@@ -518,6 +760,8 @@ tick_t next_tick(void)
 
 	// decompress
 	if (*inbuf & 0x80) {
+		PROF_ZONE("inflate");
+
 		zs.next_in = inbuf + indone;
 		zs.avail_in = (unsigned int)(tick_sz - indone);
 
@@ -116,6 +116,7 @@ typedef enum {
 #define CL_PING           39
 #define CL_GETQUESTLOG    40
 #define CL_REOPENQUEST    41
+#define CL_VIEWDIST       42
 
 #define PAC_IDLE        0
 #define PAC_MOVE        1
@@ -163,7 +164,7 @@ DLL_EXPORT extern int _inventorysize, _containersize;
 
 #define MAPDX (DIST * 2 + 1)
 #define MAPDY (DIST * 2 + 1)
-#define MAXMN (MAPDX * MAPDY)
+#define MAXMN ((DIST_MAX * 2 + 1) * (DIST_MAX * 2 + 1)) // no tile, past the end of any map
 
 #define QF_OPEN 1
 #define QF_DONE 2
@@ -465,8 +466,13 @@ struct client_info {
 	struct client_surface surface[CL_MAX_SURFACE];
 };
 
-DLL_EXPORT extern struct map map[MAPDX * MAPDY];
-DLL_EXPORT extern struct map map2[MAPDX * MAPDY];
+DLL_EXPORT extern struct map *map; // MAPDX * MAPDY tiles
+DLL_EXPORT extern struct map *map2; // same for the prefetch, map2_dist instead of DIST
+extern unsigned int map2_dist;
+DLL_EXPORT extern unsigned int want_dist;
+
+void map_init(void);
+void map_exit(void);
 
 DLL_EXPORT extern uint16_t value[2][V_MAX];
 DLL_EXPORT extern int *game_v_max;
@@ -486,6 +492,7 @@ extern int lasttick; // ticks in inbuf
 extern int q_size;
 extern uint64_t last_tick_received_time; // SDL_GetTicks() when last server tick batch was received
 extern uint64_t tick_receive_interval; // Time between server tick batch arrivals (ms)
+extern int coalesced_cmds; // commands merged into a queued one since startup
 
 DLL_EXPORT extern unsigned int cflags; // current item (item under mouse cursor) flags
 DLL_EXPORT extern unsigned int csprite; // and sprite
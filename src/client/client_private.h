@@ -55,7 +55,7 @@
 #define SV_MIL_EXP          51
 #define SV_QUESTLOG         52
 #define SV_PROTOCOL         53
-#define SV_RESERVED1        54
+#define SV_VIEWDIST         54
 #define SV_RESERVED2        55
 #define SV_RESERVED3        56
 #define SV_RESERVED4        57
@@ -91,6 +91,12 @@ int open_client(char *username, char *password);
 int init_network(void);
 void exit_network(void);
 void bzero_client(int part);
+void map_resize(unsigned int dist);
+void map2_resize(unsigned int dist);
+map_index_t map_size(struct map *cmap);
+map_index_t map_width(struct map *cmap);
+void map_live_update(struct map *cmap, map_index_t mn);
+void map_live_move(struct map *cmap, map_index_t dst, map_index_t src, map_index_t cnt);
 DLL_EXPORT void client_send(void *buf, size_t len);
 void load_unique(void);
 void save_unique(void);
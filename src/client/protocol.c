@@ -20,6 +20,7 @@
 #include "protocol.h"
 #include "sdl/sdl.h"
 #include "sdl/sdl_private.h"
+#include "game/profile.h"
 
 struct otext otext[MAXOTEXT];
 
@@ -43,7 +44,7 @@ static size_t sv_map01(unsigned char *buf, int *last, struct map *cmap)
 		c = load_u16(buf + 1);
 	}
 
-	if (c < 0 || (unsigned int)c > MAPDX * MAPDY) {
+	if (c < 0 || (map_index_t)c >= map_size(cmap)) {
 		fail("sv_map01 illegal call with c=%d\n", c);
 		exit(-1);
 	}
@@ -89,7 +90,7 @@ static size_t sv_map10(unsigned char *buf, int *last, struct map *cmap)
 		c = load_u16(buf + 1);
 	}
 
-	if (c < 0 || (unsigned int)c > MAPDX * MAPDY) {
+	if (c < 0 || (map_index_t)c >= map_size(cmap)) {
 		fail("sv_map10 illegal call with c=%d\n", c);
 		exit(-1);
 	}
@@ -127,6 +128,9 @@ static size_t sv_map10(unsigned char *buf, int *last, struct map *cmap)
 		cmap[c].dir = 0;
 		cmap[c].health = 0;
 	}
+	if (buf[0] & (1 + 8)) {
+		map_live_update(cmap, (map_index_t)c);
+	}
 
 	*last = c;
 
@@ -153,7 +157,7 @@ static size_t sv_map11(unsigned char *buf, int *last, struct map *cmap)
 		c = load_u16(buf + 1);
 	}
 
-	if (c < 0 || (unsigned int)c > MAPDX * MAPDY) {
+	if (c < 0 || (map_index_t)c >= map_size(cmap)) {
 		fail("sv_map11 illegal call with c=%d\n", c);
 		exit(-1);
 	}
@@ -202,6 +206,24 @@ static size_t sv_map11(unsigned char *buf, int *last, struct map *cmap)
 	return p;
 }
 
+#ifdef UNIT_TEST
+// Test-only wrappers to expose the map decoders for benchmarks
+size_t test_sv_map01(unsigned char *buf, int *last, struct map *cmap)
+{
+	return sv_map01(buf, last, cmap);
+}
+
+size_t test_sv_map10(unsigned char *buf, int *last, struct map *cmap)
+{
+	return sv_map10(buf, last, cmap);
+}
+
+size_t test_sv_map11(unsigned char *buf, int *last, struct map *cmap)
+{
+	return sv_map11(buf, last, cmap);
+}
+#endif
+
 static size_t svl_ping(unsigned char *buf)
 {
 	uint32_t t;
@@ -226,48 +248,64 @@ static size_t sv_ping(unsigned char *buf)
 	return 5;
 }
 
+// moves cnt tiles of the map from src to dst, taking the character index along
+static void sv_scroll(struct map *cmap, map_index_t dst, map_index_t src, map_index_t cnt)
+{
+	memmove(cmap + dst, cmap + src, sizeof(struct map) * cnt);
+	map_live_move(cmap, dst, src, cnt);
+}
+
 static void sv_scroll_right(struct map *cmap)
 {
-	memmove(cmap, cmap + 1, sizeof(struct map) * ((DIST * 2 + 1) * (DIST * 2 + 1) - 1));
+	sv_scroll(cmap, 0, 1, map_size(cmap) - 1);
 }
 
 static void sv_scroll_left(struct map *cmap)
 {
-	memmove(cmap + 1, cmap, sizeof(struct map) * ((DIST * 2 + 1) * (DIST * 2 + 1) - 1));
+	sv_scroll(cmap, 1, 0, map_size(cmap) - 1);
 }
 
 static void sv_scroll_down(struct map *cmap)
 {
-	memmove(cmap, cmap + (DIST * 2 + 1), sizeof(struct map) * ((DIST * 2 + 1) * (DIST * 2 + 1) - (DIST * 2 + 1)));
+	sv_scroll(cmap, 0, map_width(cmap), map_size(cmap) - map_width(cmap));
 }
 
 static void sv_scroll_up(struct map *cmap)
 {
-	memmove(cmap + (DIST * 2 + 1), cmap, sizeof(struct map) * ((DIST * 2 + 1) * (DIST * 2 + 1) - (DIST * 2 + 1)));
+	sv_scroll(cmap, map_width(cmap), 0, map_size(cmap) - map_width(cmap));
 }
 
 static void sv_scroll_leftup(struct map *cmap)
 {
-	memmove(
-	    cmap + (DIST * 2 + 1) + 1, cmap, sizeof(struct map) * ((DIST * 2 + 1) * (DIST * 2 + 1) - (DIST * 2 + 1) - 1));
+	sv_scroll(cmap, map_width(cmap) + 1, 0, map_size(cmap) - map_width(cmap) - 1);
 }
 
 static void sv_scroll_leftdown(struct map *cmap)
 {
-	memmove(
-	    cmap, cmap + (DIST * 2 + 1) - 1, sizeof(struct map) * ((DIST * 2 + 1) * (DIST * 2 + 1) - (DIST * 2 + 1) + 1));
+	sv_scroll(cmap, 0, map_width(cmap) - 1, map_size(cmap) - map_width(cmap) + 1);
 }
 
 static void sv_scroll_rightup(struct map *cmap)
 {
-	memmove(
-	    cmap + (DIST * 2 + 1) - 1, cmap, sizeof(struct map) * ((DIST * 2 + 1) * (DIST * 2 + 1) - (DIST * 2 + 1) + 1));
+	sv_scroll(cmap, map_width(cmap) - 1, 0, map_size(cmap) - map_width(cmap) + 1);
 }
 
 static void sv_scroll_rightdown(struct map *cmap)
 {
-	memmove(
-	    cmap, cmap + (DIST * 2 + 1) + 1, sizeof(struct map) * ((DIST * 2 + 1) * (DIST * 2 + 1) - (DIST * 2 + 1) - 1));
+	sv_scroll(cmap, 0, map_width(cmap) + 1, map_size(cmap) - map_width(cmap) - 1);
+}
+
+// the server switched to another view distance and resends the whole map
+static unsigned int sv_viewdist(unsigned char *buf)
+{
+	unsigned int dist = buf[1];
+
+	if (dist < 1 || dist > DIST_MAX) {
+		fail("sv_viewdist illegal view distance %u\n", dist);
+		exit(-1);
+	}
+
+	return dist;
 }
 
 static void sv_setval(unsigned char *buf, int nr)
@@ -919,8 +957,17 @@ static void sv_server(unsigned char *buf)
 
 static void sv_logindone(void)
 {
+	unsigned char buf[2];
+
 	login_done = 1;
 	bzero_client(1);
+
+	// the login always starts at DIST_DEFAULT, ask for more (or less) if wanted
+	if (want_dist != DIST_DEFAULT) {
+		buf[0] = CL_VIEWDIST;
+		buf[1] = (unsigned char)want_dist;
+		client_send(buf, 2);
+	}
 }
 
 static void sv_special(unsigned char *buf)
@@ -1019,6 +1066,7 @@ void process(unsigned char *buf, int size)
 {
 	size_t len = 0;
 	int panic = 0, last = -1;
+	PROF_ZONE("process");
 
 	while (size > 0 && panic++ < 20000) {
 		if ((buf[0] & (64 + 128)) == SV_MAP01) {
@@ -1250,6 +1298,10 @@ void process(unsigned char *buf, int size)
 				sv_protocol(buf);
 				len = 2;
 				break;
+			case SV_VIEWDIST:
+				map_resize(sv_viewdist(buf));
+				len = 2;
+				break;
 
 			default:
 				len = (size_t)amod_process(buf);
@@ -1446,10 +1498,13 @@ uint32_t prefetch(unsigned char *buf, int size)
 				len = 2;
 				break;
 			case SV_LOGINDONE:
-				bzero(map2, sizeof(map2));
+				map2_resize(DIST_DEFAULT);
 				len = 1;
 				break;
 			case SV_SPECIAL:
+				if (load_u32(buf + 1) < 1000) {
+					sound_prefetch(load_u32(buf + 1));
+				}
 				len = 13;
 				break;
 			case SV_TELEPORT:
@@ -1478,6 +1533,10 @@ uint32_t prefetch(unsigned char *buf, int size)
 			case SV_PROTOCOL:
 				len = 2;
 				break;
+			case SV_VIEWDIST:
+				map2_resize(sv_viewdist(buf));
+				len = 2;
+				break;
 
 			default:
 				len = (size_t)amod_prefetch(buf);
@@ -68,6 +68,14 @@ uint32_t prefetch(unsigned char *buf, int size);
 
 void sv_protocol(unsigned char *buf);
 
+#ifdef UNIT_TEST
+// Test-only wrappers around the static sv_map* decoders (protocol.c)
+struct map;
+size_t test_sv_map01(unsigned char *buf, int *last, struct map *cmap);
+size_t test_sv_map10(unsigned char *buf, int *last, struct map *cmap);
+size_t test_sv_map11(unsigned char *buf, int *last, struct map *cmap);
+#endif
+
 void cmd_move(int x, int y);
 void cmd_ping(void);
 void cmd_swap(int with);
@@ -253,7 +253,10 @@ void list_mem(void);
 void display_game(void);
 
 void set_map_values(struct map *cmap, tick_t attick);
+void set_map_interpolation(struct map *cmap, int frac);
 void quest_select(int nr);
 void init_game(int mcx, int mcy);
+void resize_game(void);
+void cull_quick(int x1, int y1, int x2, int y2);
 void exit_game(void);
 void set_v35_skilltab(void);
@@ -17,6 +17,7 @@
 #include "game/game_private.h"
 #include "gui/gui.h"
 #include "client/client.h"
+#include "game/profile.h"
 
 // Sprite counters - shared with game_display.c
 int fsprite_cnt = 0, f2sprite_cnt = 0, gsprite_cnt = 0, g2sprite_cnt = 0, isprite_cnt = 0, csprite_cnt = 0;
@@ -166,6 +167,7 @@ void dl_play(void)
 	int d;
 	Uint64 start;
 	void helper_cmp_dl(int attick, DL **dl, int dlused);
+	PROF_ZONE("dl_play");
 
 	// helper_cmp_dl(tick,dlsort,dlused);
 
@@ -322,142 +324,163 @@ void show_bubbles(void)
 }
 
 // make quick
-static int quick_qcmp(const void *va, const void *vb)
-{
-	const QUICK *a;
-	const QUICK *b;
 
-	union {
-		const void *cv;
-		QUICK *qv;
-	} ua, ub;
+// The diamond in client order (by x+y, then x) and its neighbour links only
+// depend on the view distance, so each layout is built once and copied into
+// quick from then on. Only the screen positions change with the window.
+static QUICK *quick_layout[DIST_MAX + 1];
+static int quick_layout_cnt[DIST_MAX + 1];
 
-	// qsort comparator: const void* points to array elements (QUICK)
-	// Use union to safely cast away const (comparator doesn't modify data)
-	ua.cv = va;
-	ub.cv = vb;
-	a = ua.qv;
-	b = ub.qv;
+// how far outside the map window a tile's sprites can still reach into it
+#define CULL_SIDE 256
+#define CULL_UP   384
+#define CULL_DOWN 160
 
-	if (a->mapx + a->mapy < b->mapx + b->mapy) {
-		return -1;
-	} else if (a->mapx + a->mapy > b->mapx + b->mapy) {
-		return 1;
-	}
+static int cull_x1, cull_y1, cull_x2, cull_y2, cull_valid;
 
-	return (int)a->mapx - (int)b->mapx;
-}
-
-void make_quick(int game, int mcx, int mcy)
+static const QUICK *get_quick_layout(unsigned int dist, int *pcnt)
 {
-	unsigned int x, y, xs, xe;
-	int i, ii;
-	unsigned int dist = DIST;
+	unsigned int width = dist * 2 + 1, x, y, s;
+	int i, n, dx, dy, nx, ny, ii, *grid;
+	QUICK *q;
 
-	if (game) {
-		set_mapoff(mcx, mcy, MAPDX, MAPDY);
-		set_mapadd(0, 0);
+	if (quick_layout[dist]) {
+		*pcnt = quick_layout_cnt[dist];
+		return quick_layout[dist];
 	}
 
-	// calc maxquick
-	for (i = y = 0; y <= dist * 2; y++) {
-		if (y < dist) {
-			xs = dist - y;
-			xe = dist + y;
-		} else {
-			xs = y - dist;
-			xe = dist * 3 - y;
-		}
-		for (x = xs; x <= xe; x++) {
-			i++;
-		}
-	}
-	maxquick = i;
+	n = (int)(2 * dist * (dist + 1) + 1);
+	q = xmalloc((size_t)(n + 1) * sizeof(QUICK), MEM_GAME);
 
-	// set quick (and mn[4]) in server order
-	quick = xrealloc(quick, (size_t)(maxquick + 1) * sizeof(QUICK), MEM_GAME);
-	for (i = y = 0; y <= dist * 2; y++) {
-		if (y < dist) {
-			xs = dist - y;
-			xe = dist + y;
-		} else {
-			xs = y - dist;
-			xe = dist * 3 - y;
-		}
-		for (x = xs; x <= xe; x++) {
-			quick[i].mn[4] = x + y * (dist * 2 + 1);
+	// tile to quick index, n for tiles outside the diamond
+	grid = xmalloc((size_t)width * width * sizeof(int), MEM_TEMP);
+	for (i = 0; i < (int)(width * width); i++) {
+		grid[i] = n;
+	}
 
-			quick[i].mapx = x;
-			quick[i].mapy = y;
-			mtos(x, y, &quick[i].cx, &quick[i].cy);
+	for (i = 0, s = dist; s <= dist * 3; s++) {
+		for (x = s > dist * 2 ? s - dist * 2 : 0; x <= s && x <= dist * 2; x++) {
+			y = s - x;
+			if (abs((int)x - (int)dist) + abs((int)y - (int)dist) > (int)dist) {
+				continue;
+			}
+			q[i].mapx = x;
+			q[i].mapy = y;
+			q[i].mn[4] = x + y * width;
+			grid[q[i].mn[4]] = i;
 			i++;
 		}
 	}
 
-	// sort quick in client order
-	qsort(quick, (size_t)maxquick, sizeof(QUICK), quick_qcmp);
-
-	// set quick neighbours
-	for (i = 0; i < maxquick; i++) {
-		int dx, dy;
+	for (i = 0; i < n; i++) {
 		for (dy = -1; dy <= 1; dy++) {
 			for (dx = -1; dx <= 1; dx++) {
-				if (dx == 1 || (dx == 0 && dy == 1)) {
-					for (ii = i + 1; ii < maxquick; ii++) {
-						if ((int)quick[i].mapx + dx == (int)quick[ii].mapx &&
-						    (int)quick[i].mapy + dy == (int)quick[ii].mapy) {
-							break;
-						}
-					}
-				} else if (dx == -1 || (dx == 0 && dy == -1)) {
-					for (ii = i - 1; ii >= 0; ii--) {
-						if ((int)quick[i].mapx + dx == (int)quick[ii].mapx &&
-						    (int)quick[i].mapy + dy == (int)quick[ii].mapy) {
-							break;
-						}
-					}
-					if (ii == -1) {
-						ii = maxquick;
-					}
+				nx = (int)q[i].mapx + dx;
+				ny = (int)q[i].mapy + dy;
+				if (nx < 0 || ny < 0 || nx >= (int)width || ny >= (int)width) {
+					ii = n;
 				} else {
-					ii = i;
+					ii = grid[nx + ny * (int)width];
 				}
 
-				if (ii == maxquick) {
-					quick[i].mn[(dx + 1) + (dy + 1) * 3] = 0;
-					quick[i].qi[(dx + 1) + (dy + 1) * 3] = maxquick;
+				if (ii == n) {
+					q[i].mn[(dx + 1) + (dy + 1) * 3] = 0;
+					q[i].qi[(dx + 1) + (dy + 1) * 3] = n;
 				} else {
-					quick[i].mn[(dx + 1) + (dy + 1) * 3] = quick[ii].mn[4];
-					quick[i].qi[(dx + 1) + (dy + 1) * 3] = ii;
+					q[i].mn[(dx + 1) + (dy + 1) * 3] = q[ii].mn[4];
+					q[i].qi[(dx + 1) + (dy + 1) * 3] = ii;
 				}
 			}
 		}
 	}
 
 	// set values for quick[maxquick]
-	{
-		int dx, dy;
-		for (dy = -1; dy <= 1; dy++) {
-			for (dx = -1; dx <= 1; dx++) {
-				quick[maxquick].mn[(dx + 1) + (dy + 1) * 3] = 0;
-				quick[maxquick].qi[(dx + 1) + (dy + 1) * 3] = maxquick;
-			}
-		}
+	for (i = 0; i < 9; i++) {
+		q[n].mn[i] = 0;
+		q[n].qi[i] = n;
+	}
+
+	xfree(grid);
+
+	quick_layout[dist] = q;
+	quick_layout_cnt[dist] = n;
+
+	*pcnt = n;
+	return q;
+}
+
+void make_quick(int game, int mcx, int mcy)
+{
+	const QUICK *layout;
+	int i;
+
+	if (game) {
+		set_mapoff(mcx, mcy, (int)MAPDX, (int)MAPDY);
+		set_mapadd(0, 0);
+	}
+
+	layout = get_quick_layout(DIST, &maxquick);
+
+	quick = xrealloc(quick, (size_t)(maxquick + 1) * sizeof(QUICK), MEM_GAME);
+	memcpy(quick, layout, (size_t)(maxquick + 1) * sizeof(QUICK));
+
+	for (i = 0; i < maxquick; i++) {
+		mtos(quick[i].mapx, quick[i].mapy, &quick[i].cx, &quick[i].cy);
+		quick[i].visible = 1;
 	}
+	cull_valid = 0;
+}
+
+// Marks the tiles that can show anything inside the map window (x1,y1)-(x2,y2).
+// Sprites are bottom-anchored and tall ones reach far up, get_offset_sprite()
+// moves them by up to 128 pixels and walking adds another tile. Only redone
+// when the window or quick changed.
+void cull_quick(int x1, int y1, int x2, int y2)
+{
+	int i;
+
+	if (cull_valid && x1 == cull_x1 && y1 == cull_y1 && x2 == cull_x2 && y2 == cull_y2) {
+		return;
+	}
+
+	for (i = 0; i < maxquick; i++) {
+		quick[i].visible = quick[i].cx + CULL_SIDE >= x1 && quick[i].cx - CULL_SIDE < x2 &&
+		                   quick[i].cy + CULL_DOWN >= y1 && quick[i].cy - CULL_UP < y2;
+	}
+
+	cull_x1 = x1;
+	cull_y1 = y1;
+	cull_x2 = x2;
+	cull_y2 = y2;
+	cull_valid = 1;
 }
 
 // init, exit
 
+static int game_mcx, game_mcy;
+
 void init_game(int mcx, int mcy)
 {
+	game_mcx = mcx;
+	game_mcy = mcy;
 	make_quick(1, mcx, mcy);
 }
 
+// the view distance changed
+void resize_game(void)
+{
+	make_quick(1, game_mcx, game_mcy);
+}
+
 void exit_game(void)
 {
 	xfree(quick);
 	quick = NULL;
 	maxquick = 0;
+	for (unsigned int d = 0; d <= DIST_MAX; d++) {
+		xfree(quick_layout[d]);
+		quick_layout[d] = NULL;
+	}
 	xfree(dllist);
 	dllist = NULL;
 	xfree(dlsort);
@@ -927,6 +927,11 @@ void display_game_map(struct map *cmap)
 	start = SDL_GetTicks();
 
 	for (i = 0; i < maxquick; i++) {
+		// nothing of this field can reach the map window
+		if (!quick[i].visible) {
+			continue;
+		}
+
 		mn = quick[i].mn[4];
 		scrx = mapaddx + quick[i].cx;
 		scry = mapaddy + quick[i].cy;
@@ -1463,6 +1468,11 @@ void display_game(void)
 
 void prefetch_game(tick_t attick)
 {
+	// map2 already switched to a new view distance, quick has not yet
+	if (map2_dist != DIST) {
+		return;
+	}
+
 	set_map_values(map2, attick);
 	set_mapadd(-map2[mapmn(MAPDX / 2, MAPDY / 2)].xadd, -map2[mapmn(MAPDX / 2, MAPDY / 2)].yadd);
 	display_game_map(map2);
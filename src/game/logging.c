@@ -0,0 +1,361 @@
+/*
+ * Part of Astonia Client (c) Daniel Brockhaus. Please read license.txt.
+ *
+ * Logging
+ *
+ * Producers claim ring slots with a CAS on log_head and publish them through
+ * the slot sequence number, the writer thread is the only consumer. Chat lines
+ * go through a small queue to the main thread, the chat isn't thread safe.
+ * Before log_init() and after log_exit() lines are written directly, and so
+ * are fail() lines at any time.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL3/SDL.h>
+
+#include "astonia.h"
+#include "game/logging.h"
+
+#define LOG_RING       256 // lines, power of two
+#define LOG_LINE       512
+#define LOG_SITE_BITS  8
+#define LOG_SITES      (1 << LOG_SITE_BITS)
+#define LOG_SITE_PROBE 4 // slots a call site may use, the quietest one is taken over when all are busy
+#define LOG_SITE_RATE  10 // lines per second and call site
+#define LOG_CHAT       32
+#define LOG_WAIT       50 // ms the writer sleeps when idle
+
+struct log_slot {
+	uint32_t seq; // index + 1 when filled, index + LOG_RING when free again
+	int level;
+	char text[LOG_LINE];
+};
+
+// call sites are told apart by their format string
+struct log_site {
+	const char *format;
+	int level;
+	uint32_t sec;
+	uint32_t cnt;
+	uint32_t suppressed;
+};
+
+extern FILE *errorfp;
+
+int log_level = LOG_NOTE;
+
+static struct log_slot log_ring[LOG_RING];
+static uint32_t log_head; // next slot to claim
+static uint32_t log_tail; // next slot to write, writer only
+static uint32_t log_lost; // lines dropped because the ring was full
+
+static struct log_site log_site[LOG_SITES];
+
+static SDL_Thread *log_thread;
+static SDL_Semaphore *log_wake;
+static int log_running, log_quit;
+
+static SDL_Mutex *log_chat_mutex;
+static char log_chat[LOG_CHAT][LOG_LINE];
+static int log_chat_in, log_chat_out;
+
+static const char *log_prefix[] = {"NOTE", "WARN", "FAIL"};
+
+static void log_chat_add(const char *text)
+{
+	SDL_LockMutex(log_chat_mutex);
+	if (log_chat_in - log_chat_out < LOG_CHAT) {
+		snprintf(log_chat[log_chat_in % LOG_CHAT], LOG_LINE, "%s", text);
+		log_chat_in++;
+	}
+	SDL_UnlockMutex(log_chat_mutex);
+}
+
+// Writes one line to its destinations, as note(), warn() and fail() always did.
+static void log_output(int level, const char *text, int direct)
+{
+	char buf[LOG_LINE + 16];
+
+	if (level == LOG_FAIL) {
+		fprintf(errorfp, "FAIL: %s\n", text);
+		fflush(errorfp);
+	}
+	printf("%s: %s\n", log_prefix[level], text);
+	fflush(stdout);
+
+#ifndef DEVELOPER
+	if (level == LOG_NOTE) {
+		return;
+	}
+#endif
+	snprintf(buf, sizeof(buf), "%s: %s\n", log_prefix[level], text);
+	if (direct) {
+		addline("%s", buf);
+	} else {
+		log_chat_add(buf);
+	}
+}
+
+// Format strings sit next to each other in .rodata, spread them with a Fibonacci hash
+static unsigned int log_site_hash(const char *format)
+{
+	return (unsigned int)(((uint64_t)(uintptr_t)format * 0x9E3779B97F4A7C15ull) >> (64 - LOG_SITE_BITS));
+}
+
+// Finds the slot of format, claiming a free one or the one quiet for longest.
+// The suppressed count of a site pushed out that way goes to evicted.
+static struct log_site *log_site_find(int level, const char *format, uint32_t sec, struct log_site *evicted)
+{
+	unsigned int h = log_site_hash(format);
+	struct log_site *site, *oldest = NULL;
+	const char *cur;
+
+	for (int i = 0; i < LOG_SITE_PROBE; i++) {
+		site = &log_site[(h + (unsigned int)i) & (LOG_SITES - 1)];
+		cur = __atomic_load_n(&site->format, __ATOMIC_RELAXED);
+		if (!cur &&
+		    __atomic_compare_exchange_n(&site->format, &cur, format, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+			__atomic_store_n(&site->level, level, __ATOMIC_RELAXED);
+			__atomic_store_n(&site->sec, sec, __ATOMIC_RELAXED);
+			return site;
+		}
+		if (cur == format) {
+			return site;
+		}
+		if (!oldest ||
+		    __atomic_load_n(&site->sec, __ATOMIC_RELAXED) < __atomic_load_n(&oldest->sec, __ATOMIC_RELAXED)) {
+			oldest = site;
+		}
+	}
+
+	site = oldest;
+	evicted->format = __atomic_exchange_n(&site->format, format, __ATOMIC_RELAXED);
+	evicted->level = __atomic_exchange_n(&site->level, level, __ATOMIC_RELAXED);
+	evicted->suppressed = __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&site->sec, sec, __ATOMIC_RELAXED);
+	__atomic_store_n(&site->cnt, 0, __ATOMIC_RELAXED);
+
+	return site;
+}
+
+// Returns the number of lines suppressed in the last second, or -1 if this one has to go.
+static int log_site_check(int level, const char *format, struct log_site *evicted)
+{
+	uint32_t sec = (uint32_t)(SDL_GetTicks() / 1000);
+	struct log_site *site = log_site_find(level, format, sec, evicted);
+	int suppressed = 0;
+
+	// racing threads only make the counts a little off
+	if (__atomic_load_n(&site->sec, __ATOMIC_RELAXED) != sec) {
+		__atomic_store_n(&site->sec, sec, __ATOMIC_RELAXED);
+		__atomic_store_n(&site->cnt, 0, __ATOMIC_RELAXED);
+		suppressed = (int)__atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+	}
+
+	if (__atomic_fetch_add(&site->cnt, 1, __ATOMIC_RELAXED) >= LOG_SITE_RATE) {
+		__atomic_fetch_add(&site->suppressed, 1, __ATOMIC_RELAXED);
+		return -1;
+	}
+
+	return suppressed;
+}
+
+static int log_push(int level, const char *text)
+{
+	struct log_slot *slot;
+	uint32_t pos, seq;
+
+	pos = __atomic_load_n(&log_head, __ATOMIC_RELAXED);
+	for (;;) {
+		slot = &log_ring[pos & (LOG_RING - 1)];
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq == pos) {
+			if (__atomic_compare_exchange_n(&log_head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if ((int32_t)(seq - pos) < 0) {
+			return 0; // full
+		} else {
+			pos = __atomic_load_n(&log_head, __ATOMIC_RELAXED);
+		}
+	}
+
+	slot->level = level;
+	snprintf(slot->text, LOG_LINE, "%s", text);
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+	return 1;
+}
+
+// Hands a finished line to the writer thread, or writes it when there is none.
+static void log_line(int level, const char *buf)
+{
+	if (!__atomic_load_n(&log_running, __ATOMIC_ACQUIRE)) {
+		log_output(level, buf, 1);
+		return;
+	}
+
+	// fail() is mostly followed by exit(), the line can't wait for the writer
+	if (level == LOG_FAIL) {
+		log_output(level, buf, 0);
+		return;
+	}
+
+	if (!log_push(level, buf)) {
+		__atomic_fetch_add(&log_lost, 1, __ATOMIC_RELAXED);
+	}
+}
+
+void log_message(int level, const char *format, va_list va)
+{
+	struct log_site evicted = {0};
+	char buf[LOG_LINE];
+	int suppressed = 0;
+	size_t len;
+
+	if (level < log_level) {
+		return;
+	}
+	if (level != LOG_FAIL) {
+		suppressed = log_site_check(level, format, &evicted);
+		// the site that gave up its slot still owes its count
+		if (evicted.suppressed) {
+			snprintf(buf, sizeof(buf), "%u lines like \"%.*s\" suppressed", evicted.suppressed,
+			    (int)strcspn(evicted.format, "\n"), evicted.format);
+			log_line(evicted.level, buf);
+		}
+		if (suppressed < 0) {
+			return;
+		}
+	}
+
+	vsnprintf(buf, sizeof(buf), format, va);
+	if (suppressed) {
+		len = strlen(buf);
+		snprintf(buf + len, sizeof(buf) - len, " (%d more suppressed)", suppressed);
+	}
+
+	log_line(level, buf);
+}
+
+static int log_writer(void *data)
+{
+	static char last[LOG_LINE];
+	int last_level = 0, repeated = 0, quit, got;
+	uint32_t lost;
+	char tmp[64];
+
+	(void)data;
+
+	do {
+		SDL_WaitSemaphoreTimeout(log_wake, LOG_WAIT);
+		quit = __atomic_load_n(&log_quit, __ATOMIC_ACQUIRE);
+
+		for (got = 0;; got++) {
+			struct log_slot *slot = &log_ring[log_tail & (LOG_RING - 1)];
+
+			if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != log_tail + 1) {
+				break;
+			}
+
+			if (slot->level == last_level && !strcmp(slot->text, last)) {
+				repeated++;
+			} else {
+				if (repeated) {
+					snprintf(tmp, sizeof(tmp), "last message repeated %d times", repeated);
+					log_output(last_level, tmp, 0);
+					repeated = 0;
+				}
+				log_output(slot->level, slot->text, 0);
+				last_level = slot->level;
+				memcpy(last, slot->text, LOG_LINE);
+			}
+
+			__atomic_store_n(&slot->seq, log_tail + LOG_RING, __ATOMIC_RELEASE);
+			log_tail++;
+		}
+
+		// nothing came in for a while, don't sit on the count
+		if (repeated && (!got || quit)) {
+			snprintf(tmp, sizeof(tmp), "last message repeated %d times", repeated);
+			log_output(last_level, tmp, 0);
+			repeated = 0;
+		}
+		if ((lost = __atomic_exchange_n(&log_lost, 0, __ATOMIC_RELAXED))) {
+			snprintf(tmp, sizeof(tmp), "%u log lines lost, the log queue was full", lost);
+			log_output(LOG_WARN, tmp, 0);
+		}
+	} while (!quit);
+
+	return 0;
+}
+
+void log_init(void)
+{
+	for (uint32_t i = 0; i < LOG_RING; i++) {
+		log_ring[i].seq = i;
+	}
+	log_head = log_tail = 0;
+	log_quit = 0;
+
+	log_wake = SDL_CreateSemaphore(0);
+	log_chat_mutex = SDL_CreateMutex();
+	if (!log_wake || !log_chat_mutex) {
+		warn("log: could not create writer sync: %s", SDL_GetError());
+		return;
+	}
+
+	__atomic_store_n(&log_running, 1, __ATOMIC_RELEASE);
+	log_thread = SDL_CreateThread(log_writer, "log writer", NULL);
+	if (!log_thread) {
+		__atomic_store_n(&log_running, 0, __ATOMIC_RELEASE);
+		warn("log: could not start writer thread: %s", SDL_GetError());
+	}
+}
+
+// Passes the lines meant for the chat on, main thread only.
+void log_frame(void)
+{
+	char buf[LOG_LINE];
+
+	if (!log_chat_mutex) {
+		return;
+	}
+
+	for (;;) {
+		SDL_LockMutex(log_chat_mutex);
+		if (log_chat_out == log_chat_in) {
+			SDL_UnlockMutex(log_chat_mutex);
+			break;
+		}
+		memcpy(buf, log_chat[log_chat_out % LOG_CHAT], LOG_LINE);
+		log_chat_out++;
+		SDL_UnlockMutex(log_chat_mutex);
+
+		addline("%s", buf);
+	}
+}
+
+void log_exit(void)
+{
+	// from here on lines are written directly, the writer drains what's queued
+	__atomic_store_n(&log_running, 0, __ATOMIC_RELEASE);
+
+	if (log_thread) {
+		__atomic_store_n(&log_quit, 1, __ATOMIC_RELEASE);
+		SDL_SignalSemaphore(log_wake);
+		SDL_WaitThread(log_thread, NULL);
+		log_thread = NULL;
+	}
+
+	if (log_wake) {
+		SDL_DestroySemaphore(log_wake);
+		log_wake = NULL;
+	}
+	if (log_chat_mutex) {
+		SDL_DestroyMutex(log_chat_mutex);
+		log_chat_mutex = NULL;
+	}
+}
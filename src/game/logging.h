@@ -0,0 +1,29 @@
+/*
+ * Part of Astonia Client (c) Daniel Brockhaus. Please read license.txt.
+ *
+ * Logging
+ *
+ * note(), warn() and fail() format into a bounded ring that a background
+ * thread writes out, so callers never wait for stdout or the log file. Each
+ * call site is limited to LOG_SITE_RATE lines per second, and repeated lines
+ * are collapsed into a "repeated N times" line. fail() lines skip all of this
+ * and are written before fail() returns.
+ */
+
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include <stdarg.h>
+
+#define LOG_NOTE 0
+#define LOG_WARN 1
+#define LOG_FAIL 2
+
+extern int log_level; // lines below this level are dropped
+
+void log_message(int level, const char *format, va_list va);
+void log_init(void);
+void log_frame(void);
+void log_exit(void);
+
+#endif // LOGGING_H
@@ -30,6 +30,8 @@
 #include "gui/gui.h"
 #include "client/client.h"
 #include "modder/modder.h"
+#include "game/profile.h"
+#include "game/logging.h"
 
 // Forward declarations
 void xlog(FILE *logfp, char *format, ...) __attribute__((format(printf, 2, 3)));
@@ -64,55 +66,33 @@ FILE *errorfp;
 DLL_EXPORT int note(const char *format, ...)
 {
 	va_list va;
-	char buf[1024];
-
 
 	va_start(va, format);
-	vsprintf(buf, format, va);
+	log_message(LOG_NOTE, format, va);
 	va_end(va);
 
-	printf("NOTE: %s\n", buf);
-	fflush(stdout);
-#ifdef DEVELOPER
-	addline("NOTE: %s\n", buf);
-#endif
-
 	return 0;
 }
 
 DLL_EXPORT int warn(const char *format, ...)
 {
 	va_list va;
-	char buf[1024];
-
 
 	va_start(va, format);
-	vsprintf(buf, format, va);
+	log_message(LOG_WARN, format, va);
 	va_end(va);
 
-	printf("WARN: %s\n", buf);
-	fflush(stdout);
-	addline("WARN: %s\n", buf);
-
 	return 0;
 }
 
 DLL_EXPORT int fail(const char *format, ...)
 {
 	va_list va;
-	char buf[1024];
-
 
 	va_start(va, format);
-	vsprintf(buf, format, va);
+	log_message(LOG_FAIL, format, va);
 	va_end(va);
 
-	fprintf(errorfp, "FAIL: %s\n", buf);
-	fflush(errorfp);
-	printf("FAIL: %s\n", buf);
-	fflush(stdout);
-	addline("FAIL: %s\n", buf);
-
 	return -1;
 }
 
@@ -259,7 +239,7 @@ void display_usage(void)
 	const char *help =
 	    "The Astonia Client can only be started from the command line or with a specially created shortcut.\n\n"
 	    "Usage: moac -u playername -p password -d url\n ... [-w width] [-h height]\n"
-	    " ... [-m threads] [-o options]\n ... [-k framespersecond]\n\n"
+	    " ... [-m threads] [-o options]\n ... [-k framespersecond] [-s pacing]\n ... [-r viewdistance] [-b budget]\n\n"
 	    "url being, for example, \"server.astonia.com\" or \"192.168.77.132\" (without the quotes).\n\n"
 	    "width and height are the desired window size. If this matches the desktop size the client "
 	    "will start in windowed borderless pseudo-fullscreen mode.\n\n"
@@ -277,8 +257,15 @@ void display_usage(void)
 	    "Bit 16 makes the sliding top bar less sensitive.\n"
 	    "Bit 17 reduces lighting effects (more performance, less pretty).\n"
 	    "Bit 18 disables the minimap.\n"
+	    "Bit 20 publishes player state and performance counters in shared memory for overlays.\n"
 	    "Default depends on screen height.\n\n"
-	    "framespersecond will set the display rate in frames per second.\n\n";
+	    "framespersecond will set the display rate in frames per second.\n\n"
+	    "pacing selects how frames are timed: \"cap\" (default) shows framespersecond frames, \"vsync\" one per "
+	    "screen refresh, \"uncapped\" as many as possible and \"lowpower\" framespersecond frames while sleeping "
+	    "in between. Characters move smoothly between game updates at any rate.\n\n"
+	    "viewdistance is the number of tiles visible in each direction, if the server allows it. Default is 25.\n\n"
+	    "budget is the share of a frame, in percent, each mod may use before a warning is logged. Append \"t\" "
+	    "(e.g. 20t) to also run the per-frame code of such mods only every other frame. Default is no limit.\n\n";
 
 	SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "Usage", help, NULL);
 	printf("%s", help);
@@ -407,6 +394,49 @@ int parse_args(int argc, char *argv[])
 				}
 			}
 			break;
+		case 's':
+			if (!val && i + 1 < argc) {
+				val = argv[++i];
+			}
+			if (val) {
+				if (!SDL_strcasecmp(val, "vsync")) {
+					sdl_pacing = SDL_PACE_VSYNC;
+				} else if (!SDL_strcasecmp(val, "uncapped")) {
+					sdl_pacing = SDL_PACE_UNCAPPED;
+				} else if (!SDL_strcasecmp(val, "lowpower")) {
+					sdl_pacing = SDL_PACE_LOWPOWER;
+				} else {
+					sdl_pacing = SDL_PACE_CAP;
+				}
+			}
+			break;
+		case 'r':
+			if (!val && i + 1 < argc) {
+				val = argv[++i];
+			}
+			if (val) {
+				long r = strtol(val, &end, 10);
+				if (r < 1 || r > DIST_MAX) {
+					want_dist = DIST_DEFAULT;
+				} else {
+					want_dist = (unsigned int)r;
+				}
+			}
+			break;
+		case 'b':
+			if (!val && i + 1 < argc) {
+				val = argv[++i];
+			}
+			if (val) {
+				long b = strtol(val, &end, 10);
+				if (b < 0 || b > 100) {
+					amod_budget = 0;
+				} else {
+					amod_budget = (int)b;
+				}
+				amod_throttle = tolower((unsigned char)*end) == 't';
+			}
+			break;
 		case 't':
 			if (!val && i + 1 < argc) {
 				val = argv[++i];
@@ -615,6 +645,7 @@ int main(int argc, char *argv[])
 	}
 
 	init_logging();
+	log_init();
 
 #ifdef ENABLE_CRASH_HANDLER
 	register_crash_handler();
@@ -632,6 +663,7 @@ int main(int argc, char *argv[])
 	// set some stuff
 	if (!*username || !*password || !*server_url) {
 		display_usage();
+		log_exit();
 		return 0;
 	}
 
@@ -659,6 +691,7 @@ int main(int argc, char *argv[])
 	sprintf(buf, "Astonia 3 v%d.%d.%d", (VERSION >> 16) & 255, (VERSION >> 8) & 255, (VERSION) & 255);
 	if (!sdl_init(want_width, want_height, buf, want_monitor)) {
 		render_exit();
+		log_exit();
 		return -1;
 	}
 
@@ -670,6 +703,10 @@ int main(int argc, char *argv[])
 		render_set_textfont(1);
 	}
 
+	// the shared memory object outlives the process unless removed, so the exit() paths remove it too
+	if ((game_options & GO_TELEMETRY) && telemetry_init()) {
+		atexit(telemetry_exit);
+	}
 	main_init();
 	update_user_keys();
 
@@ -678,11 +715,13 @@ int main(int argc, char *argv[])
 #ifdef ENABLE_SHAREDMEM
 	sharedmem_exit();
 #endif
+	telemetry_exit();
 	amod_exit();
 	main_exit();
 	sound_exit();
 	render_exit();
 	sdl_exit();
+	prof_exit();
 
 	list_mem();
 
@@ -697,6 +736,7 @@ int main(int argc, char *argv[])
 		SDL_free(localdata);
 	}
 
+	log_exit();
 	xlog(errorfp, "Clean client shutdown. Thank you for playing!");
 	if (errorfp != stderr) {
 		fclose(errorfp);
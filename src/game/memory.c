@@ -5,6 +5,9 @@
  *
  * Provides tracked memory allocation (xmalloc/xfree) and allocator selection
  * macros (MALLOC/FREE) for choosing between mimalloc and standard libc.
+ *
+ * Blocks carry a small head with size and type. Depending on mem_guard all,
+ * some or none of them also get canaries that xmemcheck() and xfree() verify.
  */
 
 #include <stdint.h>
@@ -18,7 +21,7 @@
 #include "game/memory.h"
 #include "sdl/sdl.h"
 
-// Memory statistics
+// Memory statistics, merged from the shards by mem_stats_merge()
 size_t memused = 0;
 int memptrused = 0;
 
@@ -27,10 +30,30 @@ int maxmemptrs = 0;
 int memptrs[MAX_MEM];
 size_t memsize[MAX_MEM];
 
+// Each thread counts into its own shard, so the texture workers neither race
+// the main thread nor share its cache lines. Blocks freed by another thread
+// make single shards go negative, only the sum means anything.
+#define MEM_SHARDS 16
+
+struct mem_shard {
+	int64_t size[MAX_MEM];
+	int32_t ptrs[MAX_MEM];
+	int64_t used;
+	int32_t ptrused;
+} __attribute__((aligned(64)));
+
+static struct mem_shard mem_shard[MEM_SHARDS];
+static int mem_shards = 0;
+static _Thread_local struct mem_shard *mem_own = NULL;
+
+int mem_guard = MEM_GUARD_DEFAULT;
+
 // Memory check tracking
 static size_t memcheckset = 0;
 static char memcheck[256];
 
+#define MEM_MAGIC 0x4d48 // "HM"
+
 // TODO: removed unused memory areas
 static char *memname[MAX_MEM] = {"MEM_TOTA", // 0
     "MEM_GLOB", "MEM_TEMP", "MEM_ELSE", "MEM_DL",
@@ -43,12 +66,74 @@ static char *memname[MAX_MEM] = {"MEM_TOTA", // 0
 // External reference to xmemcheck_failed (defined in main.c)
 extern int xmemcheck_failed;
 
-static void update_mem_stats_add(uint8_t ID, size_t size)
+static struct mem_shard *mem_get_shard(void)
+{
+	if (!mem_own) {
+		int slot = __atomic_fetch_add(&mem_shards, 1, __ATOMIC_RELAXED);
+		// threads beyond MEM_SHARDS share the slots, the updates are atomic anyway
+		mem_own = &mem_shard[slot % MEM_SHARDS];
+	}
+	return mem_own;
+}
+
+// Bytes the allocator sees for a block of size bytes.
+static size_t mem_total(size_t size, int guard)
+{
+	return sizeof(struct memhead) + size + (guard ? 2 * sizeof(memcheck) : 0);
+}
+
+static void update_mem_stats_add(uint8_t ID, size_t size, int guard)
 {
-	memsize[ID] += size;
-	memptrs[ID] += 1;
-	memsize[0] += size;
-	memptrs[0] += 1;
+	struct mem_shard *sh = mem_get_shard();
+
+	__atomic_fetch_add(&sh->size[ID], (int64_t)size, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&sh->ptrs[ID], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&sh->size[0], (int64_t)size, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&sh->ptrs[0], 1, __ATOMIC_RELAXED);
+
+	__atomic_fetch_add(&sh->used, (int64_t)mem_total(size, guard), __ATOMIC_RELAXED);
+	__atomic_fetch_add(&sh->ptrused, 1, __ATOMIC_RELAXED);
+}
+
+static void update_mem_stats_remove(uint8_t ID, size_t size, int guard)
+{
+	struct mem_shard *sh = mem_get_shard();
+
+	__atomic_fetch_sub(&sh->size[ID], (int64_t)size, __ATOMIC_RELAXED);
+	__atomic_fetch_sub(&sh->ptrs[ID], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_sub(&sh->size[0], (int64_t)size, __ATOMIC_RELAXED);
+	__atomic_fetch_sub(&sh->ptrs[0], 1, __ATOMIC_RELAXED);
+
+	__atomic_fetch_sub(&sh->used, (int64_t)mem_total(size, guard), __ATOMIC_RELAXED);
+	__atomic_fetch_sub(&sh->ptrused, 1, __ATOMIC_RELAXED);
+}
+
+// Sums the shards into memsize[], memptrs[], memused and memptrused. The
+// maxima are only as good as the calls, once per frame catches the peaks that
+// matter. Main thread only.
+void mem_stats_merge(void)
+{
+	int64_t size, used = 0;
+	int32_t ptrs, ptrused = 0;
+	int i, n;
+
+	for (i = 0; i < MAX_MEM; i++) {
+		size = 0;
+		ptrs = 0;
+		for (n = 0; n < MEM_SHARDS; n++) {
+			size += __atomic_load_n(&mem_shard[n].size[i], __ATOMIC_RELAXED);
+			ptrs += __atomic_load_n(&mem_shard[n].ptrs[i], __ATOMIC_RELAXED);
+		}
+		// the workers may be half way through a realloc
+		memsize[i] = (size_t)max(size, (int64_t)0);
+		memptrs[i] = max(ptrs, 0);
+	}
+	for (n = 0; n < MEM_SHARDS; n++) {
+		used += __atomic_load_n(&mem_shard[n].used, __ATOMIC_RELAXED);
+		ptrused += __atomic_load_n(&mem_shard[n].ptrused, __ATOMIC_RELAXED);
+	}
+	memused = (size_t)max(used, (int64_t)0);
+	memptrused = max(ptrused, 0);
 
 	if (memsize[0] > maxmemsize) {
 		maxmemsize = memsize[0];
@@ -56,35 +141,71 @@ static void update_mem_stats_add(uint8_t ID, size_t size)
 	if (memptrs[0] > maxmemptrs) {
 		maxmemptrs = memptrs[0];
 	}
+}
 
-	memused += sizeof(struct memhead) + sizeof(memcheck) + size + sizeof(memcheck);
-	memptrused++;
+// Whether the next block gets canaries.
+static int mem_want_guard(void)
+{
+	static _Thread_local unsigned int cnt = 0;
+
+	switch (__atomic_load_n(&mem_guard, __ATOMIC_RELAXED)) {
+	case MEM_GUARD_FULL:
+		return 1;
+	case MEM_GUARD_SAMPLED:
+		return (cnt++ % MEM_GUARD_SAMPLE) == 0;
+	default:
+		return 0;
+	}
 }
 
-static void update_mem_stats_remove(uint8_t ID, size_t size)
+// Blocks are [canary][memhead][data][canary], the canaries only if mem->guard
+// is set. The head sits right before the data so it can be found either way.
+static struct memhead *mem_head(void *ptr)
 {
-	memsize[ID] -= size;
-	memptrs[ID] -= 1;
-	memsize[0] -= size;
-	memptrs[0] -= 1;
+	return (struct memhead *)((unsigned char *)ptr - sizeof(struct memhead));
+}
 
-	memused -= sizeof(struct memhead) + sizeof(memcheck) + size + sizeof(memcheck);
-	memptrused--;
+static void *mem_base(struct memhead *mem)
+{
+	return (unsigned char *)mem - (mem->guard ? sizeof(memcheck) : 0);
+}
+
+// Fills in the head and canaries of a block starting at base, returns the user pointer.
+static void *mem_setup(void *base, size_t size, uint8_t ID, int guard)
+{
+	struct memhead *mem;
+	unsigned char *rptr;
+
+	mem = (struct memhead *)((unsigned char *)base + (guard ? sizeof(memcheck) : 0));
+	mem->size = size;
+	mem->ID = ID;
+	mem->guard = (uint8_t)guard;
+	mem->magic = MEM_MAGIC;
+	rptr = (unsigned char *)mem + sizeof(struct memhead);
+
+	if (guard) {
+		memcpy(base, memcheck, sizeof(memcheck));
+		memcpy(rptr + size, memcheck, sizeof(memcheck));
+	}
+
+	return rptr;
 }
 
 int xmemcheck(void *ptr)
 {
 	struct memhead *mem;
-	unsigned char *head, *tail, *rptr;
+	unsigned char *rptr = ptr;
 
 	if (!ptr) {
 		return 0;
 	}
 
-	{
-		uintptr_t ptr_val = (uintptr_t)ptr;
-		ptr_val -= sizeof(struct memhead) + sizeof(memcheck);
-		mem = (struct memhead *)ptr_val;
+	mem = mem_head(ptr);
+
+	if (mem->magic != MEM_MAGIC) {
+		fail("xmemcheck: ill head (ptr=%p)", ptr);
+		xmemcheck_failed = 1;
+		return -1;
 	}
 
 	// ID check
@@ -94,18 +215,18 @@ int xmemcheck(void *ptr)
 		return -1;
 	}
 
-	// border check
-	head = ((unsigned char *)(mem)) + sizeof(struct memhead);
-	rptr = ((unsigned char *)(mem)) + sizeof(struct memhead) + sizeof(memcheck);
-	tail = ((unsigned char *)(mem)) + sizeof(struct memhead) + sizeof(memcheck) + mem->size;
+	if (!mem->guard) {
+		return 0;
+	}
 
-	if (memcmp(head, memcheck, sizeof(memcheck))) {
-		fail("xmemcheck: ill head in %s (ptr=%p)", memname[mem->ID], (void *)rptr);
+	// border check
+	if (memcmp(mem_base(mem), memcheck, sizeof(memcheck))) {
+		fail("xmemcheck: ill head in %s (ptr=%p)", memname[mem->ID], ptr);
 		xmemcheck_failed = 1;
 		return -1;
 	}
-	if (memcmp(tail, memcheck, sizeof(memcheck))) {
-		fail("xmemcheck: ill tail in %s (ptr=%p)", memname[mem->ID], (void *)rptr);
+	if (memcmp(rptr + mem->size, memcheck, sizeof(memcheck))) {
+		fail("xmemcheck: ill tail in %s (ptr=%p)", memname[mem->ID], ptr);
 		xmemcheck_failed = 1;
 		return -1;
 	}
@@ -115,8 +236,8 @@ int xmemcheck(void *ptr)
 
 void *xmalloc(size_t size, uint8_t ID)
 {
-	struct memhead *mem;
-	unsigned char *head, *tail, *rptr;
+	void *base;
+	int guard;
 
 	if (!memcheckset) {
 		for (memcheckset = 0; memcheckset < sizeof(memcheck); memcheckset++) {
@@ -129,46 +250,22 @@ void *xmalloc(size_t size, uint8_t ID)
 		return NULL;
 	}
 
-	memptrused++;
-
-	mem = CALLOC(1, sizeof(struct memhead) + sizeof(memcheck) + size + sizeof(memcheck));
-	if (!mem) {
-		fail("OUT OF MEMORY !!!");
-		return NULL;
-	}
-
-	memused += sizeof(struct memhead) + sizeof(memcheck) + size + sizeof(memcheck);
-
 	if (ID >= MAX_MEM) {
 		fail("xmalloc: ill mem id");
 		return NULL;
 	}
 
-	mem->ID = ID;
-	mem->size = size;
-	memsize[mem->ID] += mem->size;
-	memptrs[mem->ID] += 1;
-	memsize[0] += mem->size;
-	memptrs[0] += 1;
+	guard = mem_want_guard();
 
-	if (memsize[0] > maxmemsize) {
-		maxmemsize = memsize[0];
-	}
-	if (memptrs[0] > maxmemptrs) {
-		maxmemptrs = memptrs[0];
+	base = CALLOC(1, mem_total(size, guard));
+	if (!base) {
+		fail("OUT OF MEMORY !!!");
+		return NULL;
 	}
 
-	head = ((unsigned char *)(mem)) + sizeof(struct memhead);
-	rptr = ((unsigned char *)(mem)) + sizeof(struct memhead) + sizeof(memcheck);
-	tail = ((unsigned char *)(mem)) + sizeof(struct memhead) + sizeof(memcheck) + mem->size;
-
-	// set memcheck
-	memcpy(head, memcheck, sizeof(memcheck));
-	memcpy(tail, memcheck, sizeof(memcheck));
+	update_mem_stats_add(ID, size, guard);
 
-	xmemcheck(rptr);
-
-	return rptr;
+	return mem_setup(base, size, ID, guard);
 }
 
 char *xstrdup(const char *src, uint8_t ID)
@@ -204,23 +301,16 @@ void xfree(void *ptr)
 		return;
 	}
 
-	// get mem
-	{
-		uintptr_t ptr_val = (uintptr_t)ptr;
-		ptr_val -= sizeof(struct memhead) + sizeof(memcheck);
-		mem = (struct memhead *)ptr_val;
-	}
+	mem = mem_head(ptr);
 
-	update_mem_stats_remove(mem->ID, (size_t)mem->size);
+	update_mem_stats_remove(mem->ID, mem->size, mem->guard);
 
 	// free
-	FREE(mem);
+	FREE(mem_base(mem));
 }
 
 void xinfo(void *ptr)
 {
-	struct memhead *mem;
-
 	if (!ptr) {
 		printf("NULL");
 		return;
@@ -230,131 +320,78 @@ void xinfo(void *ptr)
 		return;
 	}
 
-	// get mem
-	{
-		uintptr_t ptr_val = (uintptr_t)ptr;
-		ptr_val -= sizeof(struct memhead) + sizeof(memcheck);
-		mem = (struct memhead *)ptr_val;
-	}
-
-	printf("%zu bytes", mem->size);
+	printf("%zu bytes", mem_head(ptr)->size);
 }
 
 // Verify struct size
 _Static_assert(sizeof(struct memhead) == 16, "memhead must be 16 bytes");
 
-void *xrealloc(void *ptr, size_t size, uint8_t ID)
+// Resizes a block, keeping its guard mode. New bytes are zeroed if clear is set.
+static void *mem_resize(void *ptr, size_t size, uint8_t ID, int clear, const char *who)
 {
 	struct memhead *mem;
-	unsigned char *head, *tail, *rptr;
+	uint8_t old_ID;
+	size_t old_size;
+	int guard;
+	unsigned char *base, *rptr;
 
-	if (!ptr) {
-		if (size > INT_MAX) {
-			return NULL;
-		}
-		return xmalloc(size, ID);
-	}
-	if (!size) {
-		xfree(ptr);
-		return NULL;
-	}
 	if (xmemcheck(ptr)) {
 		return NULL;
 	}
 
-	{
-		uintptr_t ptr_val = (uintptr_t)ptr;
-		ptr_val -= sizeof(struct memhead) + sizeof(memcheck);
-		mem = (struct memhead *)ptr_val;
-	}
-
-	uint8_t old_ID = mem->ID;
-	size_t old_size = mem->size;
-	update_mem_stats_remove(old_ID, old_size);
+	mem = mem_head(ptr);
+	old_ID = mem->ID;
+	old_size = mem->size;
+	guard = mem->guard;
 
-	// realloc
-	struct memhead *new_mem = REALLOC(mem, sizeof(struct memhead) + sizeof(memcheck) + size + sizeof(memcheck));
-	if (!new_mem) {
-		// Restore counters since realloc failed
-		update_mem_stats_add(old_ID, old_size);
-		fail("xrealloc: OUT OF MEMORY !!!");
+	base = REALLOC(mem_base(mem), mem_total(size, guard));
+	if (!base) {
+		fail("%s: OUT OF MEMORY !!!", who);
 		return NULL;
 	}
-	mem = new_mem;
 
-	if (size > INT_MAX) {
-		fail("xrealloc: size too large");
-		return NULL;
-	}
-	update_mem_stats_add(ID, size);
-	mem->ID = ID; // Update ID in case it changed
-	mem->size = size;
+	update_mem_stats_remove(old_ID, old_size, guard);
+	update_mem_stats_add(ID, size, guard);
 
-	head = ((unsigned char *)(mem)) + sizeof(struct memhead);
-	rptr = ((unsigned char *)(mem)) + sizeof(struct memhead) + sizeof(memcheck);
-	tail = ((unsigned char *)(mem)) + sizeof(struct memhead) + sizeof(memcheck) + mem->size;
-
-	// set memcheck
-	memcpy(head, memcheck, sizeof(memcheck));
-	memcpy(tail, memcheck, sizeof(memcheck));
+	rptr = mem_setup(base, size, ID, guard);
+	if (clear && size > old_size) {
+		bzero(rptr + old_size, size - old_size);
+	}
 
 	return rptr;
 }
 
-void *xrecalloc(void *ptr, size_t size, uint8_t ID)
+void *xrealloc(void *ptr, size_t size, uint8_t ID)
 {
-	struct memhead *mem;
-	unsigned char *head, *tail, *rptr;
-
 	if (!ptr) {
+		if (size > INT_MAX) {
+			return NULL;
+		}
 		return xmalloc(size, ID);
 	}
 	if (!size) {
 		xfree(ptr);
 		return NULL;
 	}
-	if (xmemcheck(ptr)) {
+	if (size > INT_MAX) {
+		fail("xrealloc: size too large");
 		return NULL;
 	}
 
-	{
-		uintptr_t ptr_val = (uintptr_t)ptr;
-		ptr_val -= sizeof(struct memhead) + sizeof(memcheck);
-		mem = (struct memhead *)ptr_val;
-	}
-
-	uint8_t old_ID = mem->ID;
-	size_t old_size = mem->size;
-	update_mem_stats_remove(old_ID, old_size);
+	return mem_resize(ptr, size, ID, 0, "xrealloc");
+}
 
-	// realloc
-	struct memhead *new_mem = REALLOC(mem, sizeof(struct memhead) + sizeof(memcheck) + size + sizeof(memcheck));
-	if (!new_mem) {
-		// Restore counters since realloc failed
-		update_mem_stats_add(old_ID, old_size);
-		fail("xrecalloc: OUT OF MEMORY !!!");
-		return NULL;
+void *xrecalloc(void *ptr, size_t size, uint8_t ID)
+{
+	if (!ptr) {
+		return xmalloc(size, ID);
 	}
-	mem = new_mem;
-
-	if (size - old_size > 0) {
-		bzero(
-		    ((unsigned char *)(mem)) + sizeof(struct memhead) + sizeof(memcheck) + old_size, (size_t)(size - old_size));
+	if (!size) {
+		xfree(ptr);
+		return NULL;
 	}
 
-	update_mem_stats_add(ID, size);
-	mem->ID = ID; // Update ID in case it changed
-	mem->size = size;
-
-	head = ((unsigned char *)(mem)) + sizeof(struct memhead);
-	rptr = ((unsigned char *)(mem)) + sizeof(struct memhead) + sizeof(memcheck);
-	tail = ((unsigned char *)(mem)) + sizeof(struct memhead) + sizeof(memcheck) + mem->size;
-
-	// set memcheck
-	memcpy(head, memcheck, sizeof(memcheck));
-	memcpy(tail, memcheck, sizeof(memcheck));
-
-	return rptr;
+	return mem_resize(ptr, size, ID, 1, "xrecalloc");
 }
 
 void list_mem(void)
@@ -362,6 +399,8 @@ void list_mem(void)
 	int i, flag = 0;
 	long long mem_tex = sdl_get_mem_tex();
 
+	mem_stats_merge();
+
 	note("--mem----------------------");
 	for (i = 1; i < MAX_MEM; i++) {
 		if (memsize[i] || memptrs[i]) {
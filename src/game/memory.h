@@ -39,8 +39,26 @@
 struct memhead {
 	size_t size;
 	uint8_t ID;
+	uint8_t guard; // block has canaries
+	uint16_t magic;
 };
 
+// Canaries around allocations: none, every MEM_GUARD_SAMPLE-th block, or all
+#define MEM_GUARD_NONE    0
+#define MEM_GUARD_SAMPLED 1
+#define MEM_GUARD_FULL    2
+#define MEM_GUARD_SAMPLE  64
+
+#ifndef MEM_GUARD_DEFAULT
+#ifdef DEVELOPER
+#define MEM_GUARD_DEFAULT MEM_GUARD_FULL
+#else
+#define MEM_GUARD_DEFAULT MEM_GUARD_SAMPLED
+#endif
+#endif
+
+extern int mem_guard; // MEM_GUARD_*, may be changed at any time
+
 // Memory allocation functions with tracking
 void *xmalloc(size_t size, uint8_t ID);
 void *xrealloc(void *ptr, size_t size, uint8_t ID);
@@ -50,8 +68,9 @@ char *xstrdup(const char *src, uint8_t ID);
 int xmemcheck(void *ptr);
 void xinfo(void *ptr);
 void list_mem(void);
+void mem_stats_merge(void);
 
-// Memory statistics (exported for debugging/monitoring)
+// Memory statistics (exported for debugging/monitoring), current as of the last mem_stats_merge()
 extern size_t memused;
 extern int memptrused;
 extern size_t maxmemsize;
@@ -0,0 +1,226 @@
+/*
+ * Part of Astonia Client (c) Daniel Brockhaus. Please read license.txt.
+ *
+ * Frame profiler
+ *
+ * Each thread that records a zone claims one slot with its own ring buffer, so
+ * recording never takes a lock. The rings are allocated on the main thread
+ * when a capture starts. prof_frame() is called once per frame by main_loop(),
+ * counts down the capture window and writes trace.json when it closes.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL3/SDL.h>
+
+#include "astonia.h"
+#include "game/profile.h"
+
+#define PROF_MAX_THREADS 16
+#define PROF_RING_SIZE   16384 // events per thread, must be a power of two
+
+struct prof_event {
+	const char *name;
+	uint64_t start, end;
+};
+
+struct prof_ring {
+	char name[32];
+	uint32_t head; // total events written, the writer is the owning thread only
+	struct prof_event *events;
+};
+
+int prof_active = 0;
+
+static struct prof_ring rings[PROF_MAX_THREADS];
+static int prof_threads = 0;
+static _Thread_local int prof_slot = -1;
+
+static int prof_pending = 0; // frames requested by prof_capture(), starts with the next frame
+static int prof_frames_left = 0;
+static uint64_t prof_start = 0;
+
+uint64_t prof_now(void)
+{
+	return SDL_GetTicksNS();
+}
+
+static int prof_claim_slot(void)
+{
+	if (prof_slot == -1) {
+		int slot = __atomic_fetch_add(&prof_threads, 1, __ATOMIC_RELAXED);
+		if (slot >= PROF_MAX_THREADS) {
+			slot = PROF_MAX_THREADS; // out of slots, this thread won't be recorded
+		} else if (!rings[slot].name[0]) {
+			snprintf(rings[slot].name, sizeof(rings[slot].name), "thread %d", slot);
+		}
+		prof_slot = slot;
+	}
+	return prof_slot;
+}
+
+// Name the calling thread in the trace. Call once at thread start.
+void prof_thread_name(const char *name)
+{
+	int slot = prof_claim_slot();
+
+	if (slot < PROF_MAX_THREADS) {
+		snprintf(rings[slot].name, sizeof(rings[slot].name), "%s", name);
+	}
+}
+
+void prof_record(const char *name, uint64_t start, uint64_t end)
+{
+	struct prof_ring *ring;
+	struct prof_event *ev;
+	int slot;
+
+	// the capture may have closed while this zone was running
+	if (!__atomic_load_n(&prof_active, __ATOMIC_ACQUIRE)) {
+		return;
+	}
+
+	slot = prof_claim_slot();
+	if (slot >= PROF_MAX_THREADS) {
+		return;
+	}
+
+	ring = &rings[slot];
+	if (!ring->events) {
+		return;
+	}
+
+	ev = &ring->events[ring->head & (PROF_RING_SIZE - 1)];
+	ev->name = name;
+	ev->start = start;
+	ev->end = end;
+	__atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+// Request a trace of the next 'frames' frames. Returns 0 on success.
+int prof_capture(int frames)
+{
+	int n;
+
+	if (frames < 1 || prof_pending || prof_frames_left) {
+		return -1;
+	}
+
+	for (n = 0; n < PROF_MAX_THREADS; n++) {
+		if (!rings[n].events) {
+			rings[n].events = xmalloc(PROF_RING_SIZE * sizeof(struct prof_event), MEM_GLOB);
+			if (!rings[n].events) {
+				return -1;
+			}
+		}
+	}
+
+	prof_pending = frames;
+
+	return 0;
+}
+
+static void prof_write_string(FILE *fp, const char *str)
+{
+	fputc('"', fp);
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\') {
+			fputc('\\', fp);
+		}
+		fputc(*str, fp);
+	}
+	fputc('"', fp);
+}
+
+static void prof_dump(void)
+{
+	FILE *fp;
+	char filename[MAX_PATH];
+	int n, first = 1, cnt = 0, threads;
+
+	if (localdata) {
+		snprintf(filename, sizeof(filename), "%strace.json", localdata);
+	} else {
+		snprintf(filename, sizeof(filename), "bin/data/trace.json");
+	}
+
+	fp = fopen(filename, "w");
+	if (!fp) {
+		warn("Could not write trace to %s", filename);
+		return;
+	}
+
+	threads = min(__atomic_load_n(&prof_threads, __ATOMIC_RELAXED), PROF_MAX_THREADS);
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	for (n = 0; n < threads; n++) {
+		struct prof_ring *ring = &rings[n];
+		uint32_t head, i, from;
+
+		fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n",
+		    n);
+		prof_write_string(fp, ring->name);
+		fprintf(fp, "}}");
+		first = 0;
+
+		head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		from = head > PROF_RING_SIZE ? head - PROF_RING_SIZE : 0;
+
+		for (i = from; i < head; i++) {
+			struct prof_event *ev = &ring->events[i & (PROF_RING_SIZE - 1)];
+
+			if (ev->start < prof_start) {
+				continue;
+			}
+
+			fprintf(fp, ",\n{\"name\":");
+			prof_write_string(fp, ev->name);
+			fprintf(fp, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", n,
+			    (double)(ev->start - prof_start) / 1000.0, (double)(ev->end - ev->start) / 1000.0);
+			cnt++;
+		}
+	}
+
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+
+	addline("Wrote %d trace events to %s", cnt, filename);
+}
+
+// Called once per frame from the main loop. Opens and closes the capture window.
+void prof_frame(void)
+{
+	if (prof_frames_left) {
+		if (--prof_frames_left == 0) {
+			__atomic_store_n(&prof_active, 0, __ATOMIC_RELEASE);
+			prof_dump();
+		}
+		return;
+	}
+
+	if (prof_pending) {
+		int n;
+
+		for (n = 0; n < PROF_MAX_THREADS; n++) {
+			__atomic_store_n(&rings[n].head, 0, __ATOMIC_RELAXED);
+		}
+		prof_frames_left = prof_pending;
+		prof_pending = 0;
+		prof_start = prof_now();
+		__atomic_store_n(&prof_active, 1, __ATOMIC_RELEASE);
+	}
+}
+
+void prof_exit(void)
+{
+	int n;
+
+	__atomic_store_n(&prof_active, 0, __ATOMIC_RELEASE);
+
+	for (n = 0; n < PROF_MAX_THREADS; n++) {
+		xfree(rings[n].events);
+		rings[n].events = NULL;
+	}
+}
@@ -0,0 +1,54 @@
+/*
+ * Part of Astonia Client (c) Daniel Brockhaus. Please read license.txt.
+ *
+ * Frame profiler
+ *
+ * Scoped timing zones recorded into per-thread ring buffers and dumped as
+ * Chrome trace JSON (chrome://tracing, ui.perfetto.dev) for a window of frames.
+ * While no capture is running a zone costs one load and one branch.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+struct prof_zone {
+	const char *name;
+	uint64_t start; // 0 if the zone began while no capture was running
+};
+
+extern int prof_active;
+
+uint64_t prof_now(void);
+void prof_record(const char *name, uint64_t start, uint64_t end);
+
+static inline struct prof_zone prof_zone_begin(const char *name)
+{
+	struct prof_zone zone = {name, 0};
+
+	if (__atomic_load_n(&prof_active, __ATOMIC_RELAXED)) {
+		zone.start = prof_now();
+	}
+	return zone;
+}
+
+static inline void prof_zone_end(struct prof_zone *zone)
+{
+	if (zone->start) {
+		prof_record(zone->name, zone->start, prof_now());
+	}
+}
+
+void prof_thread_name(const char *name);
+int prof_capture(int frames);
+void prof_frame(void);
+void prof_exit(void);
+
+// PROF_ZONE("name") times the rest of the enclosing block.
+#define PROF_CAT2(a, b) a##b
+#define PROF_CAT(a, b)  PROF_CAT2(a, b)
+#define PROF_ZONE(name)                                                                                                \
+	struct prof_zone PROF_CAT(prof_zone_, __LINE__) __attribute__((cleanup(prof_zone_end))) = prof_zone_begin(name)
+
+#endif // PROFILE_H
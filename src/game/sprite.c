@@ -127,8 +127,8 @@ DLL_EXPORT unsigned int _trans_asprite(map_index_t mn, unsigned int sprite, tick
 	const AnimatedVariant *v = sprite_config_lookup_animated(sprite);
 
 	/* Apply variant (returns sprite unchanged if not found) */
-	unsigned int result =
-	    sprite_config_apply_animated(v, mn, sprite, attick, &scale, &cr, &cg, &cb, &light, &sat, &c1, &c2, &c3, &shine);
+	unsigned int result = sprite_config_apply_animated(
+	    v, mn, MAPDX, sprite, attick, &scale, &cr, &cg, &cb, &light, &sat, &c1, &c2, &c3, &shine);
 
 	/* Assign to output pointers (NULL pointers are allowed) */
 	if (pscale) {
@@ -300,12 +300,13 @@ DLL_EXPORT int _get_player_sprite(int nr, int zdir, int action, int step, int du
 	return base;
 }
 
+static const int dirxadd[8] = {+1, 0, -1, -2, -1, 0, +1, +2};
+static const int diryadd[8] = {+1, +2, +1, 0, -1, -2, -1, 0};
+
 void (*trans_csprite)(map_index_t mn, struct map *cmap, tick_t attick) = _trans_csprite;
 
 DLL_EXPORT void _trans_csprite(map_index_t mn, struct map *cmap, tick_t attick)
 {
-	int dirxadd[8] = {+1, 0, -1, -2, -1, 0, +1, +2};
-	int diryadd[8] = {+1, +2, +1, 0, -1, -2, -1, 0};
 	unsigned int csprite;
 	int scale, cr, cg, cb, light, sat, c1, c2, c3, shine;
 
@@ -348,6 +349,32 @@ DLL_EXPORT void _trans_csprite(map_index_t mn, struct map *cmap, tick_t attick)
 	}
 }
 
+// Moves walking characters frac/TICK_FRAC of a step further than the tick
+// put them, for frames shown between two ticks. Works from step, so calling
+// it again with another frac is fine.
+void set_map_interpolation(struct map *cmap, int frac)
+{
+	int i, step;
+	map_index_t mn;
+
+	if (frac <= 0) {
+		return;
+	}
+
+	for (i = 0; i < maxquick; i++) {
+		mn = quick[i].mn[4];
+
+		if (!cmap[mn].csprite || !cmap[mn].rlight || !cmap[mn].duration || cmap[mn].action != 1) {
+			continue;
+		}
+
+		step = min(cmap[mn].step * TICK_FRAC + frac, cmap[mn].duration * TICK_FRAC);
+
+		cmap[mn].xadd = (char)(20 * step * dirxadd[cmap[mn].dir - 1] / (cmap[mn].duration * TICK_FRAC));
+		cmap[mn].yadd = (char)(10 * step * diryadd[cmap[mn].dir - 1] / (cmap[mn].duration * TICK_FRAC));
+	}
+}
+
 int (*get_lay_sprite)(int sprite, int lay) = sprite_config_get_lay_sprite;
 
 int (*get_offset_sprite)(int sprite, int *px, int *py) = sprite_config_get_offset_sprite;
@@ -3,11 +3,22 @@
  *
  * Loads sprite variant definitions from JSON files and provides
  * O(1) lookups via hash tables.
+ *
+ * The spritecfg helper compiles the JSON files into a binary blob
+ * (res/config/sprite_config.bin) with dense sprite-ID-indexed arrays.
+ * sprite_config_init() maps the blob when it matches the JSON files and
+ * parses the JSON otherwise.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 
 #include "sprite_config.h"
 #include "lib/cjson/cJSON.h"
@@ -32,11 +43,69 @@ static CharacterVariantTable char_table = {NULL, 0, 0};
 static AnimatedVariantTable anim_table = {NULL, 0, 0};
 static SpriteMetadataTable meta_table = {NULL, 0, 0};
 
+/* Default config files, in the order they are stamped into the binary blob */
+#define CHAR_JSON_PATH "res/config/character_variants.json"
+#define ANIM_JSON_PATH "res/config/animated_variants.json"
+#define META_JSON_PATH "res/config/sprite_metadata.json"
+#define BLOB_PATH      "res/config/sprite_config.bin"
+
+#define BLOB_MAGIC   0x42435341 /* "ASCB" */
+#define BLOB_VERSION 1
+#define BLOB_ALIGN   8
+
+/* Identifies one JSON source file the blob was compiled from */
+struct blob_stamp {
+	uint64_t size; /* 0 = file did not exist */
+	int64_t mtime;
+	uint64_t hash; /* FNV-1a of the contents, checked when only the mtime differs */
+};
+
+/*
+ * Dense index section: index[id - min] is 0 for no entry, else the entry
+ * number plus one. Both offsets are from the start of the blob.
+ */
+struct blob_section {
+	uint32_t min, span;
+	uint32_t count;
+	uint32_t index_off, entry_off;
+};
+
+struct blob_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size; /* total blob size */
+	uint16_t char_size, anim_size, meta_size; /* sizeof() of the entry structs */
+	uint16_t _padding;
+	struct blob_stamp stamp[3];
+	struct blob_section sec[3];
+};
+
+enum { BLOB_CHAR, BLOB_ANIM, BLOB_META };
+
+/* Mapped blob, used instead of the hash tables while loaded */
+static struct {
+	const struct blob_header *hdr;
+	void *base;
+	size_t size;
+	const uint16_t *index[3];
+	const CharacterVariant *chars;
+	const AnimatedVariant *anims;
+	const SpriteMetadata *metas;
+} blob;
+
+static void blob_unmap(void);
+static void blob_detach(void);
+static uint32_t blob_slot(int sec, uint32_t id);
+static int init_metadata_table(void);
+static int insert_metadata(const SpriteMetadata *m);
+
 /*
  * Initialize hash tables with empty slots.
  */
 static int init_tables(void)
 {
+	blob_detach();
+
 	if (char_table.entries == NULL) {
 		char_table.entries = xmalloc(CHAR_TABLE_SIZE * sizeof(CharacterVariant), MEM_GAME);
 		if (!char_table.entries) {
@@ -536,14 +605,20 @@ static char *load_file(const char *path, size_t *out_len)
 
 int sprite_config_init(void)
 {
+	if (sprite_config_load_binary(BLOB_PATH) == 0) {
+		note("sprite_config: Mapped %u character variants, %u animated variants, %u metadata entries from %s",
+		    blob.hdr->sec[BLOB_CHAR].count, blob.hdr->sec[BLOB_ANIM].count, blob.hdr->sec[BLOB_META].count, BLOB_PATH);
+		return 0;
+	}
+
 	if (init_tables() < 0) {
 		return -1;
 	}
 
 	/* Try to load default config files */
-	int char_loaded = sprite_config_load_characters("res/config/character_variants.json");
-	int anim_loaded = sprite_config_load_animated("res/config/animated_variants.json");
-	int meta_loaded = sprite_config_load_metadata("res/config/sprite_metadata.json");
+	int char_loaded = sprite_config_load_characters(CHAR_JSON_PATH);
+	int anim_loaded = sprite_config_load_animated(ANIM_JSON_PATH);
+	int meta_loaded = sprite_config_load_metadata(META_JSON_PATH);
 
 	if (char_loaded < 0 && anim_loaded < 0 && meta_loaded < 0) {
 		note("sprite_config: No config files found, using empty config");
@@ -555,7 +630,7 @@ int sprite_config_init(void)
 	return 0;
 }
 
-void sprite_config_shutdown(void)
+static void free_tables(void)
 {
 	if (char_table.entries) {
 		xfree(char_table.entries);
@@ -579,6 +654,12 @@ void sprite_config_shutdown(void)
 	}
 }
 
+void sprite_config_shutdown(void)
+{
+	blob_unmap();
+	free_tables();
+}
+
 DLL_EXPORT int sprite_config_load_characters(const char *path)
 {
 	if (init_tables() < 0) {
@@ -717,6 +798,8 @@ int sprite_config_load_from_buffer(const char *json_data, size_t len)
 
 void sprite_config_clear(void)
 {
+	blob_detach();
+
 	if (char_table.entries) {
 		memset(char_table.entries, 0, char_table.capacity * sizeof(CharacterVariant));
 		char_table.count = 0;
@@ -730,6 +813,11 @@ void sprite_config_clear(void)
 
 const CharacterVariant *sprite_config_lookup_character(int id)
 {
+	if (blob.hdr) {
+		uint32_t n = id > 0 ? blob_slot(BLOB_CHAR, (uint32_t)id) : 0;
+		return n ? &blob.chars[n - 1] : NULL;
+	}
+
 	if (!char_table.entries || id <= 0) {
 		return NULL;
 	}
@@ -750,6 +838,11 @@ const CharacterVariant *sprite_config_lookup_character(int id)
 
 const AnimatedVariant *sprite_config_lookup_animated(unsigned int id)
 {
+	if (blob.hdr) {
+		uint32_t n = blob_slot(BLOB_ANIM, id);
+		return n ? &blob.anims[n - 1] : NULL;
+	}
+
 	if (!anim_table.entries || id == 0) {
 		return NULL;
 	}
@@ -825,9 +918,10 @@ int sprite_config_apply_character(const CharacterVariant *v, int csprite, int *p
 	return v->base_sprite;
 }
 
-unsigned int sprite_config_apply_animated(const AnimatedVariant *v, map_index_t mn, unsigned int sprite, tick_t attick,
-    unsigned char *pscale, unsigned char *pcr, unsigned char *pcg, unsigned char *pcb, unsigned char *plight,
-    unsigned char *psat, unsigned short *pc1, unsigned short *pc2, unsigned short *pc3, unsigned short *pshine)
+unsigned int sprite_config_apply_animated(const AnimatedVariant *v, map_index_t mn, unsigned int mapdx,
+    unsigned int sprite, tick_t attick, unsigned char *pscale, unsigned char *pcr, unsigned char *pcg,
+    unsigned char *pcb, unsigned char *plight, unsigned char *psat, unsigned short *pc1, unsigned short *pc2,
+    unsigned short *pc3, unsigned short *pshine)
 {
 	/* Initialize defaults */
 	*pscale = 100;
@@ -875,8 +969,8 @@ unsigned int sprite_config_apply_animated(const AnimatedVariant *v, map_index_t
 		case ANIM_POSITION_CYCLE:
 			/* Position-aware: includes map position for desync */
 			{
-				unsigned int pos_offset = (unsigned int)((mn % (size_t)MAPDX + (size_t)originx) +
-				                                         (mn / (size_t)MAPDX + (size_t)originy) * 256);
+				unsigned int pos_offset = (unsigned int)((mn % (size_t)mapdx + (size_t)originx) +
+				                                         (mn / (size_t)mapdx + (size_t)originy) * 256);
 				frame = (pos_offset + attick / div) % nframes;
 				result = v->base_sprite + frame;
 			}
@@ -899,8 +993,8 @@ unsigned int sprite_config_apply_animated(const AnimatedVariant *v, map_index_t
 		case ANIM_FLICKER:
 			/* Random flicker */
 			{
-				unsigned int pos_offset = (unsigned int)((mn % (size_t)MAPDX + (size_t)originx) +
-				                                         (mn / (size_t)MAPDX + (size_t)originy) * 256);
+				unsigned int pos_offset = (unsigned int)((mn % (size_t)mapdx + (size_t)originx) +
+				                                         (mn / (size_t)mapdx + (size_t)originy) * 256);
 				unsigned int rand_val = (unsigned int)rrand(v->random_range + 1);
 				frame = (pos_offset + attick / div + rand_val) % nframes;
 				result = v->base_sprite + frame;
@@ -910,8 +1004,8 @@ unsigned int sprite_config_apply_animated(const AnimatedVariant *v, map_index_t
 		case ANIM_RANDOM_OFFSET:
 			/* Random offset with threshold-based alternative */
 			{
-				unsigned int pos_offset = (unsigned int)((mn % (size_t)MAPDX + (size_t)originx) +
-				                                         (mn / (size_t)MAPDX + (size_t)originy) * 256);
+				unsigned int pos_offset = (unsigned int)((mn % (size_t)mapdx + (size_t)originx) +
+				                                         (mn / (size_t)mapdx + (size_t)originy) * 256);
 				unsigned int rand_val = (unsigned int)rrand(v->random_range + 1);
 				unsigned int help = pos_offset + attick / div + rand_val;
 				/* Use branches[0] for threshold if available */
@@ -936,8 +1030,8 @@ unsigned int sprite_config_apply_animated(const AnimatedVariant *v, map_index_t
 		case ANIM_MULTI_BRANCH:
 			/* Multi-branch conditional */
 			{
-				unsigned int pos_offset = (unsigned int)((mn % (size_t)MAPDX + (size_t)originx) +
-				                                         (mn / (size_t)MAPDX + (size_t)originy) * 256);
+				unsigned int pos_offset = (unsigned int)((mn % (size_t)mapdx + (size_t)originx) +
+				                                         (mn / (size_t)mapdx + (size_t)originy) * 256);
 				unsigned int help = pos_offset + attick / div;
 
 				/* Find matching branch */
@@ -1046,6 +1140,16 @@ unsigned int sprite_config_apply_animated(const AnimatedVariant *v, map_index_t
 
 void sprite_config_get_stats(size_t *char_count, size_t *anim_count)
 {
+	if (blob.hdr) {
+		if (char_count) {
+			*char_count = blob.hdr->sec[BLOB_CHAR].count;
+		}
+		if (anim_count) {
+			*anim_count = blob.hdr->sec[BLOB_ANIM].count;
+		}
+		return;
+	}
+
 	if (char_count) {
 		*char_count = char_table.count;
 	}
@@ -1060,6 +1164,8 @@ void sprite_config_get_stats(size_t *char_count, size_t *anim_count)
 
 static int init_metadata_table(void)
 {
+	blob_detach();
+
 	if (meta_table.entries == NULL) {
 		meta_table.entries = xmalloc(META_TABLE_SIZE * sizeof(SpriteMetadata), MEM_GAME);
 		if (!meta_table.entries) {
@@ -1211,6 +1317,11 @@ DLL_EXPORT int sprite_config_load_metadata(const char *path)
 
 const SpriteMetadata *sprite_config_lookup_metadata(unsigned int id)
 {
+	if (blob.hdr) {
+		uint32_t n = blob_slot(BLOB_META, id);
+		return n ? &blob.metas[n - 1] : NULL;
+	}
+
 	if (!meta_table.entries || id == 0) {
 		return NULL;
 	}
@@ -1306,3 +1417,396 @@ int sprite_config_no_lighting_sprite(unsigned int sprite)
 	const SpriteMetadata *m = sprite_config_lookup_metadata(sprite);
 	return m ? m->no_lighting : 0;
 }
+
+/*
+ * Binary config (res/config/sprite_config.bin)
+ */
+
+static uint64_t fnv1a64(const char *data, size_t len)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (unsigned char)data[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+static uint64_t hash_file(const char *path)
+{
+	size_t len;
+	char *buf = load_file(path, &len);
+	if (!buf) {
+		return 0;
+	}
+
+	uint64_t hash = fnv1a64(buf, len);
+	xfree(buf);
+
+	return hash;
+}
+
+/*
+ * Check a JSON file against the stamp taken when the blob was compiled. A
+ * differing mtime alone (checkout, copied install) falls back to the hash.
+ */
+static int blob_stamp_matches(const char *path, const struct blob_stamp *st)
+{
+	struct stat sb;
+
+	if (stat(path, &sb) != 0) {
+		return st->size == 0;
+	}
+	if ((uint64_t)sb.st_size != st->size) {
+		return 0;
+	}
+	if ((int64_t)sb.st_mtime == st->mtime) {
+		return 1;
+	}
+
+	return hash_file(path) == st->hash;
+}
+
+static void blob_stamp_file(const char *path, struct blob_stamp *st)
+{
+	struct stat sb;
+
+	memset(st, 0, sizeof(*st));
+	if (stat(path, &sb) != 0 || sb.st_size <= 0) {
+		return;
+	}
+	st->size = (uint64_t)sb.st_size;
+	st->mtime = (int64_t)sb.st_mtime;
+	st->hash = hash_file(path);
+}
+
+static uint32_t blob_slot(int sec, uint32_t id)
+{
+	uint32_t off = id - blob.hdr->sec[sec].min; /* wraps for id < min */
+
+	if (off >= blob.hdr->sec[sec].span) {
+		return 0;
+	}
+
+	return blob.index[sec][off];
+}
+
+static void blob_unmap(void)
+{
+	if (!blob.base) {
+		return;
+	}
+
+#ifdef _WIN32
+	xfree(blob.base);
+#else
+	munmap(blob.base, blob.size);
+#endif
+	memset(&blob, 0, sizeof(blob));
+}
+
+/*
+ * Map the blob read-only. Windows has no mmap(), the blob is read into
+ * memory there, which still skips the JSON parsing.
+ */
+static void *blob_map(const char *path, size_t *psize)
+{
+	void *base;
+	size_t size;
+
+#ifdef _WIN32
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		return NULL;
+	}
+
+	fseek(f, 0, SEEK_END);
+	long len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if (len < (long)sizeof(struct blob_header)) {
+		fclose(f);
+		return NULL;
+	}
+
+	size = (size_t)len;
+	base = xmalloc(size, MEM_GAME);
+	if (!base) {
+		fclose(f);
+		return NULL;
+	}
+	if (fread(base, 1, size, f) != size) {
+		xfree(base);
+		fclose(f);
+		return NULL;
+	}
+	fclose(f);
+#else
+	struct stat sb;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	if (fstat(fd, &sb) != 0 || sb.st_size < (off_t)sizeof(struct blob_header)) {
+		close(fd);
+		return NULL;
+	}
+
+	size = (size_t)sb.st_size;
+	base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		return NULL;
+	}
+#endif
+
+	*psize = size;
+	return base;
+}
+
+static int blob_check_section(const struct blob_header *hdr, int sec, size_t entry_size)
+{
+	const struct blob_section *s = &hdr->sec[sec];
+	const uint16_t *index;
+
+	if (s->count > 65535 || s->span > hdr->size / sizeof(uint16_t) || s->index_off % sizeof(uint16_t) ||
+	    s->entry_off % BLOB_ALIGN || s->index_off > hdr->size - s->span * sizeof(uint16_t) ||
+	    s->entry_off > hdr->size || s->count > (hdr->size - s->entry_off) / entry_size) {
+		return -1;
+	}
+
+	/* The index is trusted by the lookups, make sure it can't point past the entries */
+	index = (const uint16_t *)(const void *)((const char *)hdr + s->index_off);
+	for (uint32_t i = 0; i < s->span; i++) {
+		if (index[i] > s->count) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int sprite_config_load_binary(const char *path)
+{
+	const struct blob_header *hdr;
+	void *base;
+	size_t size;
+
+	base = blob_map(path, &size);
+	if (!base) {
+		return -1;
+	}
+
+	hdr = base;
+	if (hdr->magic != BLOB_MAGIC || hdr->version != BLOB_VERSION || hdr->size != size ||
+	    hdr->char_size != sizeof(CharacterVariant) || hdr->anim_size != sizeof(AnimatedVariant) ||
+	    hdr->meta_size != sizeof(SpriteMetadata) || blob_check_section(hdr, BLOB_CHAR, sizeof(CharacterVariant)) ||
+	    blob_check_section(hdr, BLOB_ANIM, sizeof(AnimatedVariant)) ||
+	    blob_check_section(hdr, BLOB_META, sizeof(SpriteMetadata))) {
+		warn("sprite_config: %s is invalid or from another client version, rebuild it with spritecfg", path);
+		goto fail;
+	}
+
+	if (!blob_stamp_matches(CHAR_JSON_PATH, &hdr->stamp[BLOB_CHAR]) ||
+	    !blob_stamp_matches(ANIM_JSON_PATH, &hdr->stamp[BLOB_ANIM]) ||
+	    !blob_stamp_matches(META_JSON_PATH, &hdr->stamp[BLOB_META])) {
+		note("sprite_config: %s is older than the JSON config, ignoring it", path);
+		goto fail;
+	}
+
+	blob_unmap();
+	free_tables();
+
+	blob.base = base;
+	blob.size = size;
+	for (int i = 0; i < 3; i++) {
+		blob.index[i] = (const uint16_t *)(const void *)((const char *)base + hdr->sec[i].index_off);
+	}
+	blob.chars = (const CharacterVariant *)(const void *)((const char *)base + hdr->sec[BLOB_CHAR].entry_off);
+	blob.anims = (const AnimatedVariant *)(const void *)((const char *)base + hdr->sec[BLOB_ANIM].entry_off);
+	blob.metas = (const SpriteMetadata *)(const void *)((const char *)base + hdr->sec[BLOB_META].entry_off);
+	blob.hdr = hdr;
+
+	return 0;
+
+fail:
+#ifdef _WIN32
+	xfree(base);
+#else
+	munmap(base, size);
+#endif
+	return -1;
+}
+
+/*
+ * Move the blob contents into the hash tables so they can be modified
+ * (mods loading extra variants, clear). Lookups use the tables afterwards.
+ */
+static void blob_detach(void)
+{
+	const struct blob_header *hdr = blob.hdr;
+
+	if (!hdr) {
+		return;
+	}
+	blob.hdr = NULL;
+
+	if (init_tables() == 0 && init_metadata_table() == 0) {
+		for (uint32_t i = 0; i < hdr->sec[BLOB_CHAR].count; i++) {
+			insert_character(&blob.chars[i]);
+		}
+		for (uint32_t i = 0; i < hdr->sec[BLOB_ANIM].count; i++) {
+			insert_animated(&blob.anims[i]);
+		}
+		for (uint32_t i = 0; i < hdr->sec[BLOB_META].count; i++) {
+			insert_metadata(&blob.metas[i]);
+		}
+	}
+
+	blob_unmap();
+}
+
+/*
+ * Build one dense section from a hash table. Entries are stored in ID order.
+ * buf == NULL only computes the size needed at 'off'.
+ */
+static size_t blob_build_section(char *buf, size_t off, struct blob_section *sec, const void *entries,
+    size_t capacity, size_t entry_size)
+{
+	const char *e = entries;
+	uint32_t min = UINT32_MAX, max = 0, count = 0;
+
+	for (size_t i = 0; i < capacity; i++) {
+		uint32_t id;
+		memcpy(&id, e + i * entry_size, sizeof(id)); /* id is the first member of all entry types */
+		if (id == EMPTY_SLOT) {
+			continue;
+		}
+		if (id < min) {
+			min = id;
+		}
+		if (id > max) {
+			max = id;
+		}
+		count++;
+	}
+
+	memset(sec, 0, sizeof(*sec));
+	if (!count) {
+		sec->index_off = (uint32_t)off;
+		sec->entry_off = (uint32_t)off;
+		return off;
+	}
+
+	sec->min = min;
+	sec->span = max - min + 1;
+	sec->count = count;
+	sec->index_off = (uint32_t)off;
+	off += sec->span * sizeof(uint16_t);
+	off = (off + BLOB_ALIGN - 1) & ~(size_t)(BLOB_ALIGN - 1);
+	sec->entry_off = (uint32_t)off;
+	off += count * entry_size;
+	off = (off + BLOB_ALIGN - 1) & ~(size_t)(BLOB_ALIGN - 1);
+
+	if (buf) {
+		uint16_t *index = (uint16_t *)(void *)(buf + sec->index_off);
+		uint16_t n = 0;
+
+		/* First pass: table slot + 1 per ID, second pass: walk in ID order and compact */
+		for (size_t i = 0; i < capacity; i++) {
+			uint32_t id;
+			memcpy(&id, e + i * entry_size, sizeof(id));
+			if (id != EMPTY_SLOT) {
+				index[id - min] = (uint16_t)(i + 1);
+			}
+		}
+		for (uint32_t i = 0; i < sec->span; i++) {
+			if (index[i]) {
+				memcpy(buf + sec->entry_off + (size_t)n * entry_size, e + (size_t)(index[i] - 1) * entry_size,
+				    entry_size);
+				index[i] = ++n;
+			}
+		}
+	}
+
+	return off;
+}
+
+int sprite_config_compile(const char *path)
+{
+	struct blob_header hdr;
+	size_t size;
+	char *buf;
+	FILE *f;
+
+	if (!path) {
+		path = BLOB_PATH;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = BLOB_MAGIC;
+	hdr.version = BLOB_VERSION;
+	hdr.char_size = sizeof(CharacterVariant);
+	hdr.anim_size = sizeof(AnimatedVariant);
+	hdr.meta_size = sizeof(SpriteMetadata);
+	blob_stamp_file(CHAR_JSON_PATH, &hdr.stamp[BLOB_CHAR]);
+	blob_stamp_file(ANIM_JSON_PATH, &hdr.stamp[BLOB_ANIM]);
+	blob_stamp_file(META_JSON_PATH, &hdr.stamp[BLOB_META]);
+
+	/* Always compile from the JSON, never from an older blob */
+	sprite_config_shutdown();
+	if (init_tables() < 0 || init_metadata_table() < 0) {
+		return -1;
+	}
+	if ((hdr.stamp[BLOB_CHAR].size && sprite_config_load_characters(CHAR_JSON_PATH) < 0) ||
+	    (hdr.stamp[BLOB_ANIM].size && sprite_config_load_animated(ANIM_JSON_PATH) < 0) ||
+	    (hdr.stamp[BLOB_META].size && sprite_config_load_metadata(META_JSON_PATH) < 0)) {
+		return -1;
+	}
+
+	size = sizeof(hdr);
+	size = blob_build_section(NULL, size, &hdr.sec[BLOB_CHAR], char_table.entries, char_table.capacity,
+	    sizeof(CharacterVariant));
+	size = blob_build_section(NULL, size, &hdr.sec[BLOB_ANIM], anim_table.entries, anim_table.capacity,
+	    sizeof(AnimatedVariant));
+	size = blob_build_section(NULL, size, &hdr.sec[BLOB_META], meta_table.entries, meta_table.capacity,
+	    sizeof(SpriteMetadata));
+	hdr.size = (uint32_t)size;
+
+	buf = xmalloc(size, MEM_TEMP);
+	if (!buf) {
+		return -1;
+	}
+	memset(buf, 0, size);
+
+	size = sizeof(hdr);
+	size = blob_build_section(buf, size, &hdr.sec[BLOB_CHAR], char_table.entries, char_table.capacity,
+	    sizeof(CharacterVariant));
+	size = blob_build_section(buf, size, &hdr.sec[BLOB_ANIM], anim_table.entries, anim_table.capacity,
+	    sizeof(AnimatedVariant));
+	blob_build_section(buf, size, &hdr.sec[BLOB_META], meta_table.entries, meta_table.capacity,
+	    sizeof(SpriteMetadata));
+	memcpy(buf, &hdr, sizeof(hdr));
+
+	f = fopen(path, "wb");
+	if (!f) {
+		warn("sprite_config: Could not write %s", path);
+		xfree(buf);
+		return -1;
+	}
+	if (fwrite(buf, 1, hdr.size, f) != hdr.size) {
+		warn("sprite_config: Write error on %s", path);
+		fclose(f);
+		xfree(buf);
+		return -1;
+	}
+	fclose(f);
+	xfree(buf);
+
+	note("sprite_config: Compiled %u character variants, %u animated variants, %u metadata entries into %s (%u bytes)",
+	    hdr.sec[BLOB_CHAR].count, hdr.sec[BLOB_ANIM].count, hdr.sec[BLOB_META].count, path, hdr.size);
+
+	return 0;
+}
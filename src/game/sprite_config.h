@@ -168,6 +168,26 @@ int sprite_config_init(void);
  */
 void sprite_config_shutdown(void);
 
+/*
+ * Load a binary config compiled by sprite_config_compile().
+ * Fails if the blob is missing, invalid, or was compiled from different
+ * JSON files. Called by sprite_config_init() before parsing the JSON.
+ *
+ * path: Path to the blob
+ * Returns: 0 on success, -1 if the JSON files should be used instead
+ */
+int sprite_config_load_binary(const char *path);
+
+/*
+ * Compile the default JSON config files into a binary blob with dense
+ * sprite-ID-indexed tables. Used by the spritecfg helper.
+ * Leaves the freshly parsed JSON config loaded.
+ *
+ * path: Output path, NULL for res/config/sprite_config.bin
+ * Returns: 0 on success, -1 on error
+ */
+int sprite_config_compile(const char *path);
+
 /*
  * Load character variants from a JSON file.
  * Can be called multiple times to add/override variants.
@@ -236,15 +256,17 @@ int sprite_config_apply_character(const CharacterVariant *v, int csprite, int *p
  *
  * v: Pointer to variant (may be NULL for identity)
  * mn: Map index for position-aware animations
+ * mapdx: Width of the map mn indexes into
  * sprite: Original sprite ID
  * attick: Current animation tick
  * pscale, pcr, pcg, pcb, plight, psat, pc1, pc2, pc3, pshine: Output parameters
  *
  * Returns: Transformed sprite ID
  */
-unsigned int sprite_config_apply_animated(const AnimatedVariant *v, map_index_t mn, unsigned int sprite, tick_t attick,
-    unsigned char *pscale, unsigned char *pcr, unsigned char *pcg, unsigned char *pcb, unsigned char *plight,
-    unsigned char *psat, unsigned short *pc1, unsigned short *pc2, unsigned short *pc3, unsigned short *pshine);
+unsigned int sprite_config_apply_animated(const AnimatedVariant *v, map_index_t mn, unsigned int mapdx,
+    unsigned int sprite, tick_t attick, unsigned char *pscale, unsigned char *pcr, unsigned char *pcg,
+    unsigned char *pcb, unsigned char *plight, unsigned char *psat, unsigned short *pc1, unsigned short *pc2,
+    unsigned short *pc3, unsigned short *pshine);
 
 /*
  * Get statistics about loaded variants.
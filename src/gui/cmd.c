@@ -19,6 +19,8 @@
 #include "client/client.h"
 #include "game/game.h"
 #include "modder/modder.h"
+#include "game/profile.h"
+#include "game/logging.h"
 
 #define MAXCMDLINE 199
 #define MAXHIST    20
@@ -104,6 +106,55 @@ static int client_cmd(char *buf)
 		show_color_c[2] = map[MAPDX * MAPDY / 2].rc.c3;
 		return 1;
 	}
+	if (!strncmp(buf, "#trace", 6) || !strncmp(buf, "/trace", 6)) {
+		int frames = buf[6] == ' ' ? atoi(&buf[7]) : 120;
+		if (prof_capture(frames)) {
+			addline("Trace already running or bad frame count");
+		} else {
+			addline("Tracing the next %d frames", frames);
+		}
+		return 1;
+	}
+	if (!strncmp(buf, "#memguard", 9) || !strncmp(buf, "/memguard", 9)) {
+		static const char *guard_name[] = {"none", "sampled", "full"};
+		char *ptr = buf + 9;
+
+		while (isspace(*ptr)) {
+			ptr++;
+		}
+		if (!strcasecmp(ptr, "none")) {
+			mem_guard = MEM_GUARD_NONE;
+		} else if (!strcasecmp(ptr, "sampled")) {
+			mem_guard = MEM_GUARD_SAMPLED;
+		} else if (!strcasecmp(ptr, "full")) {
+			mem_guard = MEM_GUARD_FULL;
+		} else if (*ptr) {
+			addline("Use none, sampled or full");
+			return 1;
+		}
+		addline("Memory guards: %s (new allocations only)", guard_name[mem_guard]);
+		return 1;
+	}
+	if (!strncmp(buf, "#loglevel", 9) || !strncmp(buf, "/loglevel", 9)) {
+		static const char *level_name[] = {"note", "warn", "fail"};
+		char *ptr = buf + 9;
+
+		while (isspace(*ptr)) {
+			ptr++;
+		}
+		if (!strcasecmp(ptr, "note")) {
+			log_level = LOG_NOTE;
+		} else if (!strcasecmp(ptr, "warn")) {
+			log_level = LOG_WARN;
+		} else if (!strcasecmp(ptr, "fail")) {
+			log_level = LOG_FAIL;
+		} else if (*ptr) {
+			addline("Use note, warn or fail");
+			return 1;
+		}
+		addline("Logging %s and above", level_name[log_level]);
+		return 1;
+	}
 	if (!strncmp(buf, "#sound ", 7)) {
 		play_sound((unsigned int)atoi(&buf[7]), 0, 0);
 		return 1;
@@ -16,6 +16,7 @@ struct quicks {
 	unsigned int mapy;
 	int cx;
 	int cy;
+	unsigned char visible; // sprites on this tile may reach the map window, see cull_quick()
 };
 
 typedef struct quicks QUICK;
@@ -1212,6 +1212,7 @@ void set_cmd_states(void)
 {
 	set_cmd_key_states();
 	set_map_values(map, tick);
+	set_map_interpolation(map, tick_frac);
 	set_mapadd(-map[mapmn(MAPDX / 2, MAPDY / 2)].xadd, -map[mapmn(MAPDX / 2, MAPDY / 2)].yadd);
 
 	update_ui_layout();
@@ -17,6 +17,8 @@
 #include "game/game.h"
 #include "sdl/sdl.h"
 #include "modder/modder.h"
+#include "game/profile.h"
+#include "game/logging.h"
 
 // Forward declarations for functions used by gui_insert
 void cmd_add_text(const char *buf, int typ);
@@ -225,6 +227,7 @@ int mapoffx, mapoffy;
 int mapaddx, mapaddy; // small offset to smoothen walking
 
 int nextframe, nexttick;
+int tick_frac; // position of the current frame between the displayed tick and the next one, 0...TICK_FRAC
 uint64_t gui_time_network = 0;
 uint64_t gui_frametime = 0;
 uint64_t gui_ticktime = 0;
@@ -281,6 +284,7 @@ int main_init(void)
 	set_skloff(0, 0);
 	set_conoff(0, 0);
 
+	map_init();
 	init_game(dotx(DOT_MCT), doty(DOT_MCT));
 
 	minimap_init();
@@ -295,7 +299,9 @@ void main_exit(void)
 	skltab_max = 0;
 	skltab_cnt = 0;
 
+	minimap_exit();
 	exit_game();
+	map_exit();
 }
 
 void set_v35_keytab(void)
@@ -309,15 +315,38 @@ void set_v35_keytab(void)
 static void flip_at(unsigned int t)
 {
 	Uint64 tnow;
-	int sdl_pre_do(void);
 
-	do {
+	switch (sdl_pacing) {
+	case SDL_PACE_VSYNC:
+	case SDL_PACE_UNCAPPED:
+		// no deadline: presenting waits for the vertical blank, or nothing waits at all
 		sdl_loop();
-		if (!sdl_is_shown() || !sdl_pre_do()) {
-			SDL_Delay(1);
+		if (sdl_is_shown()) {
+			sdl_pre_do();
+		}
+		break;
+	case SDL_PACE_LOWPOWER:
+		// upload what is ready and sleep through, textures finished meanwhile wait for the next frame
+		sdl_loop();
+		if (sdl_is_shown()) {
+			sdl_pre_do();
 		}
 		tnow = SDL_GetTicks();
-	} while (t > tnow);
+		if (t > tnow) {
+			SDL_DelayPrecise((t - tnow) * 1000000ull);
+		}
+		break;
+	default:
+		// upload textures as the workers finish them, idle in between
+		do {
+			sdl_loop();
+			if (!sdl_is_shown() || !sdl_pre_do()) {
+				sdl_pre_wait(t);
+			}
+			tnow = SDL_GetTicks();
+		} while (t > tnow);
+		break;
+	}
 
 	if (sdl_is_shown()) {
 		sdl_render();
@@ -328,7 +357,7 @@ int main_loop(void)
 {
 	void prefetch_game(tick_t attick);
 	int64_t timediff;
-	int tmp, ltick = 0;
+	int tmp, ltick = 0, tick_len = MPT;
 	tick_t attick;
 	long long start;
 	int do_one_tick = 1;
@@ -339,19 +368,26 @@ int main_loop(void)
 	nexttick = (int)(SDL_GetTicks() + (Uint32)MPT);
 	nextframe = (int)(SDL_GetTicks() + (Uint32)MPF);
 
+	prof_thread_name("main");
+
 	while (!quit) {
 		now = SDL_GetTicks();
 
 		start = (long long)SDL_GetTicks();
 		poll_network();
 
-		// synchronise frames and ticks if at the same speed
-		if (sockstate == 4 && MPF == MPT) {
+		if (sdl_pacing == SDL_PACE_VSYNC || sdl_pacing == SDL_PACE_UNCAPPED) {
+			// every pass shows a frame, ticks get done once they are due
+			nextframe = (int)SDL_GetTicks();
+		} else if (sockstate == 4 && MPF == MPT) {
+			// synchronise frames and ticks if at the same speed
 			nextframe = nexttick;
 		}
 
 		// check if we can go on
 		if (sockstate > 2) {
+			PROF_ZONE("ticks");
+
 			// decode as many ticks as we can
 			// and add their contents to the prefetch queue
 			while ((attick = next_tick())) {
@@ -394,7 +430,20 @@ int main_loop(void)
 			gui_frametime = SDL_GetTicks() - gui_last_frame;
 			gui_last_frame = SDL_GetTicks();
 
+			// how far are we on the way to the next tick? used to move characters and the view in between
+			if (sockstate == 4) {
+				tick_frac = (int)min((gui_last_frame - gui_last_tick) * TICK_FRAC / (uint64_t)max(tick_len, 1),
+				    (uint64_t)TICK_FRAC);
+			} else {
+				tick_frac = 0;
+			}
+
+			prof_frame();
+			log_frame();
+
 			if (sdl_is_shown() && (!(tick & 3) || !game_slowdown || sockstate != 4)) {
+				PROF_ZONE("render");
+
 				sdl_clear();
 				display();
 				amod_frame();
@@ -405,13 +454,18 @@ int main_loop(void)
 			timediff = (int64_t)((unsigned int)nextframe - SDL_GetTicks());
 			if (timediff > 0) {
 				idle += timediff;
+				sdl_pixel_trim(0);
 			} else {
 				skip -= timediff;
 			}
 
 			frames++;
+			telemetry_update();
 
-			flip_at((unsigned int)nextframe);
+			{
+				PROF_ZONE("flip");
+				flip_at((unsigned int)nextframe);
+			}
 		} else {
 #ifdef TICKPRINT
 			printf("Skip tick %u\n", tick);
@@ -428,6 +482,7 @@ int main_loop(void)
 				tmp = calc_tick_delay_normal(lasttick + q_size);
 			}
 			nexttick += tmp;
+			tick_len = tmp;
 			tota += tmp;
 			if (tick % 24 == 0) {
 				tota /= 2;
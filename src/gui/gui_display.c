@@ -16,6 +16,7 @@
 #include "game/game.h"
 #include "sdl/sdl.h"
 #include "modder/modder.h"
+#include "game/profile.h"
 
 void display_helpandquest(void)
 {
@@ -131,6 +132,7 @@ void display(void)
 	time_t t;
 	int tmp;
 	uint64_t start = SDL_GetTicks();
+	PROF_ZONE("display");
 
 #if 0
 	// Performance for stuff happening during the actual tick only.
@@ -317,6 +319,17 @@ display_graphs:;
 		    "Ticktime %" PRId64, gui_ticktime);
 		sdl_bargraph_add(sizeof(pre3_graph), pre3_graph, size);
 		sdl_bargraph(px, py += 40, sizeof(pre3_graph), pre3_graph, x_offset, y_offset);
+
+		// per-mod cost per frame, median and 99th percentile, red while throttled
+		for (int i = 0; i < MAXMOD; i++) {
+			int p50, p99, throttled;
+
+			if (!amod_stat(i, &p50, &p99, &throttled)) {
+				continue;
+			}
+			render_text_fmt(px, py += 10, throttled ? IRGB(31, 8, 8) : IRGB(8, 31, 8),
+			    RENDER_TEXT_NOCACHE | RENDER_TEXT_LEFT | RENDER_TEXT_FRAMED, "%cmod %d/%dus", 'a' + i, p50, p99);
+		}
 #if 0
 	    size=gui_time_network;
 	    render_text_fmt(px,py+=10,IRGB(8,31,8),RENDER_TEXT_LEFT|RENDER_TEXT_FRAMED,"Network");
@@ -353,6 +366,8 @@ display_graphs:;
 			sdl_bargraph_add(sizeof(lag_graph), lag_graph, lag_size);
 			sdl_bargraph(px, py += 40, sizeof(lag_graph), lag_graph, x_offset, y_offset);
 		}
+		render_text_fmt(px, py += 10, IRGB(8, 31, 8), RENDER_TEXT_FRAMED | RENDER_TEXT_LEFT | RENDER_TEXT_NOCACHE,
+		    "Merged %d cmds", coalesced_cmds);
 
 		{
 			uint64_t sum = sdl_time_pre1 + sdl_time_pre3;
@@ -455,6 +470,7 @@ display_graphs:;
 #endif
 	} // else render_text_fmt(650,15,0xffff,RENDER_TEXT_SMALL|RENDER_TEXT_FRAMED,"Mirror %d",mirror);
 
+	mem_stats_merge();
 	sprintf(perf_text, "mem usage=%zu/%.2fMB, %d/%dKBlocks", memsize[0] / 1024 / 1024,
 	    (double)memused / 1024.0 / 1024.0, memptrs[0] / 1024, memptrused / 1024);
 }
@@ -478,6 +494,7 @@ void update_ui_layout(void)
 	}
 	max_invoff = ((_inventorysize - 30) / INVDX) - INVDY;
 	set_button_flags();
+	cull_quick(dotx(DOT_MTL), doty(DOT_MTL), dotx(DOT_MBR), doty(DOT_MBR));
 }
 
 DLL_EXPORT int _do_display_help(int nr)
@@ -347,6 +347,7 @@ extern int last_right_click_invsel;
 extern int mapoffx, mapoffy;
 extern int mapaddx, mapaddy;
 extern int nextframe, nexttick;
+extern int tick_frac;
 extern uint64_t gui_time_network;
 extern uint64_t gui_frametime;
 extern uint64_t gui_ticktime;
@@ -495,6 +496,16 @@ void minimap_toggle(void);
 void minimap_hide(void);
 void display_minimap(void);
 void minimap_update(void);
+void minimap_exit(void);
+
+// From mapdb.c
+#define MAPDB_MAPSIZE (256 * 256) // one area map, a byte per tile
+int mapdb_find(const unsigned char *map, unsigned char *best);
+int mapdb_save(int id, const unsigned char *map);
+void mapdb_merge(unsigned char *xmap, const unsigned char *tmap);
+void mapdb_compact(void);
+void mapdb_exit(void);
+
 void dots_update(void);
 void display_action_lock(void);
 void display_action_open(void);
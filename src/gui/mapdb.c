@@ -0,0 +1,609 @@
+/*
+ * Part of Astonia Client (c) Daniel Brockhaus. Please read license.txt.
+ *
+ * Area map database
+ *
+ * All saved minimap area maps live in one file, maps.db. It holds a small
+ * header followed by append-only records, each with one zlib-compressed map
+ * and its signature. A later record for the same map number replaces the
+ * earlier one, a record without data deletes the map. Records carry a
+ * CRC, so a torn write from a crash is skipped when the file is scanned.
+ *
+ * The signature counts wall and floor tiles per 8x8 cell. That bounds the
+ * hits (from above) and the misses (from below) map_compare() can find, so
+ * only maps that can possibly match are decompressed and compared.
+ *
+ * Apart from mapdb_merge(), these are only called from the minimap thread
+ * in minimap.c (and from main_exit() after it has stopped).
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <zlib.h>
+#include <SDL3/SDL.h>
+
+#include "astonia.h"
+#include "gui/gui.h"
+#include "gui/gui_private.h"
+
+#define MAPDB_MAGIC    0x42444d41 // "AMDB"
+#define MAPDB_VERSION  1
+#define MAPDB_RECMAGIC 0x524d4d41 // "AMMR"
+
+#define MAPDB_DIM   256 // map is MAPDB_DIM x MAPDB_DIM tiles
+#define MAPDB_CELL  8 // signature cell size in tiles
+#define MAPDB_CELLS ((MAPDB_DIM / MAPDB_CELL) * (MAPDB_DIM / MAPDB_CELL))
+
+#define MAPDB_MAXDEAD (1024 * 1024) // rewrite the file when superseded records take more than this
+
+#define MAPDB_OLDMAPS 100 // mapNNN.dat files imported on first use
+
+struct mapdb_sig {
+	uint8_t wall[MAPDB_CELLS]; // tiles 1, 2 and 5 per cell
+	uint8_t floor[MAPDB_CELLS]; // tiles 3 and 4 per cell
+};
+
+struct mapdb_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t generation; // changes when the file is rewritten
+	uint32_t _padding;
+};
+
+struct mapdb_record {
+	uint32_t magic;
+	int32_t id;
+	uint32_t size; // compressed size, 0 = map deleted
+	uint32_t crc; // over sig and data
+	struct mapdb_sig sig;
+};
+
+struct mapdb_entry {
+	int id;
+	long offset; // of the compressed data
+	uint32_t size;
+	struct mapdb_sig sig;
+};
+
+static struct mapdb_entry *entries = NULL;
+static int entry_cnt = 0, entry_max = 0, nextid = 0;
+static long scanned = 0; // file offset the index is current up to
+static uint32_t generation = 0;
+static size_t dead = 0, live = 0; // bytes in superseded and in current records
+static int imported = 0;
+
+static unsigned char zbuf[MAPDB_MAPSIZE + MAPDB_MAPSIZE / 100 + 64]; // > compressBound(MAPDB_MAPSIZE)
+static unsigned char tmap[MAPDB_MAPSIZE], xmap[MAPDB_MAPSIZE];
+
+static char *mapdb_name(const char *ext)
+{
+	static char filename[MAX_PATH];
+
+	if (localdata) {
+		snprintf(filename, sizeof(filename), "%smaps.db%s", localdata, ext);
+	} else {
+		snprintf(filename, sizeof(filename), "bin/data/maps.db%s", ext);
+	}
+
+	return filename;
+}
+
+static char *old_mapname(int i)
+{
+	static char filename[MAX_PATH];
+
+	if (localdata) {
+		snprintf(filename, sizeof(filename), "%smap%03d.dat", localdata, i);
+	} else {
+		snprintf(filename, sizeof(filename), "bin/data/map%03d.dat", i);
+	}
+
+	return filename;
+}
+
+static void map_sig(const unsigned char *map, struct mapdb_sig *sig)
+{
+	int x, y, c;
+
+	memset(sig, 0, sizeof(*sig));
+
+	for (y = 0; y < MAPDB_DIM; y++) {
+		for (x = 0; x < MAPDB_DIM; x++) {
+			c = (x / MAPDB_CELL) + (y / MAPDB_CELL) * (MAPDB_DIM / MAPDB_CELL);
+			switch (map[x + y * MAPDB_DIM]) {
+			case 1:
+			case 2:
+			case 5:
+				sig->wall[c]++;
+				break;
+			case 3:
+			case 4:
+				sig->floor[c]++;
+				break;
+			}
+		}
+	}
+}
+
+// Can map_compare(stored, current) succeed? Never rejects a map that would match.
+static int sig_may_match(const struct mapdb_sig *t, const struct mapdb_sig *x)
+{
+	int c, hit = 0, miss = 0, n;
+
+	for (c = 0; c < MAPDB_CELLS; c++) {
+		hit += min(t->wall[c], x->wall[c]) + min(t->floor[c], x->floor[c]);
+
+		// a stored wall on a current floor (or the reverse) is a miss, and
+		// there is only so much room in a cell to avoid that
+		n = t->wall[c] + x->floor[c] - MAPDB_CELL * MAPDB_CELL;
+		if (n > 0) {
+			miss += n;
+		}
+		n = t->floor[c] + x->wall[c] - MAPDB_CELL * MAPDB_CELL;
+		if (n > 0) {
+			miss += n;
+		}
+	}
+
+	return hit >= 200 && miss <= hit / 100;
+}
+
+static int map_compare(const unsigned char *tmap, const unsigned char *xmap)
+{
+	int i, hit, miss;
+
+	for (i = hit = miss = 0; i < MAPDB_MAPSIZE; i++) {
+		// sightblock, fsprite or usable sightblock
+		if (tmap[i] == 1 || tmap[i] == 2 || tmap[i] == 5) {
+			if (xmap[i] == 1 || xmap[i] == 2 || xmap[i] == 5) {
+				hit++;
+			} else if (xmap[i] != 0) {
+				miss++;
+			}
+		}
+		// empty or csprite
+		if (tmap[i] == 3 || tmap[i] == 4) {
+			if (xmap[i] == 3 || xmap[i] == 4) {
+				hit++;
+			} else if (xmap[i] != 0) {
+				miss++;
+			}
+		}
+	}
+	if (hit < 200) {
+		return 0;
+	}
+	if (miss > hit / 100) {
+		return 0;
+	}
+
+	return hit;
+}
+
+void mapdb_merge(unsigned char *xmap, const unsigned char *tmap)
+{
+	int i;
+
+	// only overwrite empty parts of the map with loaded data.
+	for (i = 0; i < MAPDB_MAPSIZE; i++) {
+		if (!xmap[i]) {
+			if (tmap[i] == 3) {
+				xmap[i] = 4; // do not load csprites, they move too much
+			} else {
+				xmap[i] = tmap[i];
+			}
+		}
+	}
+}
+
+static struct mapdb_entry *find_entry(int id)
+{
+	int n;
+
+	for (n = 0; n < entry_cnt; n++) {
+		if (entries[n].id == id) {
+			return &entries[n];
+		}
+	}
+
+	return NULL;
+}
+
+static void index_record(const struct mapdb_record *rec, long offset)
+{
+	struct mapdb_entry *e;
+
+	if (rec->id >= nextid) {
+		nextid = rec->id + 1;
+	}
+
+	if ((e = find_entry(rec->id))) {
+		dead += sizeof(*rec) + e->size;
+		live -= sizeof(*rec) + e->size;
+		if (!rec->size) {
+			*e = entries[--entry_cnt];
+			return;
+		}
+	} else {
+		if (!rec->size) {
+			return;
+		}
+		if (entry_cnt == entry_max) {
+			entry_max = entry_max ? entry_max * 2 : 64;
+			entries = xrealloc(entries, (size_t)entry_max * sizeof(struct mapdb_entry), MEM_GUI);
+		}
+		e = &entries[entry_cnt++];
+	}
+
+	e->id = rec->id;
+	e->offset = offset;
+	e->size = rec->size;
+	memcpy(&e->sig, &rec->sig, sizeof(e->sig));
+	live += sizeof(*rec) + rec->size;
+}
+
+static void reset_index(void)
+{
+	entry_cnt = 0;
+	nextid = 0;
+	scanned = 0;
+	dead = live = 0;
+}
+
+static void init_header(struct mapdb_header *hdr)
+{
+	hdr->magic = MAPDB_MAGIC;
+	hdr->version = MAPDB_VERSION;
+	hdr->generation = (uint32_t)time(NULL);
+	if (hdr->generation == generation) {
+		hdr->generation++;
+	}
+	hdr->_padding = 0;
+}
+
+static void import_old_maps(void);
+
+// Bring the index up to date with records appended since the last scan (by us or another client)
+static void mapdb_scan(void)
+{
+	FILE *fp;
+	struct mapdb_header hdr;
+	struct mapdb_record rec;
+	char filename[MAX_PATH];
+	long pos;
+	uint32_t crc;
+
+	snprintf(filename, sizeof(filename), "%s", mapdb_name(""));
+
+	fp = fopen(filename, "rb");
+	if (!fp) {
+		// a crash in mapdb_rewrite() between remove and rename leaves only the new file
+		if (rename(mapdb_name(".tmp"), filename) != 0 || !(fp = fopen(filename, "rb"))) {
+			reset_index();
+			if (!imported) {
+				imported = 1;
+				import_old_maps();
+			}
+			return;
+		}
+	}
+	imported = 1;
+
+	if (fread(&hdr, sizeof(hdr), 1, fp) != 1) {
+		fclose(fp); // just created by another client
+		return;
+	}
+	if (hdr.magic != MAPDB_MAGIC || hdr.version != MAPDB_VERSION) {
+		fclose(fp);
+		warn("%s is not an area map database, moving it out of the way", filename);
+		remove(mapdb_name(".bad"));
+		rename(filename, mapdb_name(".bad"));
+		reset_index();
+		return;
+	}
+	if (!scanned || hdr.generation != generation) {
+		// first scan, or another client rewrote the file and all offsets changed
+		reset_index();
+		generation = hdr.generation;
+		scanned = sizeof(hdr);
+	}
+
+	pos = scanned;
+	while (fseek(fp, pos, SEEK_SET) == 0 && fread(&rec, sizeof(rec), 1, fp) == 1) {
+		if (rec.magic != MAPDB_RECMAGIC || rec.id < 0 || rec.size > sizeof(zbuf)) {
+			pos++; // garbage from an interrupted write, look for the next record
+			scanned = pos;
+			continue;
+		}
+		if (rec.size && fread(zbuf, rec.size, 1, fp) != 1) {
+			break; // incomplete, possibly still being written by another client
+		}
+
+		crc = (uint32_t)crc32(0L, (const Bytef *)&rec.sig, sizeof(rec.sig));
+		crc = (uint32_t)crc32(crc, zbuf, rec.size);
+		if (crc != rec.crc) {
+			pos++;
+			scanned = pos;
+			continue;
+		}
+
+		index_record(&rec, pos + (long)sizeof(rec));
+		pos += (long)sizeof(rec) + (long)rec.size;
+		scanned = pos;
+	}
+
+	fclose(fp);
+}
+
+static int read_map(FILE *fp, const struct mapdb_entry *e, unsigned char *map)
+{
+	uLongf len = MAPDB_MAPSIZE;
+
+	if (fseek(fp, e->offset, SEEK_SET) != 0 || fread(zbuf, e->size, 1, fp) != 1) {
+		return -1;
+	}
+	if (uncompress(map, &len, zbuf, e->size) != Z_OK || len != MAPDB_MAPSIZE) {
+		return -1;
+	}
+
+	return 0;
+}
+
+static int load_map(int id, unsigned char *map)
+{
+	struct mapdb_entry *e;
+	FILE *fp;
+	int ret;
+
+	if (!(e = find_entry(id))) {
+		return -1;
+	}
+	if (!(fp = fopen(mapdb_name(""), "rb"))) {
+		return -1;
+	}
+	ret = read_map(fp, e, map);
+	fclose(fp);
+
+	return ret;
+}
+
+// Append one record. map == NULL deletes the map.
+static int append_record(int id, const unsigned char *map)
+{
+	struct mapdb_header hdr;
+	struct mapdb_record rec;
+	uLongf len = sizeof(zbuf);
+	unsigned char *buf;
+	FILE *fp;
+	int ret = 0;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.magic = MAPDB_RECMAGIC;
+	rec.id = id;
+	if (map) {
+		if (compress(zbuf, &len, map, MAPDB_MAPSIZE) != Z_OK) {
+			return -1;
+		}
+		rec.size = (uint32_t)len;
+		map_sig(map, &rec.sig);
+	}
+	rec.crc = (uint32_t)crc32(0L, (const Bytef *)&rec.sig, sizeof(rec.sig));
+	rec.crc = (uint32_t)crc32(rec.crc, zbuf, rec.size);
+
+	// one fwrite per record, so concurrent clients don't interleave
+	buf = xmalloc(sizeof(rec) + rec.size, MEM_TEMP);
+	memcpy(buf, &rec, sizeof(rec));
+	memcpy(buf + sizeof(rec), zbuf, rec.size);
+
+	fp = fopen(mapdb_name(""), "ab");
+	if (!fp) {
+		warn("Could not write area map to %s", mapdb_name(""));
+		xfree(buf);
+		return -1;
+	}
+	fseek(fp, 0, SEEK_END);
+	if (ftell(fp) == 0) {
+		init_header(&hdr);
+		fwrite(&hdr, sizeof(hdr), 1, fp);
+	}
+	if (fwrite(buf, sizeof(rec) + rec.size, 1, fp) != 1) {
+		ret = -1;
+	}
+	if (fclose(fp) != 0) {
+		ret = -1;
+	}
+	xfree(buf);
+
+	mapdb_scan();
+
+	return ret;
+}
+
+// Write only the current records to a new file and swap it in
+static void mapdb_rewrite(void)
+{
+	struct mapdb_header hdr;
+	struct mapdb_record rec;
+	char tmpname[MAX_PATH], *filename;
+	FILE *in, *out;
+	int n, ok = 1;
+
+	snprintf(tmpname, sizeof(tmpname), "%s", mapdb_name(".tmp"));
+	filename = mapdb_name("");
+
+	if (!(in = fopen(filename, "rb"))) {
+		return;
+	}
+	if (!(out = fopen(tmpname, "wb"))) {
+		fclose(in);
+		return;
+	}
+
+	init_header(&hdr);
+	ok = fwrite(&hdr, sizeof(hdr), 1, out) == 1;
+
+	for (n = 0; n < entry_cnt && ok; n++) {
+		struct mapdb_entry *e = &entries[n];
+
+		ok = fseek(in, e->offset - (long)sizeof(rec), SEEK_SET) == 0 && fread(&rec, sizeof(rec), 1, in) == 1 &&
+		     fread(zbuf, e->size, 1, in) == 1 && fwrite(&rec, sizeof(rec), 1, out) == 1 &&
+		     fwrite(zbuf, e->size, 1, out) == 1;
+	}
+
+	fclose(in);
+	if (fclose(out) != 0) {
+		ok = 0;
+	}
+	if (!ok) {
+		warn("Could not rewrite %s", filename);
+		remove(tmpname);
+		return;
+	}
+
+	// the old file stays intact until the new one is complete
+	filename = mapdb_name("");
+	remove(filename);
+	if (rename(tmpname, filename) != 0) {
+		warn("Could not rename %s to %s", tmpname, filename);
+		return;
+	}
+
+	reset_index();
+	mapdb_scan();
+}
+
+static void import_old_maps(void)
+{
+	FILE *fp;
+	int i, cnt = 0;
+
+	for (i = 0; i < MAPDB_OLDMAPS; i++) {
+		fp = fopen(old_mapname(i), "rb");
+		if (!fp) {
+			continue;
+		}
+		if (fread(tmap, sizeof(tmap), 1, fp) == 1 && append_record(nextid, tmap) == 0) {
+			cnt++;
+		}
+		fclose(fp);
+	}
+	if (!cnt) {
+		return;
+	}
+
+	for (i = 0; i < MAPDB_OLDMAPS; i++) {
+		remove(old_mapname(i));
+	}
+	note("Imported %d area maps into %s", cnt, mapdb_name(""));
+}
+
+// Find the stored map that matches best. Copies it to 'best' and returns its number, or -1.
+int mapdb_find(const unsigned char *map, unsigned char *best)
+{
+	struct mapdb_sig sig;
+	FILE *fp;
+	int n, hit, besthit = 0, bestid = -1;
+
+	mapdb_scan();
+	if (!entry_cnt) {
+		return -1;
+	}
+
+	map_sig(map, &sig);
+
+	fp = fopen(mapdb_name(""), "rb");
+	if (!fp) {
+		return -1;
+	}
+
+	for (n = 0; n < entry_cnt; n++) {
+		if (!sig_may_match(&entries[n].sig, &sig)) {
+			continue;
+		}
+		if (read_map(fp, &entries[n], tmap) != 0) {
+			continue;
+		}
+		if ((hit = map_compare(tmap, map)) > besthit) {
+			besthit = hit;
+			bestid = entries[n].id;
+			memcpy(best, tmap, MAPDB_MAPSIZE);
+		}
+	}
+
+	fclose(fp);
+
+	return bestid;
+}
+
+// Store the map under number 'id', -1 for a new map. Returns the map number used, or -1.
+int mapdb_save(int id, const unsigned char *map)
+{
+	mapdb_scan();
+
+	if (id == -1) {
+		id = nextid;
+	}
+	if (append_record(id, map) != 0) {
+		return -1;
+	}
+
+	if (dead > MAPDB_MAXDEAD && dead > live) {
+		mapdb_rewrite();
+	}
+
+	return id;
+}
+
+// Merge stored maps which show the same area
+void mapdb_compact(void)
+{
+	int *ids, cnt, i, j;
+	struct mapdb_sig sig;
+	struct mapdb_entry *e;
+
+	mapdb_scan();
+
+	// the index changes with every save, so work on a copy of the map numbers
+	cnt = entry_cnt;
+	ids = xmalloc((size_t)(cnt ? cnt : 1) * sizeof(int), MEM_TEMP);
+	for (i = 0; i < cnt; i++) {
+		ids[i] = entries[i].id;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		if (load_map(ids[i], tmap) != 0) {
+			continue;
+		}
+		map_sig(tmap, &sig);
+
+		for (j = i + 1; j < cnt; j++) {
+			if (!(e = find_entry(ids[j])) || !sig_may_match(&sig, &e->sig)) {
+				continue;
+			}
+			if (load_map(ids[j], xmap) != 0) {
+				continue;
+			}
+			if (map_compare(tmap, xmap)) {
+				mapdb_merge(tmap, xmap);
+				map_sig(tmap, &sig);
+				if (append_record(ids[i], tmap) == 0) {
+					append_record(ids[j], NULL);
+					note("merged map %d into map %d", ids[j], ids[i]);
+				}
+			}
+		}
+	}
+
+	xfree(ids);
+
+	mapdb_rewrite();
+}
+
+void mapdb_exit(void)
+{
+	xfree(entries);
+	entries = NULL;
+	entry_max = 0;
+	reset_index();
+}
@@ -3,10 +3,12 @@
  *
  * Minimap
  *
- *
+ * Loading, matching and saving area maps (mapdb.c) runs on a background
+ * thread. Each job works on its own copy of the map, results come back
+ * through a completion queue that minimap_update() drains on the main
+ * thread, so the frame never waits for the disk.
  */
 
-#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <SDL3/SDL.h>
@@ -17,25 +19,85 @@
 #include "client/client.h"
 #include "game/game.h"
 #include "sdl/sdl.h"
+#include "game/profile.h"
 
 #define MINIMAP           40
 #define MAXMAP            256
 #define IRGBA(r, g, b, a) (((uint32_t)(a) << 24) | ((uint32_t)(r) << 16) | ((uint32_t)(g) << 8) | ((uint32_t)(b) << 0))
 
-static int sx, sy, visible, mx, my, update1, update2, update3, orx, ory, rewrite_cnt;
+static int sx, sy, visible, mx, my, update3, orx, ory, rewrite_cnt;
 
 static unsigned char _mmap[MAXMAP * MAXMAP];
 
-static uint32_t mapix1[MAXMAP * MAXMAP];
+static uint32_t mapix1[MAXMAP * MAXMAP]; // colors of _mmap, kept current even while the big map is hidden
 static uint32_t mapix2[MINIMAP * MINIMAP * 4];
 
-#define MAXSAVEMAP 100
-static int mapnr = -1;
+// Round minimap: pixels [round_lo[iy], round_hi[iy]] of each row are inside the circle
+static int round_lo[MINIMAP * 2], round_hi[MINIMAP * 2];
+static int round_stale; // maptex2 needs a complete rebuild
+
+struct map_rect {
+	int x0, y0, x1, y1; // x1 and y1 exclusive, empty if x0 >= x1
+};
+
+static struct map_rect dirty; // changes to _mmap not yet in mapix1
+static struct map_rect tex1_dirty; // changes to mapix1 not yet uploaded to maptex1
+
+static int mapnr = -1; // number of the stored area map in mapdb.c, -1 if none
+static unsigned int area_gen = 0; // bumped whenever _mmap is cleared, stale load results are dropped
+static int load_pending = 0;
+
+enum { MJ_LOAD, MJ_SAVE, MJ_COMPACT, MJ_QUIT };
+
+struct map_job {
+	int type;
+	int nr; // map number found or written, -1 for none
+	unsigned int gen; // area_gen when the job was queued
+	unsigned char *map; // copy of _mmap owned by the job
+	unsigned char *found; // stored map found by MJ_LOAD
+};
+
+#define MAXMAPJOB 8
+#define MAPQUEUE  (MAXMAPJOB + 1) // room for MJ_QUIT
+
+struct map_queue {
+	struct map_job job[MAPQUEUE];
+	int head, count;
+};
+
+static struct map_queue todo, done;
+static int jobs_inflight = 0; // queued plus running plus done, caps both queues at MAXMAPJOB
+static SDL_Mutex *job_mutex = NULL;
+static SDL_Condition *job_cond = NULL;
+static SDL_Thread *job_thread = NULL;
 
 SDL_Texture *maptex1 = NULL, *maptex2 = NULL;
 
+static void rect_add(struct map_rect *r, int x0, int y0, int x1, int y1)
+{
+	if (r->x0 >= r->x1) {
+		r->x0 = x0;
+		r->y0 = y0;
+		r->x1 = x1;
+		r->y1 = y1;
+		return;
+	}
+	r->x0 = min(r->x0, x0);
+	r->y0 = min(r->y0, y0);
+	r->x1 = max(r->x1, x1);
+	r->y1 = max(r->y1, y1);
+}
+
+static void map_dirty_all(void)
+{
+	rect_add(&dirty, 0, 0, MAXMAP, MAXMAP);
+	round_stale = 1;
+}
+
 void minimap_init(void)
 {
+	int iy, ix;
+
 	if (game_options & GO_NOMAP) {
 		return;
 	}
@@ -48,7 +110,21 @@ void minimap_init(void)
 
 	memset(_mmap, 0, sizeof(_mmap));
 	visible = 1;
-	update1 = update2 = update3 = 1;
+	update3 = 1;
+	map_dirty_all();
+
+	// the circle never changes, pixels outside it stay transparent
+	for (iy = -MINIMAP; iy < MINIMAP; iy++) {
+		round_lo[iy + MINIMAP] = MINIMAP * 2;
+		round_hi[iy + MINIMAP] = -1;
+		for (ix = -MINIMAP; ix < MINIMAP; ix++) {
+			if (ix * ix + iy * iy <= MINIMAP * MINIMAP) {
+				round_lo[iy + MINIMAP] = min(round_lo[iy + MINIMAP], ix + MINIMAP);
+				round_hi[iy + MINIMAP] = ix + MINIMAP;
+			}
+		}
+	}
+	bzero(mapix2, sizeof(mapix2));
 
 	maptex1 = sdl_create_texture(MAXMAP, MAXMAP);
 	maptex2 = sdl_create_texture(MINIMAP * 2, MINIMAP * 2);
@@ -69,12 +145,13 @@ static void set_pix(int x, int y, unsigned char val)
 		}
 
 		_mmap[x + y * MAXMAP] = val;
-		update1 = update2 = update3 = 1;
+		rect_add(&dirty, x, y, x + 1, y + 1);
+		update3 = 1;
 	}
 }
 
-static void map_save(void);
-static int map_load(void);
+static void map_poll(void);
+static void map_queue_job(int type);
 
 void minimap_update(void)
 {
@@ -84,6 +161,8 @@ void minimap_update(void)
 		return;
 	}
 
+	map_poll();
+
 	ox = (int)originx - (int)DIST;
 	oy = (int)originy - (int)DIST;
 
@@ -134,13 +213,14 @@ void minimap_update(void)
 	}
 	if (rewrite_cnt > 8) {
 		memset(_mmap, 0, sizeof(_mmap));
-		update1 = update2 = 1;
+		area_gen++;
+		map_dirty_all();
 		note("MAP CHANGED: %d", rewrite_cnt);
 	}
-	if (mapnr == -1 && update3) {
+	if (mapnr == -1 && update3 && !load_pending) {
 		update3 = 0;
 		if (game_options & GO_MAPSAVE) {
-			mapnr = map_load();
+			map_queue_job(MJ_LOAD);
 		}
 	}
 }
@@ -187,25 +267,74 @@ static void draw_center2(int x, int y)
 	}
 }
 
+// Rebuild rows [r0, r1) of the round minimap from the cached colors
+static void round_rows(int r0, int r1)
+{
+	int r, lo, hi, x0, x1, y, ix;
+	uint32_t *dst;
+
+	for (r = r0; r < r1; r++) {
+		lo = round_lo[r];
+		hi = round_hi[r];
+		if (lo > hi) {
+			continue;
+		}
+		dst = &mapix2[r * MINIMAP * 2];
+		y = originy - MINIMAP + r;
+
+		if (y < 0 || y >= MAXMAP) {
+			for (ix = lo; ix <= hi; ix++) {
+				dst[ix] = IRGBA(25, 25, 25, 255);
+			}
+			continue;
+		}
+
+		// map columns covered by this row, the parts off the map are dark
+		x0 = originx - MINIMAP + lo;
+		x1 = originx - MINIMAP + hi + 1;
+		for (ix = lo; x0 < 0 && ix <= hi; ix++, x0++) {
+			dst[ix] = IRGBA(25, 25, 25, 255);
+		}
+		for (; x1 > MAXMAP && hi >= ix; hi--, x1--) {
+			dst[hi] = IRGBA(25, 25, 25, 255);
+		}
+		if (x0 < x1) {
+			memcpy(&dst[ix], &mapix1[x0 + y * MAXMAP], (size_t)(x1 - x0) * sizeof(uint32_t));
+		}
+	}
+}
+
 void display_minimap(void)
 {
-	int x, y, ix, iy, i;
-	float dist;
+	int x, y, i, r0, r1;
+	struct map_rect changed;
 	SDL_FRect dr, sr;
+	SDL_Rect rc;
 
 	if (game_options & GO_NOMAP) {
 		return;
 	}
 
-	if (visible & 2) { // display big map
-		if (update1) {
-			for (y = 0; y < MAXMAP; y++) {
-				for (x = 0; x < MAXMAP; x++) {
-					mapix1[x + y * MAXMAP] = pix_col(x, y);
-				}
+	// bring the cached colors up to date where the map changed
+	changed = dirty;
+	if (dirty.x0 < dirty.x1) {
+		for (y = dirty.y0; y < dirty.y1; y++) {
+			for (x = dirty.x0; x < dirty.x1; x++) {
+				mapix1[x + y * MAXMAP] = pix_col(x, y);
 			}
-			SDL_UpdateTexture(maptex1, NULL, mapix1, MAXMAP * sizeof(uint32_t));
-			update1 = 0;
+		}
+		rect_add(&tex1_dirty, dirty.x0, dirty.y0, dirty.x1, dirty.y1);
+		dirty.x0 = dirty.x1 = 0;
+	}
+
+	if (visible & 2) { // display big map
+		if (tex1_dirty.x0 < tex1_dirty.x1) {
+			rc.x = tex1_dirty.x0;
+			rc.y = tex1_dirty.y0;
+			rc.w = tex1_dirty.x1 - tex1_dirty.x0;
+			rc.h = tex1_dirty.y1 - tex1_dirty.y0;
+			SDL_UpdateTexture(maptex1, &rc, &mapix1[rc.x + rc.y * MAXMAP], MAXMAP * sizeof(uint32_t));
+			tex1_dirty.x0 = tex1_dirty.x1 = 0;
 		}
 
 		dr.x = (float)((sx + x_offset) * sdl_scale);
@@ -254,33 +383,31 @@ void display_minimap(void)
 	}
 
 	if (orx != originx || ory != originy) {
-		update2 = 1;
+		round_stale = 1;
 		orx = originx;
 		ory = originy;
 	}
+	if (visible != 1 && changed.x0 < changed.x1) {
+		round_stale = 1;
+	}
 
 	if (visible == 1) {
-		if (update2) {
-			bzero(mapix2, sizeof(mapix2));
-			for (iy = -MINIMAP; iy < MINIMAP; iy++) {
-				for (ix = -MINIMAP; ix < MINIMAP; ix++) {
-					dist = sqrtf((float)(ix * ix + iy * iy));
-					if (dist > MINIMAP) {
-						continue;
-					}
-
-					x = originx + ix;
-					y = originy + iy;
-
-					if (x < 0 || x >= MAXMAP || y < 0 || y >= MAXMAP) {
-						mapix2[MINIMAP + ix + iy * MINIMAP * 2 + MINIMAP * MINIMAP * 2] = IRGBA(25, 25, 25, 255);
-					} else {
-						mapix2[MINIMAP + ix + iy * MINIMAP * 2 + MINIMAP * MINIMAP * 2] = pix_col(x, y);
-					}
-				}
-			}
-			SDL_UpdateTexture(maptex2, NULL, mapix2, MINIMAP * 2 * sizeof(uint32_t));
-			update2 = 0;
+		// every pixel shows another tile after a move, otherwise only the changed rows
+		r0 = r1 = 0;
+		if (round_stale) {
+			r1 = MINIMAP * 2;
+			round_stale = 0;
+		} else if (changed.x0 < changed.x1 && changed.x1 > originx - MINIMAP && changed.x0 < originx + MINIMAP) {
+			r0 = max(changed.y0 - (originy - MINIMAP), 0);
+			r1 = min(changed.y1 - (originy - MINIMAP), MINIMAP * 2);
+		}
+		if (r0 < r1) {
+			round_rows(r0, r1);
+			rc.x = 0;
+			rc.y = r0;
+			rc.w = MINIMAP * 2;
+			rc.h = r1 - r0;
+			SDL_UpdateTexture(maptex2, &rc, &mapix2[r0 * MINIMAP * 2], MINIMAP * 2 * sizeof(uint32_t));
 		}
 
 		dr.x = (float)((mx + x_offset) * sdl_scale);
@@ -306,12 +433,23 @@ void display_minimap(void)
 
 void minimap_clear(void)
 {
+	int i, cnt;
+
 	if (game_options & GO_MAPSAVE) {
-		map_save();
+		for (i = cnt = 0; i < MAXMAP * MAXMAP; i++) {
+			if (_mmap[i]) {
+				cnt++;
+			}
+		}
+		if (cnt >= 250) {
+			map_queue_job(MJ_SAVE);
+		}
 	}
 	mapnr = -1;
+	area_gen++;
 	memset(_mmap, 0, sizeof(_mmap));
-	update1 = update2 = update3 = 1;
+	map_dirty_all();
+	update3 = 1;
 }
 
 void minimap_toggle(void)
@@ -326,198 +464,182 @@ void minimap_hide(void)
 	}
 }
 
-static char *mapname(int i)
+static void queue_push(struct map_queue *q, const struct map_job *job)
 {
-	static char filename[MAX_PATH];
-
-	if (localdata) {
-		sprintf(filename, "%smap%03d.dat", localdata, i);
-	} else {
-		sprintf(filename, "bin/data/map%03d.dat", i);
-	}
+	q->job[(q->head + q->count) % MAPQUEUE] = *job;
+	q->count++;
+}
 
-	return filename;
+static void queue_pop(struct map_queue *q, struct map_job *job)
+{
+	*job = q->job[q->head];
+	q->head = (q->head + 1) % MAPQUEUE;
+	q->count--;
 }
 
-static void map_save(void)
+static int map_worker(void *data __attribute__((unused)))
 {
-	FILE *fp;
-	int i, cnt;
-	char *filename;
+	struct map_job job;
 
-	for (i = cnt = 0; i < MAXMAP * MAXMAP; i++) {
-		if (_mmap[i]) {
-			cnt++;
-		}
-	}
-	if (cnt < 250) {
-		return;
-	}
+	prof_thread_name("minimap io");
 
-	// check if another client wrote the same map
-	// in the meantime
-	mapnr = map_load();
-
-	// new map, find a save-slot
-	if (mapnr == -1) {
-		for (i = 0; i < MAXSAVEMAP; i++) {
-			filename = mapname(i);
-			fp = fopen(filename, "rb");
-			if (!fp) {
-				break;
-			}
-			fclose(fp);
+	while (1) {
+		SDL_LockMutex(job_mutex);
+		while (!todo.count) {
+			SDL_WaitCondition(job_cond, job_mutex);
 		}
-		if (i == MAXSAVEMAP) {
-			warn("Area map storage full! Please use /compactmap to merge duplicate maps.");
-			return;
+		queue_pop(&todo, &job);
+		SDL_UnlockMutex(job_mutex);
+
+		switch (job.type) {
+		case MJ_LOAD:
+			job.nr = mapdb_find(job.map, job.found);
+			break;
+		case MJ_SAVE:
+			// check if another client wrote the same map
+			// in the meantime
+			if ((job.nr = mapdb_find(job.map, job.found)) != -1) {
+				mapdb_merge(job.map, job.found);
+			}
+			job.nr = mapdb_save(job.nr, job.map);
+			break;
+		case MJ_COMPACT:
+			mapdb_compact();
+			break;
+		case MJ_QUIT:
+			return 0;
 		}
-		mapnr = i;
-	}
 
-	filename = mapname(mapnr);
-	// note("saving area map to %s",filename);
-	fp = fopen(filename, "wb");
-	if (fp) {
-		fwrite(_mmap, sizeof(_mmap), 1, fp);
-		fclose(fp);
+		SDL_LockMutex(job_mutex);
+		queue_push(&done, &job);
+		SDL_UnlockMutex(job_mutex);
 	}
 }
 
-static int map_compare(const unsigned char *tmap, const unsigned char *xmap)
+static void map_queue_job(int type)
 {
-	int i, hit, miss;
-
-	for (i = hit = miss = 0; i < MAXMAP * MAXMAP; i++) {
-		// sightblock, fsprite or usable sightblock
-		if (tmap[i] == 1 || tmap[i] == 2 || tmap[i] == 5) {
-			if (xmap[i] == 1 || xmap[i] == 2 || xmap[i] == 5) {
-				hit++;
-			} else if (xmap[i] != 0) {
-				miss++;
-			}
+	struct map_job job;
+
+	if (!job_thread) {
+		job_mutex = SDL_CreateMutex();
+		job_cond = SDL_CreateCondition();
+		if (job_mutex && job_cond) {
+			job_thread = SDL_CreateThread(map_worker, "minimap io", NULL);
 		}
-		// empty or csprite
-		if (tmap[i] == 3 || tmap[i] == 4) {
-			if (xmap[i] == 3 || xmap[i] == 4) {
-				hit++;
-			} else if (xmap[i] != 0) {
-				miss++;
+		if (!job_thread) {
+			warn("Could not start minimap thread: %s", SDL_GetError());
+			if (job_cond) {
+				SDL_DestroyCondition(job_cond);
+				job_cond = NULL;
 			}
+			if (job_mutex) {
+				SDL_DestroyMutex(job_mutex);
+				job_mutex = NULL;
+			}
+			return;
 		}
 	}
-	if (hit < 200) {
-		return 0;
+
+	if (jobs_inflight == MAXMAPJOB) {
+		warn("Minimap jobs backed up, dropping one");
+		return;
 	}
-	if (miss > hit / 100) {
-		return 0;
+
+	memset(&job, 0, sizeof(job));
+	job.type = type;
+	job.nr = mapnr;
+	job.gen = area_gen;
+	if (type == MJ_LOAD || type == MJ_SAVE) {
+		job.map = xmalloc(sizeof(_mmap), MEM_GUI);
+		job.found = xmalloc(sizeof(_mmap), MEM_GUI);
+		memcpy(job.map, _mmap, sizeof(_mmap));
+	}
+	if (type == MJ_LOAD) {
+		load_pending = 1;
 	}
 
-	return hit;
+	jobs_inflight++;
+	SDL_LockMutex(job_mutex);
+	queue_push(&todo, &job);
+	SDL_SignalCondition(job_cond);
+	SDL_UnlockMutex(job_mutex);
 }
 
-static void map_merge(unsigned char *xmap, const unsigned char *tmap)
+// Apply finished jobs, main thread only
+static void map_poll(void)
 {
-	int i;
+	struct map_job job;
 
-	// only overwrite empty parts of the map with loaded data.
-	for (i = 0; i < MAXMAP * MAXMAP; i++) {
-		if (!xmap[i]) {
-			if (tmap[i] == 3) {
-				xmap[i] = 4; // do not load csprites, they move too much
-			} else {
-				xmap[i] = tmap[i];
-			}
-		}
+	if (!job_thread) {
+		return;
 	}
-}
 
-static int map_load(void)
-{
-	FILE *fp;
-	int i, hit, besti = -1, besthit = 0;
-	unsigned char tmap[MAXMAP * MAXMAP];
-	char *filename;
-
-	for (i = 0; i < MAXSAVEMAP; i++) {
-		filename = mapname(i);
-		fp = fopen(filename, "rb");
-		if (!fp) {
-			continue;
+	while (1) {
+		SDL_LockMutex(job_mutex);
+		if (!done.count) {
+			SDL_UnlockMutex(job_mutex);
+			break;
 		}
-		fread(tmap, sizeof(tmap), 1, fp);
-		fclose(fp);
-
-		if (!(hit = map_compare(tmap, _mmap))) {
-			continue;
+		queue_pop(&done, &job);
+		SDL_UnlockMutex(job_mutex);
+
+		jobs_inflight--;
+
+		if (job.type == MJ_LOAD) {
+			load_pending = 0;
+			// the player may have walked on, merge only fills tiles still unknown
+			if (job.gen == area_gen && job.nr != -1) {
+				mapdb_merge(_mmap, job.found);
+				mapnr = job.nr;
+				map_dirty_all();
+			}
 		}
 
-		if (hit > besthit) {
-			besti = i;
-			besthit = hit;
-		}
+		xfree(job.map);
+		xfree(job.found);
 	}
-	if (besti != -1) {
-		filename = mapname(besti);
-		// note("loading area map from %s (%d hits)",filename,besthit);
-		fp = fopen(filename, "rb");
-		if (!fp) {
-			return -1;
-		}
-		fread(tmap, sizeof(tmap), 1, fp);
-		fclose(fp);
-
-		map_merge(_mmap, tmap);
+}
 
-		return besti;
+void minimap_compact(void)
+{
+	if (game_options & GO_NOMAP) {
+		return;
 	}
 
-	return -1;
+	map_queue_job(MJ_COMPACT);
 }
 
-void minimap_compact(void)
+// Finish pending saves and stop the minimap thread
+void minimap_exit(void)
 {
-	FILE *fp;
-	int i, j;
-	char *filename;
-	unsigned char tmap[MAXMAP * MAXMAP], xmap[MAXMAP * MAXMAP];
+	struct map_job job;
 
-	if (game_options & GO_NOMAP) {
+	if (!job_thread) {
 		return;
 	}
 
-	for (i = 0; i < MAXSAVEMAP; i++) {
-		filename = mapname(i);
-		fp = fopen(filename, "rb");
-		if (!fp) {
-			continue;
-		}
-		fread(tmap, sizeof(tmap), 1, fp);
-		fclose(fp);
+	memset(&job, 0, sizeof(job));
+	job.type = MJ_QUIT;
+	SDL_LockMutex(job_mutex);
+	queue_push(&todo, &job);
+	SDL_SignalCondition(job_cond);
+	SDL_UnlockMutex(job_mutex);
 
-		for (j = i + 1; j < MAXSAVEMAP; j++) {
-			filename = mapname(j);
-			fp = fopen(filename, "rb");
-			if (!fp) {
-				continue;
-			}
-			fread(xmap, sizeof(xmap), 1, fp);
-			fclose(fp);
-
-			if (map_compare(tmap, xmap)) {
-				map_merge(tmap, xmap);
-				filename = mapname(i);
-				fp = fopen(filename, "wb");
-				if (!fp) {
-					continue;
-				}
-				fwrite(tmap, sizeof(tmap), 1, fp);
-				fclose(fp);
+	SDL_WaitThread(job_thread, NULL);
+	job_thread = NULL;
 
-				filename = mapname(j);
-				remove(filename);
-				note("merged map %d into map %d", j, i);
-			}
-		}
+	while (done.count) {
+		queue_pop(&done, &job);
+		xfree(job.map);
+		xfree(job.found);
 	}
+	jobs_inflight = 0;
+	load_pending = 0;
+
+	SDL_DestroyCondition(job_cond);
+	SDL_DestroyMutex(job_mutex);
+	job_cond = NULL;
+	job_mutex = NULL;
+
+	mapdb_exit();
 }
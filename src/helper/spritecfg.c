@@ -0,0 +1,97 @@
+/*
+ * Part of Astonia Client (c) Daniel Brockhaus. Please read license.txt.
+ *
+ * spritecfg
+ *
+ * Compiles res/config/character_variants.json, animated_variants.json and
+ * sprite_metadata.json into res/config/sprite_config.bin, which the client
+ * maps at startup instead of parsing the JSON. The blob records size, mtime
+ * and hash of each JSON file, the client ignores it once they change.
+ *
+ * Usage: spritecfg [output]
+ *
+ * Run from the client directory (the one containing res/).
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include "game/sprite_config.h"
+
+// sprite_config.c uses these from the client, the apply functions are never called here
+
+uint16_t originx = 0, originy = 0;
+
+int rrand(int range)
+{
+	return range > 0 ? rand() % range : 0;
+}
+
+void *xmalloc(size_t size, uint8_t ID __attribute__((unused)))
+{
+	return malloc(size);
+}
+
+void xfree(void *ptr)
+{
+	free(ptr);
+}
+
+static void vprint(const char *prefix, const char *format, va_list va)
+{
+	fprintf(stderr, "%s", prefix);
+	vfprintf(stderr, format, va);
+	fprintf(stderr, "\n");
+}
+
+int note(const char *format, ...)
+{
+	va_list va;
+
+	va_start(va, format);
+	vprint("", format, va);
+	va_end(va);
+
+	return 0;
+}
+
+int warn(const char *format, ...)
+{
+	va_list va;
+
+	va_start(va, format);
+	vprint("WARNING: ", format, va);
+	va_end(va);
+
+	return 0;
+}
+
+int fail(const char *format, ...)
+{
+	va_list va;
+
+	va_start(va, format);
+	vprint("ERROR: ", format, va);
+	va_end(va);
+
+	return -1;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 2) {
+		fprintf(stderr, "Usage: %s [output]\n", argv[0]);
+		return 1;
+	}
+
+	if (sprite_config_compile(argc > 1 ? argv[1] : NULL) < 0) {
+		return 1;
+	}
+
+	sprite_config_shutdown();
+
+	return 0;
+}
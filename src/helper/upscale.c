@@ -0,0 +1,406 @@
+/*
+ * Part of Astonia Client (c) Daniel Brockhaus. Please read license.txt.
+ *
+ * upscale
+ *
+ * Scales the 1X sprites the client would otherwise smoothify at load time
+ * (see do_smoothify()) and writes them to res/gx<scale>_up.zip. The pixels
+ * are exactly what sdl_load_image_png() produces before pre-multiplying,
+ * cropped, with the sprite offset in an oFFs chunk. Each entry's comment is
+ * the CRC of the 1X file it was made from, so the client ignores entries
+ * once gx1.zip, gx1_patch.zip or gx1_mod.zip change.
+ *
+ * Usage: upscale <2|3|4> [output]
+ *
+ * Run from the client directory (the one containing res/).
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <png.h>
+#include <zip.h>
+#include <SDL3/SDL.h>
+
+#include "astonia.h"
+#include "sdl/sdl.h"
+#include "sdl/sdl_private.h"
+
+// sdl_smooth.c uses these from the client
+
+static void vprint(const char *prefix, const char *format, va_list va)
+{
+	fprintf(stderr, "%s", prefix);
+	vfprintf(stderr, format, va);
+	fprintf(stderr, "\n");
+}
+
+int note(const char *format, ...)
+{
+	va_list va;
+
+	va_start(va, format);
+	vprint("", format, va);
+	va_end(va);
+
+	return 0;
+}
+
+int warn(const char *format, ...)
+{
+	va_list va;
+
+	va_start(va, format);
+	vprint("WARNING: ", format, va);
+	va_end(va);
+
+	return 0;
+}
+
+int fail(const char *format, ...)
+{
+	va_list va;
+
+	va_start(va, format);
+	vprint("ERROR: ", format, va);
+	va_end(va);
+
+	return -1;
+}
+
+struct mem_file {
+	unsigned char *data;
+	size_t size, pos;
+};
+
+static void mem_read(png_structp png, png_bytep buf, png_size_t len)
+{
+	struct mem_file *m = png_get_io_ptr(png);
+
+	if (len > m->size - m->pos) {
+		png_error(png, "read past end of file");
+	}
+	memcpy(buf, m->data + m->pos, len);
+	m->pos += len;
+}
+
+static void mem_write(png_structp png, png_bytep buf, png_size_t len)
+{
+	struct mem_file *m = png_get_io_ptr(png);
+
+	if (m->pos + len > m->size) {
+		m->size = max(m->size * 2, m->pos + len);
+		m->data = realloc(m->data, m->size);
+		if (!m->data) {
+			png_error(png, "out of memory");
+		}
+	}
+	memcpy(m->data + m->pos, buf, len);
+	m->pos += len;
+}
+
+static void mem_flush(png_structp png __attribute__((unused))) {}
+
+/*
+ * Decode a 1X sprite with the same checks as png_load_helper(). Colour key
+ * and alpha 0 become transparent black. Returns NULL for files the client
+ * would reject.
+ */
+static uint32_t *decode(struct mem_file *in, int *pxres, int *pyres)
+{
+	png_structp png;
+	png_infop info;
+	unsigned char *volatile rows = NULL;
+	uint32_t *volatile pixel = NULL;
+	size_t rowbytes;
+	int xres, yres, bpp, passes;
+
+	png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	if (!png) {
+		return NULL;
+	}
+	info = png_create_info_struct(png);
+	if (!info) {
+		png_destroy_read_struct(&png, NULL, NULL);
+		return NULL;
+	}
+	if (setjmp(png_jmpbuf(png))) {
+		png_destroy_read_struct(&png, &info, NULL);
+		free(rows);
+		free(pixel);
+		return NULL;
+	}
+
+	png_set_read_fn(png, in, mem_read);
+	png_read_info(png, info);
+	png_set_strip_16(png);
+	png_set_packing(png);
+	passes = png_set_interlace_handling(png);
+	png_read_update_info(png, info);
+
+	xres = (int)png_get_image_width(png, info);
+	yres = (int)png_get_image_height(png, info);
+	rowbytes = png_get_rowbytes(png, info);
+	bpp = (int)png_get_channels(png, info);
+
+	if ((bpp != 3 && bpp != 4) || rowbytes != (size_t)xres * (size_t)bpp || png_get_bit_depth(png, info) != 8) {
+		png_longjmp(png, 1);
+	}
+
+	rows = malloc(rowbytes * (size_t)yres);
+	pixel = malloc((size_t)xres * (size_t)yres * sizeof(uint32_t));
+	if (!rows || !pixel) {
+		png_longjmp(png, 1);
+	}
+
+	for (int pass = 0; pass < passes; pass++) {
+		for (int y = 0; y < yres; y++) {
+			png_read_row(png, rows + rowbytes * (size_t)y, NULL);
+		}
+	}
+	png_destroy_read_struct(&png, &info, NULL);
+
+	for (int n = 0; n < xres * yres; n++) {
+		const unsigned char *s = rows + (size_t)n * (size_t)bpp;
+		uint32_t r = s[0], g = s[1], b = s[2], a = bpp == 4 ? s[3] : 255;
+
+		if (!a || (r == 255 && g == 0 && b == 255)) {
+			pixel[n] = 0;
+		} else {
+			pixel[n] = IRGBA(r, g, b, a);
+		}
+	}
+	free(rows);
+
+	*pxres = xres;
+	*pyres = yres;
+
+	return pixel;
+}
+
+/*
+ * Crop, replicate and smoothify like sdl_load_image_png() and encode the
+ * result as PNG. Returns 0 if the sprite has no visible pixels.
+ */
+static int upscale(struct mem_file *in, struct mem_file *out, int scale)
+{
+	int xres, yres, sx, sy, ex, ey, w, h, x, y;
+	uint32_t *src, *pixel, c;
+	png_structp png;
+	png_infop info;
+	unsigned char *line;
+
+	src = decode(in, &xres, &yres);
+	if (!src) {
+		return -1;
+	}
+
+	sx = xres;
+	sy = yres;
+	ex = ey = -1;
+	for (y = 0; y < yres; y++) {
+		for (x = 0; x < xres; x++) {
+			if (src[x + y * xres]) {
+				sx = min(sx, x);
+				ex = max(ex, x);
+				sy = min(sy, y);
+				ey = max(ey, y);
+			}
+		}
+	}
+	if (ex < sx) {
+		free(src);
+		return 0;
+	}
+
+	w = (ex - sx + 1) * scale;
+	h = (ey - sy + 1) * scale;
+	pixel = malloc((size_t)w * (size_t)h * sizeof(uint32_t));
+	line = malloc((size_t)w * 4);
+	if (!pixel || !line) {
+		free(src);
+		free(pixel);
+		free(line);
+		return -1;
+	}
+
+	for (y = 0; y < h; y++) {
+		for (x = 0; x < w; x++) {
+			pixel[x + y * w] = src[sx + x / scale + (sy + y / scale) * xres];
+		}
+	}
+	sdl_smoothify(pixel, w, h, scale);
+
+	png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	info = png ? png_create_info_struct(png) : NULL;
+	if (!info || setjmp(png_jmpbuf(png))) {
+		png_destroy_write_struct(&png, &info);
+		free(src);
+		free(pixel);
+		free(line);
+		return -1;
+	}
+
+	out->pos = 0;
+	png_set_write_fn(png, out, mem_write, mem_flush);
+	png_set_IHDR(png, info, (png_uint_32)w, (png_uint_32)h, 8, PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
+	    PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	// offset in 1X pixels, as sdl_load_image_png() computes it
+	png_set_oFFs(png, info, -(xres / 2) + sx, -(yres / 2) + sy, PNG_OFFSET_PIXEL);
+	png_write_info(png, info);
+
+	for (y = 0; y < h; y++) {
+		for (x = 0; x < w; x++) {
+			c = pixel[x + y * w];
+			// a blend can land on the colour key, don't let the client drop it
+			if (IGET_A(c) && IGET_R(c) == 255 && IGET_G(c) == 0 && IGET_B(c) == 255) {
+				c |= IRGBA(0, 1, 0, 0);
+			}
+			line[x * 4 + 0] = (unsigned char)IGET_R(c);
+			line[x * 4 + 1] = (unsigned char)IGET_G(c);
+			line[x * 4 + 2] = (unsigned char)IGET_B(c);
+			line[x * 4 + 3] = (unsigned char)IGET_A(c);
+		}
+		png_write_row(png, line);
+	}
+	png_write_end(png, NULL);
+	png_destroy_write_struct(&png, &info);
+
+	free(src);
+	free(pixel);
+	free(line);
+
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *input[3] = {"res/gx1.zip", "res/gx1_patch.zip", "res/gx1_mod.zip"};
+	static zip_t *zin[3];
+	static uint8_t src_zip[MAXSPRITE]; // archive number + 1, the last one wins like in the client
+	static zip_uint64_t src_index[MAXSPRITE];
+	char path[64], name[16], comment[16];
+	struct mem_file in = {0}, out = {0};
+	zip_t *zout;
+	int scale, cnt = 0, skipped = 0, err;
+
+	if (argc < 2 || argc > 3 || (scale = atoi(argv[1])) < 2 || scale > 4) {
+		fprintf(stderr, "Usage: %s <2|3|4> [output]\n", argv[0]);
+		return 1;
+	}
+
+	for (int i = 0; i < 3; i++) {
+		zin[i] = zip_open(input[i], ZIP_RDONLY, &err);
+		if (!zin[i]) {
+			if (i == 0) {
+				fail("Could not open %s", input[i]);
+				return 1;
+			}
+			continue;
+		}
+
+		zip_int64_t entries = zip_get_num_entries(zin[i], 0);
+		for (zip_int64_t n = 0; n < entries; n++) {
+			const char *fn = zip_get_name(zin[i], (zip_uint64_t)n, 0);
+			unsigned int sprite;
+			char tail;
+
+			if (fn && sscanf(fn, "%8u.pn%c", &sprite, &tail) == 2 && tail == 'g' && strlen(fn) == 12 &&
+			    sprite < MAXSPRITE) {
+				src_zip[sprite] = (uint8_t)(i + 1);
+				src_index[sprite] = (zip_uint64_t)n;
+			}
+		}
+	}
+
+	if (argc > 2) {
+		snprintf(path, sizeof(path), "%s", argv[2]);
+	} else {
+		snprintf(path, sizeof(path), "res/gx%d_up.zip", scale);
+	}
+	zout = zip_open(path, ZIP_CREATE | ZIP_TRUNCATE, &err);
+	if (!zout) {
+		fail("Could not create %s", path);
+		return 1;
+	}
+
+	for (int sprite = 0; sprite < MAXSPRITE; sprite++) {
+		zip_t *z;
+		zip_file_t *zf;
+		zip_stat_t st;
+		zip_source_t *zs;
+		zip_int64_t idx;
+		int ret;
+
+		if (!src_zip[sprite] || !do_smoothify(sprite)) {
+			continue;
+		}
+		z = zin[src_zip[sprite] - 1];
+
+		if (zip_stat_index(z, src_index[sprite], 0, &st) || !(st.valid & ZIP_STAT_SIZE) ||
+		    !(st.valid & ZIP_STAT_CRC)) {
+			warn("%08d.png: cannot stat", sprite);
+			continue;
+		}
+		in.data = realloc(in.data, max((size_t)st.size, 1));
+		in.size = (size_t)st.size;
+		in.pos = 0;
+		zf = zip_fopen_index(z, src_index[sprite], 0);
+		if (!zf || zip_fread(zf, in.data, st.size) != (zip_int64_t)st.size) {
+			warn("%08d.png: cannot read", sprite);
+			if (zf) {
+				zip_fclose(zf);
+			}
+			continue;
+		}
+		zip_fclose(zf);
+
+		ret = upscale(&in, &out, scale);
+		if (ret < 0) {
+			warn("%08d.png: cannot convert", sprite);
+		}
+		if (ret <= 0) {
+			skipped++;
+			continue;
+		}
+
+		// libzip writes on zip_close() and frees the buffer then
+		unsigned char *buf = malloc(out.pos);
+		if (!buf) {
+			fail("out of memory");
+			return 1;
+		}
+		memcpy(buf, out.data, out.pos);
+		zs = zip_source_buffer(zout, buf, out.pos, 1);
+
+		snprintf(name, sizeof(name), "%08d.png", sprite);
+		snprintf(comment, sizeof(comment), "%08x", (unsigned int)st.crc);
+		if (!zs || (idx = zip_file_add(zout, name, zs, ZIP_FL_OVERWRITE)) < 0) {
+			zip_source_free(zs);
+			fail("%s: %s", name, zip_strerror(zout));
+			return 1;
+		}
+		zip_set_file_compression(zout, (zip_uint64_t)idx, ZIP_CM_STORE, 0); // PNG is compressed already
+		zip_file_set_comment(zout, (zip_uint64_t)idx, comment, 8, 0);
+		cnt++;
+	}
+
+	note("Writing %d sprites to %s (%d skipped)", cnt, path, skipped);
+	if (zip_close(zout)) {
+		fail("%s: %s", path, zip_strerror(zout));
+		zip_discard(zout);
+		return 1;
+	}
+
+	for (int i = 0; i < 3; i++) {
+		if (zin[i]) {
+			zip_discard(zin[i]);
+		}
+	}
+	free(in.data);
+	free(out.data);
+
+	return 0;
+}
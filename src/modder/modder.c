@@ -9,7 +9,10 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <SDL3/SDL_loadso.h>
+#include <SDL3/SDL_timer.h>
 #include <SDL3/SDL_keycode.h>
 
 #include "astonia.h"
@@ -20,6 +23,7 @@
 #include "client/client.h"
 #include "gui/gui.h"
 #include "sdl/sdl.h"
+#include "game/profile.h"
 
 struct mod {
 	void (*_amod_init)(void);
@@ -64,6 +68,65 @@ int (*_amod_display_skill_line)(int v, int base, int curr, int cn, char *buf) =
 int (*_amod_process)(const unsigned char *buf) = NULL;
 int (*_amod_prefetch)(const unsigned char *buf) = NULL;
 
+// Dense per-hook lists of the mods that export that hook, so the callers
+// don't have to walk all MAXMOD slots checking pointers.
+enum {
+	HOOK_INIT,
+	HOOK_EXIT,
+	HOOK_GAMESTART,
+	HOOK_SPRITE_CONFIG,
+	HOOK_FRAME,
+	HOOK_TICK,
+	HOOK_MOUSE_MOVE,
+	HOOK_MOUSE_CLICK,
+	HOOK_MOUSE_CAPTURE,
+	HOOK_AREACHANGE,
+	HOOK_KEYDOWN,
+	HOOK_KEYUP,
+	HOOK_UPDATE_HOVER_TEXTS,
+	HOOK_CLIENT_CMD,
+	HOOK_MAX
+};
+
+static unsigned char hook[HOOK_MAX][MAXMOD];
+static int hook_cnt[HOOK_MAX];
+
+static void hook_add(int h, int i, int present)
+{
+	if (present) {
+		hook[h][hook_cnt[h]++] = (unsigned char)i;
+	}
+}
+
+#define HOOK_EACH(h, i)                                                                                                \
+	for (int _n = 0, i; _n < hook_cnt[h] && (i = hook[h][_n], 1); _n++)
+
+// Time spent in each mod, summed over all its hooks for the current frame. The
+// last MODSTAT_FRAMES frames are kept for the percentiles in the overlay.
+#define MODSTAT_FRAMES 128
+
+struct mod_stat {
+	uint64_t cost; // ns, current frame
+	unsigned short us[MODSTAT_FRAMES];
+	int pos, cnt;
+	uint64_t sum; // ns, since the last budget check
+	int frames;
+	int warned;
+	int throttled;
+};
+
+static struct mod_stat mod_stat[MAXMOD];
+
+#define MOD_CALL(i, call)                                                                                              \
+	do {                                                                                                               \
+		uint64_t _t0 = SDL_GetTicksNS();                                                                               \
+		call;                                                                                                          \
+		mod_stat[i].cost += SDL_GetTicksNS() - _t0;                                                                    \
+	} while (0)
+
+int amod_budget = 0; // share of a frame a mod may use, in percent, 0 for no limit
+int amod_throttle = 0; // run the frame hook of mods over budget only every other frame
+
 char *game_email_main = "<no one>";
 char *game_email_cash = "<no one>";
 char *game_url = "<nowhere>";
@@ -247,9 +310,28 @@ int amod_init(void)
 	}
 
 	for (int i = 0; i < MAXMOD; i++) {
-		if (mod[i]._amod_init) {
-			mod[i]._amod_init();
+		if (!mod[i].loaded) {
+			continue;
 		}
+		hook_add(HOOK_INIT, i, mod[i]._amod_init != NULL);
+		hook_add(HOOK_EXIT, i, mod[i]._amod_exit != NULL);
+		hook_add(HOOK_GAMESTART, i, mod[i]._amod_gamestart != NULL);
+		hook_add(HOOK_SPRITE_CONFIG, i, mod[i]._amod_sprite_config != NULL);
+		hook_add(HOOK_FRAME, i, mod[i]._amod_frame != NULL);
+		hook_add(HOOK_TICK, i, mod[i]._amod_tick != NULL);
+		hook_add(HOOK_MOUSE_MOVE, i, mod[i]._amod_mouse_move != NULL);
+		hook_add(HOOK_MOUSE_CLICK, i, mod[i]._amod_mouse_click != NULL);
+		hook_add(HOOK_MOUSE_CAPTURE, i, mod[i]._amod_mouse_capture != NULL);
+		hook_add(HOOK_AREACHANGE, i, mod[i]._amod_areachange != NULL);
+		hook_add(HOOK_KEYDOWN, i, mod[i]._amod_keydown != NULL);
+		hook_add(HOOK_KEYUP, i, mod[i]._amod_keyup != NULL);
+		hook_add(HOOK_UPDATE_HOVER_TEXTS, i, mod[i]._amod_update_hover_texts != NULL);
+		hook_add(HOOK_CLIENT_CMD, i, mod[i]._amod_client_cmd != NULL);
+	}
+
+	HOOK_EACH(HOOK_INIT, i)
+	{
+		MOD_CALL(i, mod[i]._amod_init());
 	}
 
 	return 1;
@@ -257,63 +339,126 @@ int amod_init(void)
 
 void amod_exit(void)
 {
-	for (int i = 0; i < MAXMOD; i++) {
-		if (mod[i]._amod_exit) {
-			mod[i]._amod_exit();
-		}
+	HOOK_EACH(HOOK_EXIT, i)
+	{
+		MOD_CALL(i, mod[i]._amod_exit());
 	}
 }
 
 void amod_gamestart(void)
 {
-	for (int i = 0; i < MAXMOD; i++) {
-		if (mod[i]._amod_gamestart) {
-			mod[i]._amod_gamestart();
-		}
+	HOOK_EACH(HOOK_GAMESTART, i)
+	{
+		MOD_CALL(i, mod[i]._amod_gamestart());
 	}
 }
 
 void amod_sprite_config(void)
 {
+	HOOK_EACH(HOOK_SPRITE_CONFIG, i)
+	{
+		MOD_CALL(i, mod[i]._amod_sprite_config());
+	}
+}
+
+// Closes the cost sample of the frame that just ended and, once per second,
+// checks every mod against the budget.
+static void mod_stat_frame(void)
+{
+	static int frames = 0;
+	uint64_t budget;
+	int check;
+
+	check = ++frames >= max(frames_per_second, 1);
+	if (check) {
+		frames = 0;
+	}
+	budget = amod_budget > 0 ? (uint64_t)1000000000 / (uint64_t)max(frames_per_second, 1) * (uint64_t)amod_budget / 100 : 0;
+
 	for (int i = 0; i < MAXMOD; i++) {
-		if (mod[i]._amod_sprite_config) {
-			mod[i]._amod_sprite_config();
+		struct mod_stat *ms = &mod_stat[i];
+		uint64_t avg;
+
+		if (!mod[i].loaded) {
+			continue;
+		}
+
+		ms->us[ms->pos] = (unsigned short)min(ms->cost / 1000, (uint64_t)65535);
+		ms->pos = (ms->pos + 1) % MODSTAT_FRAMES;
+		ms->cnt = min(ms->cnt + 1, MODSTAT_FRAMES);
+		ms->sum += ms->cost;
+		ms->frames++;
+		ms->cost = 0;
+
+		if (!check) {
+			continue;
+		}
+
+		avg = ms->sum / (uint64_t)ms->frames;
+		ms->sum = 0;
+		ms->frames = 0;
+
+		if (!budget) {
+			continue;
+		}
+
+		if (avg > budget) {
+			if (!ms->warned) {
+				warn("%cmod takes %.2fms per frame, budget is %.2fms (%d%%)%s", 'a' + i, (double)avg / 1000000.0,
+				    (double)budget / 1000000.0, amod_budget, amod_throttle ? ", throttling its frame hook" : "");
+				ms->warned = 1;
+			}
+			if (amod_throttle) {
+				ms->throttled = 1;
+			}
+		} else if (ms->throttled && avg * 2 < budget) {
+			// throttling roughly halves the cost, so twice the average is what it would use without
+			ms->throttled = 0;
 		}
 	}
 }
 
 void amod_frame(void)
 {
-	for (int i = 0; i < MAXMOD; i++) {
-		if (mod[i]._amod_frame) {
-			mod[i]._amod_frame();
+	static unsigned int frame = 0;
+
+	PROF_ZONE("amod_frame");
+
+	mod_stat_frame();
+	frame++;
+
+	HOOK_EACH(HOOK_FRAME, i)
+	{
+		if (mod_stat[i].throttled && (frame & 1)) {
+			continue;
 		}
+		MOD_CALL(i, mod[i]._amod_frame());
 	}
 }
 
 void amod_tick(void)
 {
-	for (int i = 0; i < MAXMOD; i++) {
-		if (mod[i]._amod_tick) {
-			mod[i]._amod_tick();
-		}
+	HOOK_EACH(HOOK_TICK, i)
+	{
+		MOD_CALL(i, mod[i]._amod_tick());
 	}
 }
 
 void amod_mouse_move(int x, int y)
 {
-	for (int i = 0; i < MAXMOD; i++) {
-		if (mod[i]._amod_mouse_move) {
-			mod[i]._amod_mouse_move(x, y);
-		}
+	HOOK_EACH(HOOK_MOUSE_MOVE, i)
+	{
+		MOD_CALL(i, mod[i]._amod_mouse_move(x, y));
 	}
 }
 
 int amod_mouse_click(int x, int y, int what)
 {
 	int ret = 0, tmp;
-	for (int i = 0; i < MAXMOD; i++) {
-		if (mod[i]._amod_mouse_click && (tmp = mod[i]._amod_mouse_click(x, y, what))) {
+	HOOK_EACH(HOOK_MOUSE_CLICK, i)
+	{
+		MOD_CALL(i, tmp = mod[i]._amod_mouse_click(x, y, what));
+		if (tmp) {
 			if (tmp > 0) {
 				return 1;
 			} else {
@@ -326,27 +471,27 @@ int amod_mouse_click(int x, int y, int what)
 
 void amod_mouse_capture(int onoff)
 {
-	for (int i = 0; i < MAXMOD; i++) {
-		if (mod[i]._amod_mouse_capture) {
-			mod[i]._amod_mouse_capture(onoff);
-		}
+	HOOK_EACH(HOOK_MOUSE_CAPTURE, i)
+	{
+		MOD_CALL(i, mod[i]._amod_mouse_capture(onoff));
 	}
 }
 
 void amod_areachange(void)
 {
-	for (int i = 0; i < MAXMOD; i++) {
-		if (mod[i]._amod_areachange) {
-			mod[i]._amod_areachange();
-		}
+	HOOK_EACH(HOOK_AREACHANGE, i)
+	{
+		MOD_CALL(i, mod[i]._amod_areachange());
 	}
 }
 
 int amod_keydown(SDL_Keycode key)
 {
 	int ret = 0, tmp;
-	for (int i = 0; i < MAXMOD; i++) {
-		if (mod[i]._amod_keydown && (tmp = mod[i]._amod_keydown(key))) {
+	HOOK_EACH(HOOK_KEYDOWN, i)
+	{
+		MOD_CALL(i, tmp = mod[i]._amod_keydown(key));
+		if (tmp) {
 			sdl_flush_textinput();
 			if (tmp > 0) {
 				return 1;
@@ -361,8 +506,10 @@ int amod_keydown(SDL_Keycode key)
 int amod_keyup(SDL_Keycode key)
 {
 	int ret = 0, tmp;
-	for (int i = 0; i < MAXMOD; i++) {
-		if (mod[i]._amod_keyup && (tmp = mod[i]._amod_keyup(key))) {
+	HOOK_EACH(HOOK_KEYUP, i)
+	{
+		MOD_CALL(i, tmp = mod[i]._amod_keyup(key));
+		if (tmp) {
 			if (tmp > 0) {
 				return 1;
 			} else {
@@ -375,18 +522,19 @@ int amod_keyup(SDL_Keycode key)
 
 void amod_update_hover_texts(void)
 {
-	for (int i = 0; i < MAXMOD; i++) {
-		if (mod[i]._amod_update_hover_texts) {
-			mod[i]._amod_update_hover_texts();
-		}
+	HOOK_EACH(HOOK_UPDATE_HOVER_TEXTS, i)
+	{
+		MOD_CALL(i, mod[i]._amod_update_hover_texts());
 	}
 }
 
 int amod_client_cmd(const char *buf)
 {
 	int ret = 0, tmp;
-	for (int i = 0; i < MAXMOD; i++) {
-		if (mod[i]._amod_client_cmd && (tmp = mod[i]._amod_client_cmd(buf))) {
+	HOOK_EACH(HOOK_CLIENT_CMD, i)
+	{
+		MOD_CALL(i, tmp = mod[i]._amod_client_cmd(buf));
+		if (tmp) {
 			if (tmp > 0) {
 				return 1;
 			} else {
@@ -397,6 +545,36 @@ int amod_client_cmd(const char *buf)
 	return ret;
 }
 
+static int cmp_ushort(const void *a, const void *b)
+{
+	return (int)*(const unsigned short *)a - (int)*(const unsigned short *)b;
+}
+
+// Median and 99th percentile of the per-frame cost of mod idx, in microseconds,
+// over the last MODSTAT_FRAMES frames. Returns 0 if that mod is not loaded.
+int amod_stat(int idx, int *p50, int *p99, int *throttled)
+{
+	unsigned short tmp[MODSTAT_FRAMES];
+	struct mod_stat *ms;
+
+	if (idx < 0 || idx >= MAXMOD || !mod[idx].loaded) {
+		return 0;
+	}
+	ms = &mod_stat[idx];
+
+	if (!ms->cnt) {
+		*p50 = *p99 = 0;
+	} else {
+		memcpy(tmp, ms->us, sizeof(tmp[0]) * (size_t)ms->cnt);
+		qsort(tmp, (size_t)ms->cnt, sizeof(tmp[0]), cmp_ushort);
+		*p50 = tmp[ms->cnt / 2];
+		*p99 = tmp[(ms->cnt * 99) / 100];
+	}
+	*throttled = ms->throttled;
+
+	return 1;
+}
+
 int amod_display_skill_line(int v, int base, int curr, int cn, char *buf)
 {
 	if (_amod_display_skill_line) {
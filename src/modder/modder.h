@@ -25,11 +25,19 @@ int amod_client_cmd(const char *buf);
 int amod_process(const unsigned char *buf);
 int amod_prefetch(const unsigned char *buf);
 int amod_is_playersprite(int sprite);
+int amod_stat(int idx, int *p50, int *p99, int *throttled);
+
+extern int amod_budget;
+extern int amod_throttle;
 
 int sharedmem_init(void);
 void sharedmem_update(void);
 void sharedmem_exit(void);
 
+int telemetry_init(void);
+void telemetry_update(void);
+void telemetry_exit(void);
+
 /* Sprite config API - load additional variants from JSON in amod_sprite_config() */
 int sprite_config_load_characters(const char *path);
 int sprite_config_load_animated(const char *path);
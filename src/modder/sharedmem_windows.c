@@ -44,7 +44,7 @@ static void random_dungeon_tracker(void)
 		sm->swapped = 1;
 	}
 
-	sm->isprite = (char *)&map[MAXMN / 2] - sm->base + (char *)&map->isprite - (char *)&map;
+	sm->isprite = (char *)&map[MAPDX * MAPDY / 2].isprite - sm->base;
 	sm->flags = (char *)&map->flags - (char *)&map->isprite;
 	sm->fsprite = (char *)&map->fsprite - (char *)&map->isprite;
 
@@ -108,6 +108,9 @@ void sharedmem_update(void)
 {
 	int endup;
 
+	// map moves when the view distance changes
+	random_dungeon_tracker();
+
 	if (value[0][sv_val(V_ENDURANCE)]) {
 		endup = 100 * endurance / value[0][sv_val(V_ENDURANCE)];
 	} else {
@@ -0,0 +1,197 @@
+/*
+ * Part of Astonia Client (c) Daniel Brockhaus. Please read license.txt.
+ *
+ * Telemetry
+ *
+ * Publishes player state, a small map view and performance counters in a
+ * shared memory region for external overlays and monitoring tools. The layout
+ * is in include/astonia_telemetry.h.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "astonia.h"
+#include "astonia_telemetry.h"
+#include "modder/modder.h"
+#include "client/client.h"
+#include "gui/gui.h"
+#include "game/memory.h"
+
+extern uint64_t gui_frametime, gui_ticktime;
+extern long long texc_hit, texc_miss, texc_pre;
+
+static struct telemetry *tm;
+static uint64_t tm_frames;
+#ifdef _WIN32
+static HANDLE tm_handle;
+#else
+static char tm_name[40];
+#endif
+
+int telemetry_init(void)
+{
+#ifdef _WIN32
+	char name[40];
+
+	sprintf(name, "MOACT%lu", GetCurrentProcessId());
+	tm_handle = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(struct telemetry), name);
+	if (!tm_handle) {
+		warn("telemetry: could not create file mapping %s (%lu)", name, GetLastError());
+		return 0;
+	}
+	tm = (void *)MapViewOfFile(tm_handle, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(struct telemetry));
+	if (!tm) {
+		warn("telemetry: could not map %s (%lu)", name, GetLastError());
+		CloseHandle(tm_handle);
+		tm_handle = NULL;
+		return 0;
+	}
+#else
+	const char *name = tm_name;
+	void *ptr;
+	int fd;
+
+	sprintf(tm_name, "/moac-%ld", (long)getpid());
+	fd = shm_open(tm_name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd == -1) {
+		warn("telemetry: could not create shared memory %s", tm_name);
+		return 0;
+	}
+	if (ftruncate(fd, sizeof(struct telemetry)) == -1) {
+		warn("telemetry: could not size shared memory %s", tm_name);
+		close(fd);
+		shm_unlink(tm_name);
+		return 0;
+	}
+	ptr = mmap(NULL, sizeof(struct telemetry), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ptr == MAP_FAILED) {
+		warn("telemetry: could not map shared memory %s", tm_name);
+		shm_unlink(tm_name);
+		return 0;
+	}
+	tm = ptr;
+#endif
+
+	memset(tm, 0, sizeof(*tm));
+	tm->version = TELEMETRY_VERSION;
+	tm->size = sizeof(*tm);
+#ifdef _WIN32
+	tm->pid = (uint32_t)GetCurrentProcessId();
+#else
+	tm->pid = (uint32_t)getpid();
+#endif
+	// readers check magic first, so it goes in last
+	__atomic_store_n(&tm->magic, TELEMETRY_MAGIC, __ATOMIC_RELEASE);
+
+	note("telemetry published as %s", name);
+
+	return 1;
+}
+
+void telemetry_exit(void)
+{
+	if (!tm) {
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(tm);
+	CloseHandle(tm_handle);
+	tm_handle = NULL;
+#else
+	munmap(tm, sizeof(struct telemetry));
+	shm_unlink(tm_name);
+#endif
+	tm = NULL;
+}
+
+static void telemetry_map(void)
+{
+	unsigned int x, y;
+	int dx, dy;
+	map_index_t mn;
+	struct telemetry_tile *tt;
+
+	for (dy = -TELEMETRY_DIST; dy <= TELEMETRY_DIST; dy++) {
+		for (dx = -TELEMETRY_DIST; dx <= TELEMETRY_DIST; dx++) {
+			tt = &tm->map[(dx + TELEMETRY_DIST) + (dy + TELEMETRY_DIST) * TELEMETRY_DIM];
+
+			// mapmn() rejects the tiles outside a smaller view distance, the casts wrap negatives
+			x = (unsigned int)((int)DIST + dx);
+			y = (unsigned int)((int)DIST + dy);
+			mn = mapmn(x, y);
+			if (mn == MAXMN) {
+				memset(tt, 0, sizeof(*tt));
+				continue;
+			}
+
+			tt->gsprite = map[mn].gsprite;
+			tt->fsprite = map[mn].fsprite;
+			tt->isprite = map[mn].isprite;
+			tt->csprite = map[mn].csprite;
+			tt->flags = map[mn].flags;
+			tt->health = map[mn].health;
+			tt->light = (uint8_t)max(map[mn].rlight, 0);
+		}
+	}
+}
+
+// Called once per displayed frame.
+void telemetry_update(void)
+{
+	uint32_t seq;
+
+	if (!tm) {
+		return;
+	}
+
+	tm_frames++;
+
+	seq = __atomic_load_n(&tm->seq, __ATOMIC_RELAXED);
+	__atomic_store_n(&tm->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	tm->connected = sockstate == 4;
+
+	tm->tick = tick;
+	tm->originx = originx;
+	tm->originy = originy;
+	tm->hp = hp;
+	tm->hp_max = value[0][sv_val(V_HP)];
+	tm->mana = mana;
+	tm->mana_max = value[0][sv_val(V_MANA)];
+	tm->endurance = endurance;
+	tm->endurance_max = value[0][sv_val(V_ENDURANCE)];
+	tm->lifeshield = lifeshield;
+	tm->rage = rage;
+	tm->experience = experience;
+	tm->gold = gold;
+
+	tm->fps = (uint32_t)max(frames_per_second, 0);
+	tm->frametime = (uint32_t)min(gui_frametime, (uint64_t)UINT32_MAX);
+	tm->ticktime = (uint32_t)min(gui_ticktime, (uint64_t)UINT32_MAX);
+	tm->tick_interval = (uint32_t)min(tick_receive_interval, (uint64_t)UINT32_MAX);
+	tm->tick_queue = (uint32_t)max(lasttick + q_size, 0);
+	tm->frames = tm_frames;
+	tm->texc_hit = (uint64_t)texc_hit;
+	tm->texc_miss = (uint64_t)texc_miss;
+	tm->texc_pre = (uint64_t)texc_pre;
+	tm->mem_used = memused;
+
+	if (tm->connected) {
+		telemetry_map();
+	} else {
+		memset(tm->map, 0, sizeof(tm->map));
+	}
+
+	__atomic_store_n(&tm->seq, seq + 2, __ATOMIC_RELEASE);
+}
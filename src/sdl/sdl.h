@@ -43,6 +43,13 @@ DLL_EXPORT extern int sdl_cache_size;
 DLL_EXPORT extern int sdl_scale;
 DLL_EXPORT extern int sdl_frames;
 DLL_EXPORT extern int sdl_multi;
+DLL_EXPORT extern int sdl_pacing;
+
+// frame pacing modes (sdl_pacing)
+#define SDL_PACE_CAP      0 // frames at the -k rate, idle until each deadline (default)
+#define SDL_PACE_VSYNC    1 // a frame per vertical blank, presenting does the waiting
+#define SDL_PACE_UNCAPPED 2 // no vsync, no waiting, for benchmarking
+#define SDL_PACE_LOWPOWER 3 // frames at the -k rate, sleep through to each deadline
 
 extern int sound_volume;
 
@@ -50,6 +57,7 @@ void sdl_set_cursor(int cursor);
 int init_sound(void);
 void sound_exit(void);
 void play_sound(unsigned int nr, int vol, int p);
+void sound_prefetch(unsigned int nr);
 
 // Mod sound API
 // Sounds loaded from: sx_mod.zip > sx_patch.zip > sx.zip
@@ -91,6 +99,9 @@ void sdl_exit(void);
 void sdl_loop(void);
 int sdl_clear(void);
 int sdl_render(void);
+int sdl_pre_do(void);
+void sdl_pre_wait(uint64_t until);
+void sdl_pixel_trim(int all);
 int sdlt_xoff(int cache_index);
 int sdlt_yoff(int cache_index);
 int sdlt_xres(int cache_index);
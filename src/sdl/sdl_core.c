@@ -10,7 +10,6 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
-#include <zip.h>
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_timer.h>
 #include <SDL3_mixer/SDL_mixer.h>
@@ -22,6 +21,7 @@
 #include "sdl/sdl.h"
 #include "sdl/sdl_private.h"
 #include "gui/gui.h"
+#include "game/profile.h"
 
 // SDL window and renderer
 SDL_Window *sdlwnd = NULL;
@@ -30,16 +30,9 @@ SDL_Renderer *sdlren = NULL;
 // Cursors
 static SDL_Cursor *curs[20];
 
-// Zip archives for graphics
-zip_t *sdl_zip1 = NULL;
-zip_t *sdl_zip2 = NULL;
-zip_t *sdl_zip1p = NULL;
-zip_t *sdl_zip2p = NULL;
-zip_t *sdl_zip1m = NULL;
-zip_t *sdl_zip2m = NULL;
-
 // Prefetch threading (shared with sdl_texture.c)
 SDL_Semaphore *prework = NULL;
+SDL_Semaphore *premade = NULL; // signalled by the workers whenever a texture is ready for upload
 SDL_Mutex *premutex = NULL;
 
 // SDL3_mixer globals
@@ -50,13 +43,12 @@ MIX_Track *sdl_tracks[MAX_SOUND_CHANNELS] = {NULL};
 DLL_EXPORT int sdl_scale = 1;
 DLL_EXPORT int sdl_frames = 0;
 DLL_EXPORT int sdl_multi = 4;
+DLL_EXPORT int sdl_pacing = SDL_PACE_CAP;
 DLL_EXPORT int sdl_cache_size = 8000;
 DLL_EXPORT int __yres = YRES0;
 
 // Worker thread management
 
-struct zip_handles;
-struct zip_handles *worker_zips = NULL;
 SDL_AtomicInt worker_quit;
 SDL_Thread **worker_threads = NULL;
 
@@ -211,7 +203,8 @@ int sdl_init(int width, int height, char *title, int monitor)
 		return 0;
 	}
 
-	SDL_SetRenderVSync(sdlren, 1);
+	// the benchmark mode wants every frame it can get, all others present on the vertical blank
+	SDL_SetRenderVSync(sdlren, sdl_pacing == SDL_PACE_UNCAPPED ? 0 : 1);
 
 	// Initialize hash table (statically allocated)
 	for (i = 0; i < MAX_TEXHASH; i++) {
@@ -322,29 +315,11 @@ int sdl_init(int width, int height, char *title, int monitor)
 
 	sdl_create_cursors();
 
-	sdl_zip1 = zip_open("res/gx1.zip", ZIP_RDONLY, NULL);
-	sdl_zip1p = zip_open("res/gx1_patch.zip", ZIP_RDONLY, NULL);
-	sdl_zip1m = zip_open("res/gx1_mod.zip", ZIP_RDONLY, NULL);
-
-	switch (sdl_scale) {
-	case 2:
-		sdl_zip2 = zip_open("res/gx2.zip", ZIP_RDONLY, NULL);
-		sdl_zip2p = zip_open("res/gx2_patch.zip", ZIP_RDONLY, NULL);
-		sdl_zip2m = zip_open("res/gx2_mod.zip", ZIP_RDONLY, NULL);
-		break;
-	case 3:
-		sdl_zip2 = zip_open("res/gx3.zip", ZIP_RDONLY, NULL);
-		sdl_zip2p = zip_open("res/gx3_patch.zip", ZIP_RDONLY, NULL);
-		sdl_zip2m = zip_open("res/gx3_mod.zip", ZIP_RDONLY, NULL);
-		break;
-	case 4:
-		sdl_zip2 = zip_open("res/gx4.zip", ZIP_RDONLY, NULL);
-		sdl_zip2p = zip_open("res/gx4_patch.zip", ZIP_RDONLY, NULL);
-		sdl_zip2m = zip_open("res/gx4_mod.zip", ZIP_RDONLY, NULL);
-		break;
-	default:
-		break;
+	// Graphics archives and base images, shared by the main thread and all workers
+	if (sdl_gx_open(sdl_scale) < 0) {
+		sdl_gx_missing();
 	}
+	sdl_make_init();
 
 	if (game_options & GO_SOUND) {
 		if (!MIX_Init()) {
@@ -384,148 +359,44 @@ int sdl_init(int width, int height, char *title, int monitor)
 		return 0;
 	}
 
+	// Initialize semaphore the main thread waits on while idle (starts at 0)
+	premade = SDL_CreateSemaphore(0);
+	if (!premade) {
+		fail("Failed to create premade semaphore");
+		return 0;
+	}
+
 	SDL_SetAtomicInt(&worker_quit, 0);
 
 	if (sdl_multi) {
 		char buf[80];
 		int n;
 
-		// Allocate worker zip handles
-		worker_zips = xmalloc((size_t)sdl_multi * sizeof(struct zip_handles), MEM_SDL_BASE);
-		if (!worker_zips) {
-			fail("Out of memory for worker zip handles");
+		worker_threads = xmalloc((size_t)sdl_multi * sizeof(SDL_Thread *), MEM_SDL_BASE);
+		if (!worker_threads) {
+			fail("Out of memory for thread handles");
 			sdl_multi = 0;
 		} else {
-			// Open zip handles for each worker
+			// Create all threads
 			for (n = 0; n < sdl_multi; n++) {
-				worker_zips[n].zip1 = zip_open("res/gx1.zip", ZIP_RDONLY, NULL);
-				worker_zips[n].zip1p = zip_open("res/gx1_patch.zip", ZIP_RDONLY, NULL);
-				worker_zips[n].zip1m = zip_open("res/gx1_mod.zip", ZIP_RDONLY, NULL);
-
-				switch (sdl_scale) {
-				case 2:
-					worker_zips[n].zip2 = zip_open("res/gx2.zip", ZIP_RDONLY, NULL);
-					worker_zips[n].zip2p = zip_open("res/gx2_patch.zip", ZIP_RDONLY, NULL);
-					worker_zips[n].zip2m = zip_open("res/gx2_mod.zip", ZIP_RDONLY, NULL);
-					break;
-				case 3:
-					worker_zips[n].zip2 = zip_open("res/gx3.zip", ZIP_RDONLY, NULL);
-					worker_zips[n].zip2p = zip_open("res/gx3_patch.zip", ZIP_RDONLY, NULL);
-					worker_zips[n].zip2m = zip_open("res/gx3_mod.zip", ZIP_RDONLY, NULL);
-					break;
-				case 4:
-					worker_zips[n].zip2 = zip_open("res/gx4.zip", ZIP_RDONLY, NULL);
-					worker_zips[n].zip2p = zip_open("res/gx4_patch.zip", ZIP_RDONLY, NULL);
-					worker_zips[n].zip2m = zip_open("res/gx4_mod.zip", ZIP_RDONLY, NULL);
-					break;
-				default:
-					break;
-				}
-
-				if (!worker_zips[n].zip1) {
-					warn("Worker %d: Failed to open res/gx1.zip - aborting initialization", n);
-					// Clean up already opened zips
+				sprintf(buf, "moac background worker %d", n);
+				worker_threads[n] = SDL_CreateThread(sdl_pre_backgnd, buf, (void *)(long long)n);
+				if (!worker_threads[n]) {
+					warn("Failed to create worker thread %d", n);
+					// Signal quit and join already created threads
+					SDL_SetAtomicInt(&worker_quit, 1);
 					for (int i = 0; i < n; i++) {
-						if (worker_zips[i].zip1) {
-							zip_close(worker_zips[i].zip1);
-						}
-						if (worker_zips[i].zip1p) {
-							zip_close(worker_zips[i].zip1p);
-						}
-						if (worker_zips[i].zip1m) {
-							zip_close(worker_zips[i].zip1m);
-						}
-						if (worker_zips[i].zip2) {
-							zip_close(worker_zips[i].zip2);
-						}
-						if (worker_zips[i].zip2p) {
-							zip_close(worker_zips[i].zip2p);
-						}
-						if (worker_zips[i].zip2m) {
-							zip_close(worker_zips[i].zip2m);
+						if (worker_threads[i]) {
+							SDL_WaitThread(worker_threads[i], NULL);
 						}
 					}
-					xfree(worker_zips);
-					worker_zips = NULL;
+					// Clean up
+					xfree(worker_threads);
+					worker_threads = NULL;
 					sdl_multi = 0;
 					break;
 				}
 			}
-
-			// Only create threads if all zip handles succeeded
-			if (sdl_multi > 0) {
-				worker_threads = xmalloc((size_t)sdl_multi * sizeof(SDL_Thread *), MEM_SDL_BASE);
-				if (!worker_threads) {
-					fail("Out of memory for thread handles");
-					// Clean up zip handles
-					for (n = 0; n < sdl_multi; n++) {
-						if (worker_zips[n].zip1) {
-							zip_close(worker_zips[n].zip1);
-						}
-						if (worker_zips[n].zip1p) {
-							zip_close(worker_zips[n].zip1p);
-						}
-						if (worker_zips[n].zip1m) {
-							zip_close(worker_zips[n].zip1m);
-						}
-						if (worker_zips[n].zip2) {
-							zip_close(worker_zips[n].zip2);
-						}
-						if (worker_zips[n].zip2p) {
-							zip_close(worker_zips[n].zip2p);
-						}
-						if (worker_zips[n].zip2m) {
-							zip_close(worker_zips[n].zip2m);
-						}
-					}
-					xfree(worker_zips);
-					worker_zips = NULL;
-					sdl_multi = 0;
-				} else {
-					// Create all threads
-					for (n = 0; n < sdl_multi; n++) {
-						sprintf(buf, "moac background worker %d", n);
-						worker_threads[n] = SDL_CreateThread(sdl_pre_backgnd, buf, (void *)(long long)n);
-						if (!worker_threads[n]) {
-							warn("Failed to create worker thread %d", n);
-							// Signal quit and join already created threads
-							SDL_SetAtomicInt(&worker_quit, 1);
-							for (int i = 0; i < n; i++) {
-								if (worker_threads[i]) {
-									SDL_WaitThread(worker_threads[i], NULL);
-								}
-							}
-							// Clean up
-							xfree(worker_threads);
-							worker_threads = NULL;
-							for (int i = 0; i < sdl_multi; i++) {
-								if (worker_zips[i].zip1) {
-									zip_close(worker_zips[i].zip1);
-								}
-								if (worker_zips[i].zip1p) {
-									zip_close(worker_zips[i].zip1p);
-								}
-								if (worker_zips[i].zip1m) {
-									zip_close(worker_zips[i].zip1m);
-								}
-								if (worker_zips[i].zip2) {
-									zip_close(worker_zips[i].zip2);
-								}
-								if (worker_zips[i].zip2p) {
-									zip_close(worker_zips[i].zip2p);
-								}
-								if (worker_zips[i].zip2m) {
-									zip_close(worker_zips[i].zip2m);
-								}
-							}
-							xfree(worker_zips);
-							worker_zips = NULL;
-							sdl_multi = 0;
-							break;
-						}
-					}
-				}
-			}
 		}
 	}
 
@@ -578,56 +449,19 @@ void sdl_exit(void)
 		worker_threads = NULL;
 	}
 
-	// Close worker zip handles
-	if (worker_zips) {
-		for (int n = 0; n < sdl_multi; n++) {
-			if (worker_zips[n].zip1) {
-				zip_close(worker_zips[n].zip1);
-			}
-			if (worker_zips[n].zip1p) {
-				zip_close(worker_zips[n].zip1p);
-			}
-			if (worker_zips[n].zip1m) {
-				zip_close(worker_zips[n].zip1m);
-			}
-			if (worker_zips[n].zip2) {
-				zip_close(worker_zips[n].zip2);
-			}
-			if (worker_zips[n].zip2p) {
-				zip_close(worker_zips[n].zip2p);
-			}
-			if (worker_zips[n].zip2m) {
-				zip_close(worker_zips[n].zip2m);
-			}
-		}
-		xfree(worker_zips);
-		worker_zips = NULL;
-	}
-
-	if (sdl_zip1) {
-		zip_close(sdl_zip1);
-	}
-	if (sdl_zip1m) {
-		zip_close(sdl_zip1m);
-	}
-	if (sdl_zip1p) {
-		zip_close(sdl_zip1p);
-	}
-	if (sdl_zip2) {
-		zip_close(sdl_zip2);
-	}
-	if (sdl_zip2m) {
-		zip_close(sdl_zip2m);
-	}
-	if (sdl_zip2p) {
-		zip_close(sdl_zip2p);
-	}
+	sdl_gx_close();
+	sdl_make_exit();
 
 	if (prework) {
 		SDL_DestroySemaphore(prework);
 		prework = NULL;
 	}
 
+	if (premade) {
+		SDL_DestroySemaphore(premade);
+		premade = NULL;
+	}
+
 	if (premutex) {
 		SDL_DestroyMutex(premutex);
 		premutex = NULL;
@@ -937,7 +771,7 @@ int if_single_thread_process_one_job(void)
 	// Do the actual work: load image and do stages 1+2
 	unsigned int sprite = tex->sprite;
 
-	if (sdl_ic_load(sprite, NULL) < 0) {
+	if (sdl_ic_load(sprite) < 0) {
 		// Failed: mark idle and leave DIDMAKE unset
 		// Generation can't change under us in single-threaded mode.
 		return 0;
@@ -983,7 +817,7 @@ void sdl_pre_add(unsigned int sprite, signed char sink, unsigned char freeze, un
 	if (!sdl_multi) {
 		if (!(flags_load(slot) & SF_DIDMAKE)) {
 			unsigned int sprite_id = slot->sprite;
-			if (sdl_ic_load(sprite_id, NULL) >= 0) {
+			if (sdl_ic_load(sprite_id) >= 0) {
 				sdl_make(slot, &sdli[sprite_id], 1);
 				sdl_make(slot, &sdli[sprite_id], 2);
 			}
@@ -1051,6 +885,14 @@ int sdl_pre_do(void)
 
 	start = SDL_GetTicks();
 
+	// The scan below picks up everything the workers finished so far. Drop
+	// their wake-ups, only sdl_pre_wait() in capped pacing consumes them and
+	// the count would otherwise grow every frame in the other modes
+	if (premade) {
+		while (SDL_TryWaitSemaphore(premade)) {
+		}
+	}
+
 	// Single-threaded: process jobs from queue (will no-op if called from multi)
 	if_single_thread_process_one_job();
 
@@ -1081,16 +923,37 @@ int sdl_pre_do(void)
 	return uploads;
 }
 
+// Idle the main thread until the deadline (in SDL_GetTicks() time). Returns
+// early when a worker finished a texture, so the caller can upload it and
+// wait again. Without workers there is nothing to wake us, so just sleep.
+void sdl_pre_wait(Uint64 until)
+{
+	Uint64 t = SDL_GetTicks();
+
+	if (t >= until) {
+		return;
+	}
+
+	if (sdl_multi && premade) {
+		SDL_WaitSemaphoreTimeout(premade, (Sint32)(until - t));
+	} else {
+		SDL_DelayPrecise((until - t) * 1000000ull);
+	}
+}
+
 uint64_t sdl_backgnd_wait = 0, sdl_backgnd_work = 0, sdl_backgnd_jobs = 0;
 
 int sdl_pre_backgnd(void *ptr)
 {
 	int worker_id = (int)(long long)ptr;
-	struct zip_handles *zips = worker_zips ? &worker_zips[worker_id] : NULL;
 	uint64_t wait_start, work_start;
+	char name[32];
 
 	SDL_SetCurrentThreadPriority(SDL_THREAD_PRIORITY_LOW);
 
+	snprintf(name, sizeof(name), "worker %d", worker_id);
+	prof_thread_name(name);
+
 	for (;;) {
 		// Wait for work to be available (blocks until signaled)
 		wait_start = SDL_GetTicks();
@@ -1136,7 +999,9 @@ int sdl_pre_backgnd(void *ptr)
 		// Do the actual work: load image and do stages 1+2
 		unsigned int sprite = tex->sprite;
 
-		if (sdl_ic_load(sprite, zips) < 0) {
+		PROF_ZONE("texture job");
+
+		if (sdl_ic_load(sprite) < 0) {
 			// Failed: leave DIDMAKE unset, allow main thread to handle fallback
 			SDL_LockMutex(g_tex_jobs.mutex);
 			if (tex->generation == job.generation) {
@@ -1157,6 +1022,10 @@ int sdl_pre_backgnd(void *ptr)
 		}
 		SDL_UnlockMutex(g_tex_jobs.mutex);
 
+		if (premade) {
+			SDL_SignalSemaphore(premade);
+		}
+
 		sdl_backgnd_work += SDL_GetTicks() - work_start;
 		sdl_backgnd_jobs++;
 	}
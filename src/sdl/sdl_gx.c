@@ -0,0 +1,488 @@
+/*
+ * Part of Astonia Client (c) Daniel Brockhaus. Please read license.txt.
+ *
+ * SDL - Graphics Archives
+ *
+ * Maps gx1.zip and the high res gx2/gx3/gx4.zip, each with its _patch and
+ * _mod archive, read-only and indexes their central directories once at
+ * startup. The index holds one entry per sprite and resolution, mod over
+ * patch over base is settled while indexing. Any thread can then read a
+ * sprite straight from the mapping: stored entries without a copy,
+ * deflated ones through zlib into a buffer of their own.
+ *
+ * gx2/gx3/gx4_up.zip, written by bin/upscale, holds 1X sprites already
+ * scaled and smoothed. Each entry's comment is the CRC of the 1X file it
+ * was made from, entries that no longer match gx1 are ignored.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include <SDL3/SDL.h>
+
+#include "astonia.h"
+#include "sdl/sdl.h"
+#include "sdl/sdl_private.h"
+
+#define ZIP_LOCAL   0x04034b50
+#define ZIP_CENTRAL 0x02014b50
+#define ZIP_EOCD    0x06054b50
+#define ZIP64_LOC   0x07064b50
+#define ZIP64_EOCD  0x06064b50
+
+struct gx_archive {
+	const unsigned char *base; // NULL if the archive doesn't exist
+	size_t size;
+#ifdef _WIN32
+	HANDLE mapping;
+#endif
+};
+
+struct gx_entry {
+	uint64_t offset; // of the local header
+	uint32_t csize, usize;
+	uint32_t crc; // of the PNG file
+	uint32_t source; // upscaled entries: crc of the 1X file they were made from
+	uint16_t method; // 0 stored, 8 deflated
+	uint16_t archive;
+};
+
+// 1X archives first, then high res; base, patch, mod in each. The upscaled pack comes last.
+#define GX_ARCHIVES 7
+#define GX_LEVELS   3
+
+static struct gx_archive gx_archive[GX_ARCHIVES];
+
+// Per level (SDL_GX_BASE, _HIRES, _UPSCALED): sprite -> entry number + 1, 0 if missing
+static uint32_t *gx_index[GX_LEVELS];
+static struct gx_entry *gx_entry[GX_LEVELS];
+static uint32_t gx_used[GX_LEVELS], gx_size[GX_LEVELS];
+
+static inline uint16_t rd16(const unsigned char *p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t rd32(const unsigned char *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t rd64(const unsigned char *p)
+{
+	return (uint64_t)rd32(p) | ((uint64_t)rd32(p + 4) << 32);
+}
+
+static int gx_map(struct gx_archive *a, const char *path)
+{
+#ifdef _WIN32
+	HANDLE file;
+	LARGE_INTEGER len;
+
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return -1;
+	}
+	if (!GetFileSizeEx(file, &len) || len.QuadPart <= 0) {
+		CloseHandle(file);
+		return -1;
+	}
+	a->mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!a->mapping) {
+		return -1;
+	}
+	a->base = MapViewOfFile(a->mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!a->base) {
+		CloseHandle(a->mapping);
+		a->mapping = NULL;
+		return -1;
+	}
+	a->size = (size_t)len.QuadPart;
+#else
+	struct stat st;
+	void *base;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		return -1;
+	}
+	if (fstat(fd, &st) || st.st_size <= 0) {
+		close(fd);
+		return -1;
+	}
+	base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		return -1;
+	}
+	a->base = base;
+	a->size = (size_t)st.st_size;
+#endif
+
+	return 0;
+}
+
+static void gx_unmap(struct gx_archive *a)
+{
+	if (!a->base) {
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(a->base);
+	CloseHandle(a->mapping);
+	a->mapping = NULL;
+#else
+	munmap((void *)(uintptr_t)a->base, a->size);
+#endif
+	a->base = NULL;
+	a->size = 0;
+}
+
+// "00012345.png" -> 12345, -1 for anything else
+static int gx_sprite_name(const unsigned char *name, unsigned int len)
+{
+	int sprite = 0;
+
+	if (len != 12 || memcmp(name + 8, ".png", 4)) {
+		return -1;
+	}
+	for (int i = 0; i < 8; i++) {
+		if (name[i] < '0' || name[i] > '9') {
+			return -1;
+		}
+		sprite = sprite * 10 + (name[i] - '0');
+	}
+
+	return sprite;
+}
+
+// Entry comment of the upscaled pack: crc of the source as 8 hex digits
+static int gx_source_crc(const unsigned char *comment, unsigned int len, uint32_t *crc)
+{
+	uint32_t v = 0;
+
+	if (len != 8) {
+		return -1;
+	}
+	for (int i = 0; i < 8; i++) {
+		unsigned int c = comment[i];
+		if (c >= '0' && c <= '9') {
+			c -= '0';
+		} else if (c >= 'a' && c <= 'f') {
+			c -= 'a' - 10;
+		} else if (c >= 'A' && c <= 'F') {
+			c -= 'A' - 10;
+		} else {
+			return -1;
+		}
+		v = (v << 4) | c;
+	}
+	*crc = v;
+
+	return 0;
+}
+
+static void gx_add(int level, int sprite, const struct gx_entry *e)
+{
+	uint32_t n = gx_index[level][sprite];
+
+	if (n) { // already in an archive of lower priority
+		gx_entry[level][n - 1] = *e;
+		return;
+	}
+
+	if (gx_used[level] == gx_size[level]) {
+		gx_size[level] = gx_size[level] ? gx_size[level] * 2 : 4096;
+		gx_entry[level] = xrealloc(gx_entry[level], gx_size[level] * sizeof(struct gx_entry), MEM_SDL_BASE);
+	}
+	gx_entry[level][gx_used[level]++] = *e;
+	gx_index[level][sprite] = gx_used[level];
+}
+
+// Add all sprites of archive nr to the index of level, overriding earlier archives
+static int gx_index_archive(int level, int nr, const char *path)
+{
+	struct gx_archive *a = &gx_archive[nr];
+	const unsigned char *p, *end, *eocd = NULL;
+	uint64_t entries, cd_size, cd_off;
+	int cnt = 0;
+
+	if (a->size < 22) {
+		return fail("%s: not a zip archive", path);
+	}
+
+	// the end of central directory record is followed by at most 64K of comment
+	for (p = a->base + a->size - 22; p >= a->base && (size_t)(a->base + a->size - p) <= 22 + 65535; p--) {
+		if (rd32(p) == ZIP_EOCD) {
+			eocd = p;
+			break;
+		}
+	}
+	if (!eocd) {
+		return fail("%s: central directory not found", path);
+	}
+
+	entries = rd16(eocd + 10);
+	cd_size = rd32(eocd + 12);
+	cd_off = rd32(eocd + 16);
+
+	if ((entries == 0xffff || cd_size == 0xffffffff || cd_off == 0xffffffff) && eocd - a->base >= 20 &&
+	    rd32(eocd - 20) == ZIP64_LOC) {
+		uint64_t z = rd64(eocd - 20 + 8);
+		if (a->size < 56 || z > a->size - 56 || rd32(a->base + z) != ZIP64_EOCD) {
+			return fail("%s: bad zip64 end of central directory", path);
+		}
+		entries = rd64(a->base + z + 32);
+		cd_size = rd64(a->base + z + 40);
+		cd_off = rd64(a->base + z + 48);
+	}
+
+	if (cd_off > a->size || cd_size > a->size - cd_off) {
+		return fail("%s: central directory out of bounds", path);
+	}
+
+	p = a->base + cd_off;
+	end = p + cd_size;
+
+	for (uint64_t n = 0; n < entries; n++) {
+		struct gx_entry e;
+		uint64_t csize, usize, off;
+		unsigned int nlen, xlen, clen;
+		int sprite;
+
+		if (end - p < 46 || rd32(p) != ZIP_CENTRAL) {
+			return fail("%s: damaged central directory", path);
+		}
+		nlen = rd16(p + 28);
+		xlen = rd16(p + 30);
+		clen = rd16(p + 32);
+		if ((size_t)(end - p) < 46 + nlen + xlen + clen) {
+			return fail("%s: damaged central directory", path);
+		}
+
+		e.method = rd16(p + 10);
+		e.archive = (uint16_t)nr;
+		e.crc = rd32(p + 16);
+		e.source = 0;
+		csize = rd32(p + 20);
+		usize = rd32(p + 24);
+		off = rd32(p + 42);
+
+		// zip64 extra field holds the values that didn't fit, in this order
+		if (usize == 0xffffffff || csize == 0xffffffff || off == 0xffffffff) {
+			const unsigned char *x = p + 46 + nlen, *xend = x + xlen;
+			while (xend - x >= 4) {
+				unsigned int id = rd16(x), len = rd16(x + 2);
+				const unsigned char *v = x + 4;
+				if ((size_t)(xend - v) < len) {
+					break;
+				}
+				if (id == 0x0001) {
+					const unsigned char *vend = v + len;
+					if (usize == 0xffffffff && vend - v >= 8) {
+						usize = rd64(v);
+						v += 8;
+					}
+					if (csize == 0xffffffff && vend - v >= 8) {
+						csize = rd64(v);
+						v += 8;
+					}
+					if (off == 0xffffffff && vend - v >= 8) {
+						off = rd64(v);
+					}
+					break;
+				}
+				x = v + len;
+			}
+		}
+
+		sprite = gx_sprite_name(p + 46, nlen);
+		if (level == SDL_GX_UPSCALED && gx_source_crc(p + 46 + nlen + xlen, clen, &e.source)) {
+			sprite = -1;
+		}
+		p += 46 + nlen + xlen + clen;
+
+		if (sprite < 0 || sprite >= MAXSPRITE) {
+			continue;
+		}
+		// a stored entry is handed out as is, its sizes have to agree
+		if ((e.method != 0 && e.method != 8) || (e.method == 0 && csize != usize) || csize > UINT32_MAX ||
+		    usize > UINT32_MAX || off >= a->size) {
+			warn("%s: cannot read %08d.png (method %d)", path, sprite, e.method);
+			continue;
+		}
+		e.offset = off;
+		e.csize = (uint32_t)csize;
+		e.usize = (uint32_t)usize;
+		gx_add(level, sprite, &e);
+		cnt++;
+	}
+
+	note("%s: %d sprites", path, cnt);
+
+	return cnt;
+}
+
+/**
+ * Map and index the graphics archives. scale is sdl_scale, which picks the
+ * high res set gx2, gx3 or gx4.zip; 1 for none. Returns -1 if gx1.zip could
+ * not be used.
+ */
+int sdl_gx_open(int scale)
+{
+	static const char *suffix[GX_LEVELS][3] = {{"", "_patch", "_mod"}, {"", "_patch", "_mod"}, {"_up"}};
+	char path[64];
+	int ret = 0;
+
+	for (int level = 0; level < GX_LEVELS; level++) {
+		int set = level ? scale : 1;
+
+		if (set < 2 && level) {
+			break;
+		}
+
+		gx_index[level] = xmalloc(MAXSPRITE * sizeof(uint32_t), MEM_SDL_BASE);
+		memset(gx_index[level], 0, MAXSPRITE * sizeof(uint32_t));
+
+		for (int i = 0; i < 3 && suffix[level][i]; i++) {
+			int nr = level * 3 + i;
+
+			snprintf(path, sizeof(path), "res/gx%d%s.zip", set, suffix[level][i]);
+			if (gx_map(&gx_archive[nr], path)) {
+				if (nr == 0) {
+					warn("Could not open %s", path);
+					ret = -1;
+				}
+				continue;
+			}
+			if (gx_index_archive(level, nr, path) < 0) {
+				gx_unmap(&gx_archive[nr]);
+				if (nr == 0) {
+					ret = -1;
+				}
+			}
+		}
+	}
+
+	return ret;
+}
+
+// Without gx1.zip there is nothing to draw, tell the user where it should be
+void sdl_gx_missing(void)
+{
+	char *txt = "The client could not locate the graphics file gx1.zip. "
+	            "Please make sure you start the client from the main folder, "
+	            "not from within the bin-folder.\n\n"
+	            "You can create a shortcut with the working directory set to the main folder.";
+	display_messagebox("Graphics Not Found", txt);
+	exit(105);
+}
+
+void sdl_gx_close(void)
+{
+	for (int i = 0; i < GX_ARCHIVES; i++) {
+		gx_unmap(&gx_archive[i]);
+	}
+	for (int level = 0; level < GX_LEVELS; level++) {
+		xfree(gx_index[level]);
+		xfree(gx_entry[level]);
+		gx_index[level] = NULL;
+		gx_entry[level] = NULL;
+		gx_used[level] = gx_size[level] = 0;
+	}
+}
+
+/**
+ * Get the PNG file of a sprite from one of the SDL_GX_* levels. Upscaled
+ * sprites are only returned while they match the 1X sprite. Safe to call
+ * from any thread. Returns -1 if the sprite isn't in the archives. Call
+ * sdl_gx_release() when done with f.
+ */
+int sdl_gx_read(unsigned int sprite, int level, struct sdl_gx_file *f)
+{
+	const struct gx_entry *e;
+	const struct gx_archive *a;
+	const unsigned char *lh, *data;
+	uint32_t n, base;
+	z_stream zs;
+	int ret;
+
+	f->data = NULL;
+	f->buf = NULL;
+	f->size = 0;
+
+	if (level < 0 || level >= GX_LEVELS || sprite >= MAXSPRITE || !gx_index[level] ||
+	    !(n = gx_index[level][sprite])) {
+		return -1;
+	}
+	e = &gx_entry[level][n - 1];
+	a = &gx_archive[e->archive];
+
+	if (level == SDL_GX_UPSCALED) {
+		base = gx_index[SDL_GX_BASE] ? gx_index[SDL_GX_BASE][sprite] : 0;
+		if (!base || gx_entry[SDL_GX_BASE][base - 1].crc != e->source) {
+			return -1;
+		}
+	}
+
+	lh = a->base + e->offset;
+	if (a->size < 30 || e->offset > a->size - 30 || rd32(lh) != ZIP_LOCAL) {
+		warn("%08u.png: bad local header", sprite);
+		return -1;
+	}
+	data = lh + 30 + rd16(lh + 26) + rd16(lh + 28);
+	if (data > a->base + a->size || e->csize > (size_t)(a->base + a->size - data)) {
+		warn("%08u.png: data out of bounds", sprite);
+		return -1;
+	}
+
+	if (e->method == 0) {
+		f->data = data;
+		f->size = e->usize;
+		return 0;
+	}
+
+	f->buf = xmalloc(e->usize, MEM_TEMP);
+
+	memset(&zs, 0, sizeof(zs));
+	if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+		sdl_gx_release(f);
+		return -1;
+	}
+	zs.next_in = (Bytef *)(uintptr_t)data;
+	zs.avail_in = e->csize;
+	zs.next_out = f->buf;
+	zs.avail_out = e->usize;
+	ret = inflate(&zs, Z_FINISH);
+	inflateEnd(&zs);
+
+	if (ret != Z_STREAM_END || zs.total_out != e->usize) {
+		warn("%08u.png: inflate failed (%d)", sprite, ret);
+		sdl_gx_release(f);
+		return -1;
+	}
+
+	f->data = f->buf;
+	f->size = e->usize;
+
+	return 0;
+}
+
+void sdl_gx_release(struct sdl_gx_file *f)
+{
+	xfree(f->buf);
+	f->buf = NULL;
+	f->data = NULL;
+	f->size = 0;
+}
@@ -3,7 +3,7 @@
  *
  * SDL - Image Module
  *
- * PNG loading, image processing, smoothing, premultiplication, and the sdl_make function
+ * PNG loading, image processing, premultiplication, and the sdl_make function
  * that transforms sprite data into textures with applied effects.
  */
 
@@ -13,12 +13,13 @@
 #include <math.h>
 #include <SDL3/SDL.h>
 #include <png.h>
-#include <zip.h>
+#include <string.h>
 
 #include "dll.h"
 #include "astonia.h"
 #include "sdl/sdl.h"
 #include "sdl/sdl_private.h"
+#include "game/profile.h"
 
 // Module-local variables
 static int sdlm_sprite = 0;
@@ -38,171 +39,50 @@ static void png_free_fn(png_structp png_ptr __attribute__((unused)), png_voidp p
 	}
 }
 
-uint32_t mix_argb(uint32_t c1, uint32_t c2, float w1, float w2)
-{
-	int r1, r2, g1, g2, b1, b2, a1, a2;
-	uint32_t r, g, b, a;
-
-	a1 = IGET_A(c1);
-	a2 = IGET_A(c2);
-	if (!a1 && !a2) {
-		return 0; // save some work
-	}
-
-	r1 = IGET_R(c1);
-	g1 = IGET_G(c1);
-	b1 = IGET_B(c1);
-
-	r2 = IGET_R(c2);
-	g2 = IGET_G(c2);
-	b2 = IGET_B(c2);
-
-	a = (uint32_t)((float)a1 * w1 + (float)a2 * w2);
-	r = (uint32_t)((float)r1 * w1 + (float)r2 * w2);
-	g = (uint32_t)((float)g1 * w1 + (float)g2 * w2);
-	b = (uint32_t)((float)b1 * w1 + (float)b2 * w2);
+// (r * unmul[a]) >> 16 == min(255, r * 255 / a) for all r and a, checked exhaustively
+#define UNMUL(a)    ((a) ? (255u * 65536u + (a) - 1u) / ((a) ? (a) : 1u) : 0u)
+#define UNMUL4(a)   UNMUL(a), UNMUL(a + 1u), UNMUL(a + 2u), UNMUL(a + 3u)
+#define UNMUL16(a)  UNMUL4(a), UNMUL4(a + 4u), UNMUL4(a + 8u), UNMUL4(a + 12u)
+#define UNMUL64(a)  UNMUL16(a), UNMUL16(a + 16u), UNMUL16(a + 32u), UNMUL16(a + 48u)
+#define UNMUL256(a) UNMUL64(a), UNMUL64(a + 64u), UNMUL64(a + 128u), UNMUL64(a + 192u)
 
-	if (a > 255U) {
-		a = 255U;
-	}
-	if (r > 255U) {
-		r = 255U;
-	}
-	if (g > 255U) {
-		g = 255U;
-	}
-	if (b > 255U) {
-		b = 255U;
-	}
+static const uint32_t unmul[256] = {UNMUL256(0u)};
 
-	return IRGBA(r, g, b, a);
-}
-
-void sdl_smoothify(uint32_t *pixel, int xres, int yres, int scale __attribute__((unused)))
+static inline uint32_t unmul_c(uint32_t c, uint32_t a)
 {
-	int x, y;
-	uint32_t c1, c2, c3, c4;
-
-	switch (scale) {
-	case 2:
-		for (x = 0; x < xres - 2; x += 2) {
-			for (y = 0; y < yres - 2; y += 2) {
-				c1 = pixel[x + y * xres]; // top left
-				c2 = pixel[x + y * xres + 2]; // top right
-				c3 = pixel[x + y * xres + xres * 2]; // bottom left
-				c4 = pixel[x + y * xres + 2 + xres * 2]; // bottom right
-
-				pixel[x + y * xres + 1] = mix_argb(c1, c2, 0.5f, 0.5f);
-				pixel[x + y * xres + xres] = mix_argb(c1, c3, 0.5f, 0.5f);
-				pixel[x + y * xres + 1 + xres] =
-				    mix_argb(mix_argb(c1, c2, 0.5f, 0.5f), mix_argb(c3, c4, 0.5f, 0.5f), 0.5f, 0.5f);
-			}
-		}
-		break;
-	case 3:
-		for (x = 0; x < xres - 3; x += 3) {
-			for (y = 0; y < yres - 3; y += 3) {
-				c1 = pixel[x + y * xres]; // top left
-				c2 = pixel[x + y * xres + 3]; // top right
-				c3 = pixel[x + y * xres + xres * 3]; // bottom left
-				c4 = pixel[x + y * xres + 3 + xres * 3]; // bottom right
-
-				pixel[x + y * xres + 1] = mix_argb(c1, c2, 0.667f, 0.333f);
-				pixel[x + y * xres + 2] = mix_argb(c1, c2, 0.333f, 0.667f);
-
-				pixel[x + y * xres + xres * 1] = mix_argb(c1, c3, 0.667f, 0.333f);
-				pixel[x + y * xres + xres * 2] = mix_argb(c1, c3, 0.333f, 0.667f);
-
-				pixel[x + y * xres + 1 + xres * 1] =
-				    mix_argb(mix_argb(c1, c2, 0.5f, 0.5f), mix_argb(c3, c4, 0.5f, 0.5f), 0.5f, 0.5f);
-				pixel[x + y * xres + 2 + xres * 1] =
-				    mix_argb(mix_argb(c1, c2, 0.333f, 0.667f), mix_argb(c3, c4, 0.333f, 0.667f), 0.667f, 0.333f);
-				pixel[x + y * xres + 1 + xres * 2] =
-				    mix_argb(mix_argb(c1, c2, 0.667f, 0.333f), mix_argb(c3, c4, 0.667f, 0.333f), 0.333f, 0.667f);
-				pixel[x + y * xres + 2 + xres * 2] =
-				    mix_argb(mix_argb(c1, c2, 0.333f, 0.667f), mix_argb(c3, c4, 0.333f, 0.667f), 0.333f, 0.667f);
-			}
-		}
-		break;
-
-	case 4:
-		for (x = 0; x < xres - 4; x += 4) {
-			for (y = 0; y < yres - 4; y += 4) {
-				c1 = pixel[x + y * xres]; // top left
-				c2 = pixel[x + y * xres + 4]; // top right
-				c3 = pixel[x + y * xres + xres * 4]; // bottom left
-				c4 = pixel[x + y * xres + 4 + xres * 4]; // bottom right
-
-				pixel[x + y * xres + 1] = mix_argb(c1, c2, 0.75f, 0.25f);
-				pixel[x + y * xres + 2] = mix_argb(c1, c2, 0.5f, 0.5f);
-				pixel[x + y * xres + 3] = mix_argb(c1, c2, 0.25f, 0.75f);
-
-				pixel[x + y * xres + xres * 1] = mix_argb(c1, c3, 0.75f, 0.25f);
-				pixel[x + y * xres + xres * 2] = mix_argb(c1, c3, 0.5f, 0.5f);
-				pixel[x + y * xres + xres * 3] = mix_argb(c1, c3, 0.25f, 0.75f);
-
-				pixel[x + y * xres + 1 + xres * 1] =
-				    mix_argb(mix_argb(c1, c2, 0.75f, 0.25f), mix_argb(c3, c4, 0.75f, 0.25f), 0.75f, 0.25f);
-				pixel[x + y * xres + 1 + xres * 2] =
-				    mix_argb(mix_argb(c1, c2, 0.75f, 0.25f), mix_argb(c3, c4, 0.75f, 0.25f), 0.5f, 0.5f);
-				pixel[x + y * xres + 1 + xres * 3] =
-				    mix_argb(mix_argb(c1, c2, 0.75f, 0.75f), mix_argb(c3, c4, 0.75f, 0.25f), 0.25f, 0.75f);
-
-				pixel[x + y * xres + 2 + xres * 1] =
-				    mix_argb(mix_argb(c1, c2, 0.5f, 0.5f), mix_argb(c3, c4, 0.5f, 0.5f), 0.75f, 0.25f);
-				pixel[x + y * xres + 2 + xres * 2] =
-				    mix_argb(mix_argb(c1, c2, 0.5f, 0.5f), mix_argb(c3, c4, 0.5f, 0.5f), 0.5f, 0.5f);
-				pixel[x + y * xres + 2 + xres * 3] =
-				    mix_argb(mix_argb(c1, c2, 0.5f, 0.5f), mix_argb(c3, c4, 0.5f, 0.5f), 0.25f, 0.75f);
-
-				pixel[x + y * xres + 3 + xres * 1] =
-				    mix_argb(mix_argb(c1, c2, 0.25f, 0.75f), mix_argb(c3, c4, 0.25f, 0.75f), 0.75f, 0.25f);
-				pixel[x + y * xres + 3 + xres * 2] =
-				    mix_argb(mix_argb(c1, c2, 0.25f, 0.75f), mix_argb(c3, c4, 0.25f, 0.75f), 0.5f, 0.5f);
-				pixel[x + y * xres + 3 + xres * 3] =
-				    mix_argb(mix_argb(c1, c2, 0.25f, 0.75f), mix_argb(c3, c4, 0.25f, 0.75f), 0.25f, 0.75f);
-			}
-		}
-		break;
-	default:
-		warn("Unsupported scale %d in sdl_load_image_png()", sdl_scale);
-		break;
-	}
+	return min(255u, (c * unmul[a]) >> 16);
 }
 
 void sdl_premulti(uint32_t *pixel, int xres, int yres, int scale __attribute__((unused)))
 {
-	int n, r, g, b, a;
-	uint32_t c;
+	int n;
+	uint32_t c, a;
 
 	for (n = 0; n < xres * yres; n++) {
 		c = pixel[n];
 
 		a = IGET_A(c);
-		if (!a) {
+		if (!a || a == 255) {
 			continue;
 		}
 
-		r = IGET_R(c);
-		g = IGET_G(c);
-		b = IGET_B(c);
-
-		r = min(255, r * 255 / a);
-		g = min(255, g * 255 / a);
-		b = min(255, b * 255 / a);
-
-		c = IRGBA(r, g, b, a);
+		c = IRGBA(unmul_c(IGET_R(c), a), unmul_c(IGET_G(c), a), unmul_c(IGET_B(c), a), a);
 		pixel[n] = c;
 	}
 }
 
 struct png_helper {
 	char *filename;
-	zip_t *zip;
-	unsigned char **row;
+	const struct sdl_gx_file *gx; // read from here, or from filename if NULL
+	size_t pos;
+	int unmul; // apply the alpha division while decoding
+
+	// result of png_load_helper()
+	uint32_t *pixel; // xres * yres, magenta and alpha 0 are transparent black
 	int xres;
 	int yres;
-	int bpp;
+	int sx, sy, ex, ey; // bounding box of the visible pixels, sx > ex if there are none
+	int has_offs, xoff, yoff; // oFFs chunk, written by bin/upscale
 
 	png_structp png_ptr;
 	png_infop info_ptr;
@@ -210,21 +90,77 @@ struct png_helper {
 
 void png_helper_read(png_structp ps, png_bytep buf, png_size_t len)
 {
-	zip_fread(png_get_io_ptr(ps), buf, len);
+	struct png_helper *p = png_get_io_ptr(ps);
+
+	if (len > p->gx->size - p->pos) {
+		png_error(ps, "read past end of file");
+	}
+	memcpy(buf, p->gx->data + p->pos, len);
+	p->pos += len;
+}
+
+// Colour key, alpha division and bounding box for one decoded row, in one pass
+static void png_convert_row(struct png_helper *p, const unsigned char *src, int bpp, int y)
+{
+	uint32_t *dst = p->pixel + (size_t)y * (size_t)p->xres;
+	uint32_t r, g, b, a;
+	int x, first = -1, last = -1;
+
+	for (x = 0; x < p->xres; x++, src += bpp) {
+		r = src[0];
+		g = src[1];
+		b = src[2];
+		a = bpp == 4 ? src[3] : 255;
+
+		if (!a || (r == 255 && g == 0 && b == 255)) {
+			dst[x] = 0;
+			continue;
+		}
+		if (p->unmul && a != 255) {
+			r = unmul_c(r, a);
+			g = unmul_c(g, a);
+			b = unmul_c(b, a);
+		}
+		dst[x] = IRGBA(r, g, b, a);
+
+		if (first < 0) {
+			first = x;
+		}
+		last = x;
+	}
+
+	if (first < 0) {
+		return;
+	}
+	if (first < p->sx) {
+		p->sx = first;
+	}
+	if (last > p->ex) {
+		p->ex = last;
+	}
+	if (y < p->sy) {
+		p->sy = y;
+	}
+	p->ey = y;
 }
 
+/*
+ * Decode a PNG into p->pixel. Rows are converted as libpng delivers them,
+ * only interlaced files are decoded completely first.
+ */
 int png_load_helper(struct png_helper *p)
 {
 	FILE *fp = NULL;
-	zip_file_t *zp = NULL;
-	int tmp;
+	unsigned char *volatile rows = NULL; // freed after a longjmp
+	size_t rowbytes;
+	int passes, bpp, y;
 
-	if (p->zip) {
-		zp = zip_fopen(p->zip, p->filename, 0);
-		if (!zp) {
-			return -1;
-		}
-	} else {
+	p->pos = 0;
+	p->pixel = NULL;
+	p->png_ptr = NULL;
+	p->info_ptr = NULL;
+
+	if (!p->gx) {
 		fp = fopen(p->filename, "rb");
 		if (!fp) {
 			return -1;
@@ -233,9 +169,6 @@ int png_load_helper(struct png_helper *p)
 
 	p->png_ptr = png_create_read_struct_2(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL, NULL, png_malloc_fn, png_free_fn);
 	if (!p->png_ptr) {
-		if (zp) {
-			zip_fclose(zp);
-		}
 		if (fp) {
 			fclose(fp);
 		}
@@ -245,9 +178,6 @@ int png_load_helper(struct png_helper *p)
 
 	p->info_ptr = png_create_info_struct(p->png_ptr);
 	if (!p->info_ptr) {
-		if (zp) {
-			zip_fclose(zp);
-		}
 		if (fp) {
 			fclose(fp);
 		}
@@ -256,74 +186,82 @@ int png_load_helper(struct png_helper *p)
 		return -1;
 	}
 
-	if (p->zip) {
-		png_set_read_fn(p->png_ptr, zp, png_helper_read);
-	} else {
-		png_init_io(p->png_ptr, fp);
-	}
-	png_set_strip_16(p->png_ptr);
-	png_read_png(p->png_ptr, p->info_ptr, PNG_TRANSFORM_PACKING, NULL);
-
-	p->row = png_get_rows(p->png_ptr, p->info_ptr);
-	if (!p->row) {
-		if (zp) {
-			zip_fclose(zp);
-		}
+	if (setjmp(png_jmpbuf(p->png_ptr))) {
+		warn("%s: damaged PNG", p->filename);
+		sdl_pixel_free(rows);
+		png_load_helper_exit(p);
 		if (fp) {
 			fclose(fp);
 		}
-		png_destroy_read_struct(&p->png_ptr, &p->info_ptr, (png_infopp)NULL);
-		warn("read row\n");
 		return -1;
 	}
 
+	if (p->gx) {
+		png_set_read_fn(p->png_ptr, p, png_helper_read);
+	} else {
+		png_init_io(p->png_ptr, fp);
+	}
+
+	png_read_info(p->png_ptr, p->info_ptr);
+
+	png_int_32 xoff, yoff;
+	int unit;
+	p->has_offs = png_get_oFFs(p->png_ptr, p->info_ptr, &xoff, &yoff, &unit) && unit == PNG_OFFSET_PIXEL;
+	p->xoff = p->has_offs ? xoff : 0;
+	p->yoff = p->has_offs ? yoff : 0;
+	png_set_strip_16(p->png_ptr);
+	png_set_packing(p->png_ptr);
+	passes = png_set_interlace_handling(p->png_ptr);
+	png_read_update_info(p->png_ptr, p->info_ptr);
+
 	p->xres = (int)png_get_image_width(p->png_ptr, p->info_ptr);
 	p->yres = (int)png_get_image_height(p->png_ptr, p->info_ptr);
+	rowbytes = png_get_rowbytes(p->png_ptr, p->info_ptr);
 
-	tmp = (int)png_get_rowbytes(p->png_ptr, p->info_ptr);
-
-	if (tmp == p->xres * 3) {
-		p->bpp = 24;
-	} else if (tmp == p->xres * 4) {
-		p->bpp = 32;
+	if (rowbytes == (size_t)p->xres * 3) {
+		bpp = 3;
+	} else if (rowbytes == (size_t)p->xres * 4) {
+		bpp = 4;
 	} else {
-		if (zp) {
-			zip_fclose(zp);
-		}
-		if (fp) {
-			fclose(fp);
-		}
-		png_destroy_read_struct(&p->png_ptr, &p->info_ptr, (png_infopp)NULL);
-		warn("rowbytes!=xres*4 (%d, %d, %s)", tmp, p->xres, p->filename);
-		return -1;
+		warn("rowbytes!=xres*4 (%d, %d, %s)", (int)rowbytes, p->xres, p->filename);
+		png_longjmp(p->png_ptr, 1);
 	}
-
 	if (png_get_bit_depth(p->png_ptr, p->info_ptr) != 8) {
-		if (zp) {
-			zip_fclose(zp);
-		}
-		if (fp) {
-			fclose(fp);
-		}
-		png_destroy_read_struct(&p->png_ptr, &p->info_ptr, (png_infopp)NULL);
 		warn("bit depth!=8\n");
-		return -1;
+		png_longjmp(p->png_ptr, 1);
 	}
-	if (png_get_channels(p->png_ptr, p->info_ptr) != p->bpp / 8) {
-		if (zp) {
-			zip_fclose(zp);
-		}
-		if (fp) {
-			fclose(fp);
-		}
-		png_destroy_read_struct(&p->png_ptr, &p->info_ptr, (png_infopp)NULL);
+	if (png_get_channels(p->png_ptr, p->info_ptr) != bpp) {
 		warn("channels!=format\n");
-		return -1;
+		png_longjmp(p->png_ptr, 1);
 	}
 
-	if (p->zip) {
-		zip_fclose(zp);
+	p->pixel = xmalloc((size_t)p->xres * (size_t)p->yres * sizeof(uint32_t), MEM_TEMP);
+	p->sx = p->xres;
+	p->sy = p->yres;
+	p->ex = 0;
+	p->ey = 0;
+
+	if (passes > 1) {
+		rows = sdl_pixel_alloc(rowbytes * (size_t)p->yres);
+		for (int pass = 0; pass < passes; pass++) {
+			for (y = 0; y < p->yres; y++) {
+				png_read_row(p->png_ptr, rows + rowbytes * (size_t)y, NULL);
+			}
+		}
+		for (y = 0; y < p->yres; y++) {
+			png_convert_row(p, rows + rowbytes * (size_t)y, bpp, y);
+		}
 	} else {
+		rows = sdl_pixel_alloc(rowbytes);
+		for (y = 0; y < p->yres; y++) {
+			png_read_row(p->png_ptr, rows, NULL);
+			png_convert_row(p, rows, bpp, y);
+		}
+	}
+	sdl_pixel_free(rows);
+	rows = NULL;
+
+	if (fp) {
 		fclose(fp);
 	}
 
@@ -333,50 +271,26 @@ int png_load_helper(struct png_helper *p)
 void png_load_helper_exit(struct png_helper *p)
 {
 	png_destroy_read_struct(&p->png_ptr, &p->info_ptr, (png_infopp)NULL);
+	xfree(p->pixel);
+	p->pixel = NULL;
 }
 
 // Load high res PNG
-int sdl_load_image_png_(struct sdl_image *si, char *filename, zip_t *zip)
+int sdl_load_image_png_(struct sdl_image *si, char *filename, const struct sdl_gx_file *f)
 {
-	int x, y, r, g, b, a, sx, sy, ex, ey;
-	uint32_t c;
+	int y, sx, sy, ex, ey, w;
 	struct png_helper p;
 
-	p.zip = zip;
+	p.gx = f;
 	p.filename = filename;
+	p.unmul = 1;
 	if (png_load_helper(&p)) {
 		return -1;
 	}
-
-	// prescan
-	sx = p.xres;
-	sy = p.yres;
-	ex = 0;
-	ey = 0;
-
-	for (y = 0; y < p.yres; y++) {
-		for (x = 0; x < p.xres; x++) {
-			if (p.bpp == 32 && (p.row[y][x * 4 + 3] == 0 || (p.row[y][x * 4 + 0] == 255 && p.row[y][x * 4 + 1] == 0 &&
-			                                                    p.row[y][x * 4 + 2] == 255))) {
-				continue;
-			}
-			if (p.bpp == 24 && (p.row[y][x * 3 + 0] == 255 && p.row[y][x * 3 + 1] == 0 && p.row[y][x * 3 + 2] == 255)) {
-				continue;
-			}
-			if (x < sx) {
-				sx = x;
-			}
-			if (x > ex) {
-				ex = x;
-			}
-			if (y < sy) {
-				sy = y;
-			}
-			if (y > ey) {
-				ey = y;
-			}
-		}
-	}
+	sx = p.sx;
+	sy = p.sy;
+	ex = p.ex;
+	ey = p.ey;
 
 	// Make sure the new found borders of the image are on multiples
 	// of sd_scale. And never shrink the visible portion to do that.
@@ -407,47 +321,15 @@ int sdl_load_image_png_(struct sdl_image *si, char *filename, zip_t *zip)
 	extern long long mem_png;
 	__atomic_add_fetch(&mem_png, (long long)((size_t)si->xres * si->yres * sizeof(uint32_t)), __ATOMIC_RELAXED);
 
+	// rounding to sdl_scale may reach past the right and bottom edge, that part stays transparent
+	w = min(si->xres, p.xres - sx);
 	for (y = 0; y < si->yres; y++) {
-		for (x = 0; x < si->xres; x++) {
-			if (p.bpp == 32) {
-				if (sx + x >= p.xres || sy + y >= p.yres) {
-					r = g = b = a = 0;
-				} else {
-					r = p.row[(sy + y)][(sx + x) * 4 + 0];
-					g = p.row[(sy + y)][(sx + x) * 4 + 1];
-					b = p.row[(sy + y)][(sx + x) * 4 + 2];
-					a = p.row[(sy + y)][(sx + x) * 4 + 3];
-				}
-			} else {
-				if (sx + x >= p.xres || sy + y >= p.yres) {
-					r = g = b = a = 0;
-				} else {
-					r = p.row[(sy + y)][(sx + x) * 3 + 0];
-					g = p.row[(sy + y)][(sx + x) * 3 + 1];
-					b = p.row[(sy + y)][(sx + x) * 3 + 2];
-					if (r == 255 && g == 0 && b == 255) {
-						a = 0;
-					} else {
-						a = 255;
-					}
-				}
-			}
-
-			if (r == 255 && g == 0 && b == 255) {
-				a = 0;
-			}
-
-			if (a) { // pre-multiply rgb channel by alpha
-				r = min(255, r * 255 / a);
-				g = min(255, g * 255 / a);
-				b = min(255, b * 255 / a);
-			} else {
-				r = g = b = 0;
-			}
-
-			c = IRGBA(r, g, b, a);
-
-			si->pixel[x + y * si->xres] = c;
+		uint32_t *dst = si->pixel + (size_t)y * si->xres;
+		if (sy + y < p.yres && w > 0) {
+			memcpy(dst, p.pixel + (size_t)(sy + y) * (size_t)p.xres + sx, (size_t)w * sizeof(uint32_t));
+			memset(dst + w, 0, (size_t)(si->xres - w) * sizeof(uint32_t));
+		} else {
+			memset(dst, 0, (size_t)si->xres * sizeof(uint32_t));
 		}
 	}
 
@@ -464,47 +346,22 @@ int sdl_load_image_png_(struct sdl_image *si, char *filename, zip_t *zip)
 // Load and up-scale low res PNG
 // TODO: add support for using a 2X image as a base for 4X
 // and possibly the other way around too
-int sdl_load_image_png(struct sdl_image *si, char *filename, zip_t *zip, int smoothify)
+int sdl_load_image_png(struct sdl_image *si, char *filename, const struct sdl_gx_file *f, int smoothify)
 {
-	int x, y, r, g, b, a, sx, sy, ex, ey;
+	int x, y, sx, sy, ex, ey, i, j, w, scale = sdl_scale;
 	uint32_t c;
 	struct png_helper p;
 
-	p.zip = zip;
+	p.gx = f;
 	p.filename = filename;
+	p.unmul = 0; // pre-multiply has to happen after scaling
 	if (png_load_helper(&p)) {
 		return -1;
 	}
-
-	// prescan
-	sx = p.xres;
-	sy = p.yres;
-	ex = 0;
-	ey = 0;
-
-	for (y = 0; y < p.yres; y++) {
-		for (x = 0; x < p.xres; x++) {
-			if (p.bpp == 32 && (p.row[y][x * 4 + 3] == 0 || (p.row[y][x * 4 + 0] == 255 && p.row[y][x * 4 + 1] == 0 &&
-			                                                    p.row[y][x * 4 + 2] == 255))) {
-				continue;
-			}
-			if (p.bpp == 24 && (p.row[y][x * 3 + 0] == 255 && p.row[y][x * 3 + 1] == 0 && p.row[y][x * 3 + 2] == 255)) {
-				continue;
-			}
-			if (x < sx) {
-				sx = x;
-			}
-			if (x > ex) {
-				ex = x;
-			}
-			if (y < sy) {
-				sy = y;
-			}
-			if (y > ey) {
-				ey = y;
-			}
-		}
-	}
+	sx = p.sx;
+	sy = p.sy;
+	ex = p.ex;
+	ey = p.ey;
 
 	if (ex < sx) {
 		ex = sx - 1;
@@ -531,83 +388,25 @@ int sdl_load_image_png(struct sdl_image *si, char *filename, zip_t *zip, int smo
 	    (long long)((size_t)si->xres * (size_t)si->yres * sizeof(uint32_t) * (size_t)sdl_scale * (size_t)sdl_scale),
 	    __ATOMIC_RELAXED);
 
+	// each source pixel becomes a scale x scale block
+	w = si->xres * scale;
 	for (y = 0; y < si->yres; y++) {
-		for (x = 0; x < si->xres; x++) {
-			if (p.bpp == 32) {
-				r = p.row[(sy + y)][(sx + x) * 4 + 0];
-				g = p.row[(sy + y)][(sx + x) * 4 + 1];
-				b = p.row[(sy + y)][(sx + x) * 4 + 2];
-				a = p.row[(sy + y)][(sx + x) * 4 + 3];
-			} else {
-				r = p.row[(sy + y)][(sx + x) * 3 + 0];
-				g = p.row[(sy + y)][(sx + x) * 3 + 1];
-				b = p.row[(sy + y)][(sx + x) * 3 + 2];
-				if (r == 255 && g == 0 && b == 255) {
-					a = 0;
-				} else {
-					a = 255;
-				}
-			}
-
-			if (r == 255 && g == 0 && b == 255) {
-				a = 0;
-			}
+		const uint32_t *src = p.pixel + (size_t)(sy + y) * (size_t)p.xres + sx;
+		uint32_t *dst = si->pixel + (size_t)y * (size_t)w * (size_t)scale;
 
-			if (!a) { // don't pre-multiply rgb channel by alpha because that needs to happen after scaling
-				r = g = b = 0;
-			}
-
-			c = IRGBA(r, g, b, a);
-
-			switch (sdl_scale) {
-			case 1:
-				si->pixel[x + y * si->xres] = c;
-				break;
-			case 2:
-				si->pixel[x * 2 + y * si->xres * 4] = c;
-				si->pixel[x * 2 + y * si->xres * 4 + 1] = c;
-				si->pixel[x * 2 + y * si->xres * 4 + si->xres * 2] = c;
-				si->pixel[x * 2 + y * si->xres * 4 + 1 + si->xres * 2] = c;
-				break;
-			case 3:
-				si->pixel[x * 3 + y * si->xres * 9 + 0] = c;
-				si->pixel[x * 3 + y * si->xres * 9 + 0 + si->xres * 3] = c;
-				si->pixel[x * 3 + y * si->xres * 9 + 0 + si->xres * 6] = c;
-
-				si->pixel[x * 3 + y * si->xres * 9 + 1] = c;
-				si->pixel[x * 3 + y * si->xres * 9 + 1 + si->xres * 3] = c;
-				si->pixel[x * 3 + y * si->xres * 9 + 1 + si->xres * 6] = c;
-
-				si->pixel[x * 3 + y * si->xres * 9 + 2] = c;
-				si->pixel[x * 3 + y * si->xres * 9 + 2 + si->xres * 3] = c;
-				si->pixel[x * 3 + y * si->xres * 9 + 2 + si->xres * 6] = c;
-				break;
-			case 4:
-				si->pixel[x * 4 + y * si->xres * 16 + 0] = c;
-				si->pixel[x * 4 + y * si->xres * 16 + 0 + si->xres * 4] = c;
-				si->pixel[x * 4 + y * si->xres * 16 + 0 + si->xres * 8] = c;
-				si->pixel[x * 4 + y * si->xres * 16 + 0 + si->xres * 12] = c;
-
-				si->pixel[x * 4 + y * si->xres * 16 + 1] = c;
-				si->pixel[x * 4 + y * si->xres * 16 + 1 + si->xres * 4] = c;
-				si->pixel[x * 4 + y * si->xres * 16 + 1 + si->xres * 8] = c;
-				si->pixel[x * 4 + y * si->xres * 16 + 1 + si->xres * 12] = c;
-
-				si->pixel[x * 4 + y * si->xres * 16 + 2] = c;
-				si->pixel[x * 4 + y * si->xres * 16 + 2 + si->xres * 4] = c;
-				si->pixel[x * 4 + y * si->xres * 16 + 2 + si->xres * 8] = c;
-				si->pixel[x * 4 + y * si->xres * 16 + 2 + si->xres * 12] = c;
-
-				si->pixel[x * 4 + y * si->xres * 16 + 3] = c;
-				si->pixel[x * 4 + y * si->xres * 16 + 3 + si->xres * 4] = c;
-				si->pixel[x * 4 + y * si->xres * 16 + 3 + si->xres * 8] = c;
-				si->pixel[x * 4 + y * si->xres * 16 + 3 + si->xres * 12] = c;
-				break;
-			default:
-				warn("Unsupported scale %d in sdl_load_image_png()", sdl_scale);
-				break;
+		if (scale == 1) {
+			memcpy(dst, src, (size_t)w * sizeof(uint32_t));
+			continue;
+		}
+		for (x = 0; x < si->xres; x++) {
+			c = src[x];
+			for (i = 0; i < scale; i++) {
+				dst[x * scale + i] = c;
 			}
 		}
+		for (j = 1; j < scale; j++) {
+			memcpy(dst + (size_t)j * (size_t)w, dst, (size_t)w * sizeof(uint32_t));
+		}
 	}
 
 	if (sdl_scale > 1 && smoothify) {
@@ -622,88 +421,73 @@ int sdl_load_image_png(struct sdl_image *si, char *filename, zip_t *zip, int smo
 	return 0;
 }
 
-int do_smoothify(int sprite)
+// Load 1X art that bin/upscale already scaled and smoothed. The file holds
+// exactly the pixels sdl_load_image_png() would have produced, the offset
+// comes from its oFFs chunk.
+int sdl_load_image_png_up(struct sdl_image *si, char *filename, const struct sdl_gx_file *f)
 {
-	// TODO: add more to this list
-	if (sprite >= 50 && sprite <= 56) {
-		return 0;
-	}
-	if (sprite > 0 && sprite <= 1000) {
-		return 1; // GUI
-	}
-	if (sprite >= 10000 && sprite < 11000) {
-		return 1; // items
-	}
-	if (sprite >= 11000 && sprite < 12000) {
-		return 1; // coffin, berries, farn, ...
-	}
-	if (sprite >= 13000 && sprite < 14000) {
-		return 1; // bones and towers, ...
-	}
-	if (sprite >= 16000 && sprite < 17000) {
-		return 1; // cameron doors, carts, ...
-	}
-	if (sprite >= 20025 && sprite < 20034) {
-		return 1; // torches
-	}
-	if (sprite >= 20042 && sprite < 20082) {
-		return 1; // torches
+	struct png_helper p;
+	size_t size;
+
+	p.gx = f;
+	p.filename = filename;
+	p.unmul = 1;
+	if (png_load_helper(&p)) {
+		return -1;
 	}
-	if (sprite >= 20086 && sprite < 20119) {
-		return 1; // chests, chairs
+	if (!p.has_offs || p.xres % sdl_scale || p.yres % sdl_scale) {
+		warn("%s: not an upscaled sprite for scale %d", filename, sdl_scale);
+		png_load_helper_exit(&p);
+		return -1;
 	}
 
-	if (sprite >= 100000) {
-		return 1; // all character sprites
-	}
+	si->flags = 1;
+	si->xres = (uint16_t)(p.xres / sdl_scale);
+	si->yres = (uint16_t)(p.yres / sdl_scale);
+	si->xoff = (int16_t)p.xoff;
+	si->yoff = (int16_t)p.yoff;
+
+	size = (size_t)p.xres * (size_t)p.yres * sizeof(uint32_t);
+#ifdef SDL_FAST_MALLOC
+	si->pixel = MALLOC(size);
+#else
+	si->pixel = xmalloc(size, MEM_SDL_PNG);
+#endif
+	extern long long mem_png;
+	__atomic_add_fetch(&mem_png, (long long)size, __ATOMIC_RELAXED);
+
+	memcpy(si->pixel, p.pixel, size);
+
+	png_load_helper_exit(&p);
 
 	return 0;
 }
 
-int sdl_load_image(struct sdl_image *si, int sprite, struct zip_handles *zips)
+int sdl_load_image(struct sdl_image *si, int sprite)
 {
 	char filename[1024];
-	zip_t *zip1, *zip1p, *zip1m, *zip2, *zip2p, *zip2m;
-
-	if (zips) {
-		zip1 = zips->zip1;
-		zip1p = zips->zip1p;
-		zip1m = zips->zip1m;
-		zip2 = zips->zip2;
-		zip2p = zips->zip2p;
-		zip2m = zips->zip2m;
-	} else {
-		extern zip_t *sdl_zip1, *sdl_zip2, *sdl_zip1p, *sdl_zip2p, *sdl_zip1m, *sdl_zip2m;
-		zip1 = sdl_zip1;
-		zip1p = sdl_zip1p;
-		zip1m = sdl_zip1m;
-		zip2 = sdl_zip2;
-		zip2p = sdl_zip2p;
-		zip2m = sdl_zip2m;
-	}
+	struct sdl_gx_file f;
+	int ret;
 
 	if (sprite >= MAXSPRITE || sprite < 0) {
 		note("sdl_load_image: illegal sprite %d wanted", sprite);
 		return -1;
 	}
 
+	sprintf(filename, "%08d.png", sprite);
+
 #if 0
 	// get patch png
 	sprintf(filename,"../gfxp/x%d/%08d/%08d.png",sdl_scale,(sprite/1000)*1000,sprite);
 	if (sdl_load_image_png_(si,filename,NULL)==0) return 0;
 #endif
 
-	// get high res from archive
-	if (zip2 || zip2p || zip2m) {
-		sprintf(filename, "%08d.png", sprite);
-		if (zip2m && sdl_load_image_png_(si, filename, zip2m) == 0) {
-			return 0; // check mod archive first
-		}
-		if (zip2p && sdl_load_image_png_(si, filename, zip2p) == 0) {
-			return 0; // check patch archive second
-		}
-		if (zip2 && sdl_load_image_png_(si, filename, zip2) == 0) {
-			return 0; // check base archive third
+	// get high res from archive, the index already prefers mod over patch over base
+	if (sdl_gx_read((unsigned int)sprite, SDL_GX_HIRES, &f) == 0) {
+		ret = sdl_load_image_png_(si, filename, &f);
+		sdl_gx_release(&f);
+		if (ret == 0) {
+			return 0;
 		}
 	}
 
@@ -713,16 +497,20 @@ int sdl_load_image(struct sdl_image *si, int sprite, struct zip_handles *zips)
 	if (sdl_load_image_png_(si,filename,NULL)==0) return 0;
 #endif
 
-	// get standard from archive
-	if (zip1 || zip1p || zip1m) {
-		sprintf(filename, "%08d.png", sprite);
-		if (zip1m && sdl_load_image_png(si, filename, zip1m, do_smoothify(sprite)) == 0) {
+	// get standard, already scaled by bin/upscale
+	if (sdl_scale > 1 && sdl_gx_read((unsigned int)sprite, SDL_GX_UPSCALED, &f) == 0) {
+		ret = sdl_load_image_png_up(si, filename, &f);
+		sdl_gx_release(&f);
+		if (ret == 0) {
 			return 0;
 		}
-		if (zip1p && sdl_load_image_png(si, filename, zip1p, do_smoothify(sprite)) == 0) {
-			return 0;
-		}
-		if (zip1 && sdl_load_image_png(si, filename, zip1, do_smoothify(sprite)) == 0) {
+	}
+
+	// get standard from archive
+	if (sdl_gx_read((unsigned int)sprite, SDL_GX_BASE, &f) == 0) {
+		ret = sdl_load_image_png(si, filename, &f, do_smoothify(sprite));
+		sdl_gx_release(&f);
+		if (ret == 0) {
 			return 0;
 		}
 	}
@@ -735,25 +523,23 @@ int sdl_load_image(struct sdl_image *si, int sprite, struct zip_handles *zips)
 	if (sdl_load_image_png(si,filename,NULL,do_smoothify(sprite))==0) return 0;
 #endif
 
-	sprintf(filename, "%08d.png", sprite);
 	warn("%s not found", filename);
 
 	// get unknown sprite image
 	sprintf(filename, "%08d.png", 2);
-	if (zip1 && sdl_load_image_png(si, filename, zip1, do_smoothify(sprite)) == 0) {
-		return 0;
+	if (sdl_gx_read(2, SDL_GX_BASE, &f) == 0) {
+		ret = sdl_load_image_png(si, filename, &f, do_smoothify(sprite));
+		sdl_gx_release(&f);
+		if (ret == 0) {
+			return 0;
+		}
 	}
 
-	char *txt = "The client could not locate the graphics file gx1.zip. "
-	            "Please make sure you start the client from the main folder, "
-	            "not from within the bin-folder.\n\n"
-	            "You can create a shortcut with the working directory set to the main folder.";
-	display_messagebox("Graphics Not Found", txt);
-	exit(105);
+	sdl_gx_missing();
 	return -1;
 }
 
-int sdl_ic_load(unsigned int sprite, struct zip_handles *zips)
+int sdl_ic_load(unsigned int sprite)
 {
 #ifdef DEVELOPER
 	uint64_t start = SDL_GetTicks();
@@ -807,7 +593,7 @@ retry:
 
 	// We are the loader now
 	extern struct sdl_image *sdli;
-	if (sdl_load_image(sdli + sprite, (int)sprite, zips) == 0) {
+	if (sdl_load_image(sdli + sprite, (int)sprite) == 0) {
 		__atomic_store_n((int *)&sdli_state[sprite], IMG_READY, __ATOMIC_RELEASE);
 #ifdef DEVELOPER
 		extern long long sdl_time_load;
@@ -820,15 +606,544 @@ retry:
 	}
 }
 
-void sdl_make(struct sdl_texture *st, struct sdl_image *si, int preload)
+/*
+ * Pixel buffers for sdl_make() and the PNG decoder. The workers allocate them
+ * and the main thread releases them after the upload, so a per-thread cache
+ * would only ever fill on one side; they go back to shared power-of-two
+ * buckets instead. At most PIXEL_POOL_CAP bytes are kept idle, buckets nobody
+ * asked for in PIXEL_POOL_IDLE ms are emptied by sdl_pixel_trim(). The
+ * contents of a buffer are undefined.
+ */
+#define PIXEL_POOL_MIN  12 // smallest bucket, 4KB
+#define PIXEL_POOL_MAX  24 // largest bucket, 16MB, bigger buffers bypass the pool
+#define PIXEL_POOL_CAP  ((size_t)64 * 1024 * 1024)
+#define PIXEL_POOL_IDLE 5000
+#define PIXEL_HEAD      16 // keeps the pixels 16 byte aligned
+
+struct pixel_buf {
+	struct pixel_buf *next; // free list
+	int bucket; // -1 if not pooled
+};
+
+static SDL_Mutex *pixel_pool_mutex;
+static struct pixel_buf *pixel_pool[PIXEL_POOL_MAX + 1];
+static uint64_t pixel_pool_used[PIXEL_POOL_MAX + 1];
+static size_t pixel_pool_mem;
+
+void *sdl_pixel_alloc(size_t size)
 {
-	SDL_Texture *texture;
-	int x, y, scale, sink;
+	struct pixel_buf *pb;
+	int bucket = PIXEL_POOL_MIN;
+
+	while (bucket <= PIXEL_POOL_MAX && ((size_t)1 << bucket) < size) {
+		bucket++;
+	}
+
+	if (bucket > PIXEL_POOL_MAX) {
+		pb = xmalloc(PIXEL_HEAD + size, MEM_SDL_PIXEL);
+		if (!pb) {
+			return NULL;
+		}
+		pb->bucket = -1;
+		return (unsigned char *)pb + PIXEL_HEAD;
+	}
+
+	SDL_LockMutex(pixel_pool_mutex);
+	pb = pixel_pool[bucket];
+	if (pb) {
+		pixel_pool[bucket] = pb->next;
+		pixel_pool_mem -= (size_t)1 << bucket;
+	}
+	pixel_pool_used[bucket] = SDL_GetTicks();
+	SDL_UnlockMutex(pixel_pool_mutex);
+
+	if (!pb) {
+		pb = xmalloc(PIXEL_HEAD + ((size_t)1 << bucket), MEM_SDL_PIXEL);
+		if (!pb) {
+			return NULL;
+		}
+		pb->bucket = bucket;
+	}
+
+	return (unsigned char *)pb + PIXEL_HEAD;
+}
+
+void sdl_pixel_free(void *ptr)
+{
+	struct pixel_buf *pb;
+
+	if (!ptr) {
+		return;
+	}
+	pb = (struct pixel_buf *)((unsigned char *)ptr - PIXEL_HEAD);
+
+	if (pb->bucket >= 0) {
+		SDL_LockMutex(pixel_pool_mutex);
+		if (pixel_pool_mem + ((size_t)1 << pb->bucket) <= PIXEL_POOL_CAP) {
+			pixel_pool_mem += (size_t)1 << pb->bucket;
+			pb->next = pixel_pool[pb->bucket];
+			pixel_pool[pb->bucket] = pb;
+			pb = NULL;
+		}
+		SDL_UnlockMutex(pixel_pool_mutex);
+	}
+
+	xfree(pb);
+}
+
+// Releases the buffers of buckets not used for a while, or of all buckets.
+void sdl_pixel_trim(int all)
+{
+	struct pixel_buf *list = NULL, *pb, *next;
+	uint64_t now = SDL_GetTicks();
+
+	SDL_LockMutex(pixel_pool_mutex);
+	for (int b = PIXEL_POOL_MIN; b <= PIXEL_POOL_MAX; b++) {
+		if (!pixel_pool[b] || (!all && now - pixel_pool_used[b] < PIXEL_POOL_IDLE)) {
+			continue;
+		}
+		for (pb = pixel_pool[b]; pb->next; pb = pb->next) {
+			pixel_pool_mem -= (size_t)1 << b;
+		}
+		pixel_pool_mem -= (size_t)1 << b;
+		pb->next = list;
+		list = pixel_pool[b];
+		pixel_pool[b] = NULL;
+	}
+	SDL_UnlockMutex(pixel_pool_mutex);
+
+	for (pb = list; pb; pb = next) {
+		next = pb->next;
+		xfree(pb);
+	}
+}
+
+/*
+ * Base images: a sprite scaled, colourized, colour balanced and shined. They
+ * don't depend on light, sink or freeze, so all variants of a sprite under
+ * different lights share one and only redo the cheap final pass. Kept in a
+ * small LRU cache, entries in use are never evicted.
+ */
+#define MAKE_BASE_HASH   1024
+#define MAKE_BASE_BUDGET ((size_t)32 * 1024 * 1024)
+
+struct make_base {
+	struct make_base *next; // hash chain
+	uint32_t sprite;
+	uint8_t scale;
+	int16_t cr, cg, cb, light, sat;
+	uint16_t c1, c2, c3, shine;
+
+	uint32_t *pixel; // st->xres * st->yres * sdl_scale^2
+	size_t size;
+	int refs;
+	uint64_t used;
+};
+
+static SDL_Mutex *make_base_mutex;
+static struct make_base *make_base_hash[MAKE_BASE_HASH];
+static size_t make_base_mem;
+static uint64_t make_base_clock;
+
+void sdl_make_init(void)
+{
+	make_base_mutex = SDL_CreateMutex();
+	pixel_pool_mutex = SDL_CreateMutex();
+}
+
+void sdl_make_exit(void)
+{
+	for (int i = 0; i < MAKE_BASE_HASH; i++) {
+		struct make_base *b, *next;
+		for (b = make_base_hash[i]; b; b = next) {
+			next = b->next;
+			xfree(b->pixel);
+			xfree(b);
+		}
+		make_base_hash[i] = NULL;
+	}
+	make_base_mem = 0;
+
+	if (make_base_mutex) {
+		SDL_DestroyMutex(make_base_mutex);
+		make_base_mutex = NULL;
+	}
+
+	sdl_pixel_trim(1);
+	if (pixel_pool_mutex) {
+		SDL_DestroyMutex(pixel_pool_mutex);
+		pixel_pool_mutex = NULL;
+	}
+}
+
+static unsigned int make_base_hashfunc(const struct sdl_texture *st, int scale)
+{
+	unsigned int h = st->sprite * 2654435761u;
+
+	h ^= (unsigned int)scale + ((unsigned int)(uint16_t)st->cr << 8) + ((unsigned int)(uint16_t)st->cg << 16);
+	h *= 16777619u;
+	h ^= (unsigned int)(uint16_t)st->cb + ((unsigned int)(uint16_t)st->light << 8) +
+	     ((unsigned int)(uint16_t)st->sat << 16);
+	h *= 16777619u;
+	h ^= st->c1 + ((unsigned int)st->c2 << 16);
+	h *= 16777619u;
+	h ^= st->c3 + ((unsigned int)st->shine << 16);
+
+	return (h ^ (h >> 15)) % MAKE_BASE_HASH;
+}
+
+static int make_base_matches(const struct make_base *b, const struct sdl_texture *st, int scale)
+{
+	return b->sprite == st->sprite && b->scale == scale && b->cr == st->cr && b->cg == st->cg && b->cb == st->cb &&
+	       b->light == st->light && b->sat == st->sat && b->c1 == st->c1 && b->c2 == st->c2 && b->c3 == st->c3 &&
+	       b->shine == st->shine;
+}
+
+// Evict unused entries, oldest first, until the cache fits its budget. Caller holds make_base_mutex.
+static void make_base_trim(void)
+{
+	while (make_base_mem > MAKE_BASE_BUDGET) {
+		struct make_base **oldest = NULL, **pb;
+
+		for (int i = 0; i < MAKE_BASE_HASH; i++) {
+			for (pb = &make_base_hash[i]; *pb; pb = &(*pb)->next) {
+				if (!(*pb)->refs && (!oldest || (*pb)->used < (*oldest)->used)) {
+					oldest = pb;
+				}
+			}
+		}
+		if (!oldest) {
+			break;
+		}
+
+		struct make_base *b = *oldest;
+		*oldest = b->next;
+		make_base_mem -= b->size;
+		xfree(b->pixel);
+		xfree(b);
+	}
+}
+
+// Scale, colourize, colour balance and shine: the part of sdl_make() that doesn't depend on light
+static void sdl_make_base(uint32_t *pixel, const struct sdl_texture *st, const struct sdl_image *si, int scale)
+{
+	int x, y;
 	double ix, iy, low_x, low_y, high_x, high_y, dbr, dbg, dbb, dba;
 	uint32_t irgb;
+
+	for (y = 0; y < st->yres * sdl_scale; y++) {
+		for (x = 0; x < st->xres * sdl_scale; x++) {
+			if (scale != 100) {
+				ix = x * 100.0 / scale;
+				iy = y * 100.0 / scale;
+
+				if (ceil(ix) >= si->xres * sdl_scale) {
+					ix = si->xres * sdl_scale - 1.001;
+				}
+
+				if (ceil(iy) >= si->yres * sdl_scale) {
+					iy = si->yres * sdl_scale - 1.001;
+				}
+
+				high_x = ix - floor(ix);
+				high_y = iy - floor(iy);
+				low_x = 1 - high_x;
+				low_y = 1 - high_y;
+
+				irgb = si->pixel[(int)(floor(ix) + floor(iy) * si->xres * sdl_scale)];
+
+				if (st->c1 || st->c2 || st->c3) {
+					irgb = sdl_colorize_pix2(irgb, st->c1, st->c2, st->c3, (int)floor(ix), (int)floor(iy), si->xres,
+					    si->yres, si->pixel, (int)st->sprite);
+				}
+				dba = IGET_A(irgb) * low_x * low_y;
+				dbr = IGET_R(irgb) * low_x * low_y;
+				dbg = IGET_G(irgb) * low_x * low_y;
+				dbb = IGET_B(irgb) * low_x * low_y;
+
+				irgb = si->pixel[(int)(ceil(ix) + floor(iy) * si->xres * sdl_scale)];
+
+				if (st->c1 || st->c2 || st->c3) {
+					irgb = sdl_colorize_pix2(irgb, st->c1, st->c2, st->c3, (int)ceil(ix), (int)floor(iy), si->xres,
+					    si->yres, si->pixel, (int)st->sprite);
+				}
+				dba += IGET_A(irgb) * high_x * low_y;
+				dbr += IGET_R(irgb) * high_x * low_y;
+				dbg += IGET_G(irgb) * high_x * low_y;
+				dbb += IGET_B(irgb) * high_x * low_y;
+
+				irgb = si->pixel[(int)(floor(ix) + ceil(iy) * si->xres * sdl_scale)];
+
+				if (st->c1 || st->c2 || st->c3) {
+					irgb = sdl_colorize_pix2(irgb, st->c1, st->c2, st->c3, (int)floor(ix), (int)ceil(iy), si->xres,
+					    si->yres, si->pixel, (int)st->sprite);
+				}
+				dba += IGET_A(irgb) * low_x * high_y;
+				dbr += IGET_R(irgb) * low_x * high_y;
+				dbg += IGET_G(irgb) * low_x * high_y;
+				dbb += IGET_B(irgb) * low_x * high_y;
+
+				irgb = si->pixel[(int)(ceil(ix) + ceil(iy) * si->xres * sdl_scale)];
+
+				if (st->c1 || st->c2 || st->c3) {
+					irgb = sdl_colorize_pix2(irgb, st->c1, st->c2, st->c3, (int)ceil(ix), (int)ceil(iy), si->xres,
+					    si->yres, si->pixel, (int)st->sprite);
+				}
+				dba += IGET_A(irgb) * high_x * high_y;
+				dbr += IGET_R(irgb) * high_x * high_y;
+				dbg += IGET_G(irgb) * high_x * high_y;
+				dbb += IGET_B(irgb) * high_x * high_y;
+
+				irgb = IRGBA((int)dbr, (int)dbg, (int)dbb, (int)dba);
+
+			} else {
+				irgb = si->pixel[x + y * si->xres * sdl_scale];
+				if (st->c1 || st->c2 || st->c3) {
+					irgb = sdl_colorize_pix2(
+					    irgb, st->c1, st->c2, st->c3, x, y, si->xres, si->yres, si->pixel, (int)st->sprite);
+				}
+			}
+
+			if (st->cr || st->cg || st->cb || st->light || st->sat) {
+				irgb = sdl_colorbalance(
+				    irgb, (char)st->cr, (char)st->cg, (char)st->cb, (char)st->light, (char)st->sat);
+			}
+			if (st->shine) {
+				irgb = sdl_shine_pix(irgb, st->shine);
+			}
+
+			pixel[x + y * st->xres * sdl_scale] = irgb;
+		}
+	}
+}
+
+/*
+ * Get the base image for st, building it if needed. Returns NULL if the
+ * sprite needs none of the base steps, si->pixel is the base then.
+ * Release with make_base_release().
+ */
+static struct make_base *make_base_acquire(const struct sdl_texture *st, const struct sdl_image *si, int scale)
+{
+	struct make_base *b, *nb;
+	unsigned int h;
+	size_t size;
+
+	if (scale == 100 && !st->c1 && !st->c2 && !st->c3 && !st->cr && !st->cg && !st->cb && !st->light && !st->sat &&
+	    !st->shine) {
+		return NULL;
+	}
+
+	h = make_base_hashfunc(st, scale);
+
+	SDL_LockMutex(make_base_mutex);
+	for (b = make_base_hash[h]; b; b = b->next) {
+		if (make_base_matches(b, st, scale)) {
+			b->refs++;
+			b->used = ++make_base_clock;
+			SDL_UnlockMutex(make_base_mutex);
+			return b;
+		}
+	}
+	SDL_UnlockMutex(make_base_mutex);
+
+	// build outside the lock, other workers may be making other sprites meanwhile
+	size = (size_t)st->xres * st->yres * sizeof(uint32_t) * (size_t)sdl_scale * (size_t)sdl_scale;
+	nb = xmalloc(sizeof(struct make_base), MEM_SDL_PIXEL);
+	nb->pixel = xmalloc(max(size, sizeof(uint32_t)), MEM_SDL_PIXEL);
+	nb->size = size;
+	nb->sprite = st->sprite;
+	nb->scale = (uint8_t)scale;
+	nb->cr = st->cr;
+	nb->cg = st->cg;
+	nb->cb = st->cb;
+	nb->light = st->light;
+	nb->sat = st->sat;
+	nb->c1 = st->c1;
+	nb->c2 = st->c2;
+	nb->c3 = st->c3;
+	nb->shine = st->shine;
+	nb->refs = 1;
+	sdl_make_base(nb->pixel, st, si, scale);
+
+	SDL_LockMutex(make_base_mutex);
+	for (b = make_base_hash[h]; b; b = b->next) {
+		if (make_base_matches(b, st, scale)) { // another worker was faster
+			b->refs++;
+			b->used = ++make_base_clock;
+			SDL_UnlockMutex(make_base_mutex);
+			xfree(nb->pixel);
+			xfree(nb);
+			return b;
+		}
+	}
+	nb->used = ++make_base_clock;
+	nb->next = make_base_hash[h];
+	make_base_hash[h] = nb;
+	make_base_mem += size;
+	make_base_trim();
+	SDL_UnlockMutex(make_base_mutex);
+
+	return nb;
+}
+
+static void make_base_release(struct make_base *b)
+{
+	if (!b) {
+		return;
+	}
+	SDL_LockMutex(make_base_mutex);
+	b->refs--;
+	make_base_trim();
+	SDL_UnlockMutex(make_base_mutex);
+}
+
+// Light, sink and freeze on top of the base image
+static void sdl_make_light(struct sdl_texture *st, const uint32_t *base, int sink)
+{
+	int x, y;
+	uint32_t irgb;
+
+	for (y = 0; y < st->yres * sdl_scale; y++) {
+		for (x = 0; x < st->xres * sdl_scale; x++) {
+			irgb = base[x + y * st->xres * sdl_scale];
+
+			if (st->ll != st->ml || st->rl != st->ml || st->ul != st->ml || st->dl != st->ml) {
+				int r, g, b, a;
+				int r1 = 0, r2 = 0, r3 = 0, r4 = 0, r5 = 0;
+				int g1 = 0, g2 = 0, g3 = 0, g4 = 0, g5 = 0;
+				int b1 = 0, b2 = 0, b3 = 0, b4 = 0, b5 = 0;
+				int v1, v2, v3, v4, v5 = 0;
+				int div;
+
+
+				if (y < 10 * sdl_scale + (20 * sdl_scale - abs(20 * sdl_scale - x)) / 2) {
+					// This part calculates a floor tile, or the top of a wall tile
+					if (x / 2 < 20 * sdl_scale - y) {
+						v2 = -(x / 2 - (20 * sdl_scale - y));
+						r2 = IGET_R(sdl_light(st->ll, irgb));
+						g2 = IGET_G(sdl_light(st->ll, irgb));
+						b2 = IGET_B(sdl_light(st->ll, irgb));
+					} else {
+						v2 = 0;
+					}
+					if (x / 2 > 20 * sdl_scale - y) {
+						v3 = (x / 2 - (20 * sdl_scale - y));
+						r3 = IGET_R(sdl_light(st->rl, irgb));
+						g3 = IGET_G(sdl_light(st->rl, irgb));
+						b3 = IGET_B(sdl_light(st->rl, irgb));
+					} else {
+						v3 = 0;
+					}
+					if (x / 2 > y) {
+						v4 = (x / 2 - y);
+						r4 = IGET_R(sdl_light(st->ul, irgb));
+						g4 = IGET_G(sdl_light(st->ul, irgb));
+						b4 = IGET_B(sdl_light(st->ul, irgb));
+					} else {
+						v4 = 0;
+					}
+					if (x / 2 < y) {
+						v5 = -(x / 2 - y);
+						r5 = IGET_R(sdl_light(st->dl, irgb));
+						g5 = IGET_G(sdl_light(st->dl, irgb));
+						b5 = IGET_B(sdl_light(st->dl, irgb));
+					} else {
+						v5 = 0;
+					}
+
+					v1 = 20 * sdl_scale - (v2 + v3 + v4 + v5);
+					r1 = IGET_R(sdl_light(st->ml, irgb));
+					g1 = IGET_G(sdl_light(st->ml, irgb));
+					b1 = IGET_B(sdl_light(st->ml, irgb));
+				} else {
+					// This is for the lower part (left side and front as seen on the screen)
+					if (x < 10 * sdl_scale) {
+						v2 = (10 * sdl_scale - x) * 2 - 2;
+						r2 = IGET_R(sdl_light(st->ll, irgb));
+						g2 = IGET_G(sdl_light(st->ll, irgb));
+						b2 = IGET_B(sdl_light(st->ll, irgb));
+					} else {
+						v2 = 0;
+					}
+					if (x > 10 * sdl_scale && x < 20 * sdl_scale) {
+						v3 = (x - 10 * sdl_scale) * 2 - 2;
+						r3 = IGET_R(sdl_light(st->rl, irgb));
+						g3 = IGET_G(sdl_light(st->rl, irgb));
+						b3 = IGET_B(sdl_light(st->rl, irgb));
+					} else {
+						v3 = 0;
+					}
+					if (x > 20 * sdl_scale && x < 30 * sdl_scale) {
+						v5 = (10 * sdl_scale - (x - 20 * sdl_scale)) * 2 - 2;
+						r5 = IGET_R(sdl_light(st->dl, irgb));
+						g5 = IGET_G(sdl_light(st->dl, irgb));
+						b5 = IGET_B(sdl_light(st->dl, irgb));
+					} else {
+						v5 = 0;
+					}
+					if (x > 30 * sdl_scale) {
+						if (x < 40 * sdl_scale) {
+							v4 = (x - 30 * sdl_scale) * 2 - 2;
+						} else {
+							v4 = 0;
+						}
+						r4 = IGET_R(sdl_light(st->ul, irgb));
+						g4 = IGET_G(sdl_light(st->ul, irgb));
+						b4 = IGET_B(sdl_light(st->ul, irgb));
+					} else {
+						v4 = 0;
+					}
+
+					v1 = 20 * sdl_scale - (v2 + v3 + v4 + v5) / 2;
+					r1 = IGET_R(sdl_light(st->ml, irgb));
+					g1 = IGET_G(sdl_light(st->ml, irgb));
+					b1 = IGET_B(sdl_light(st->ml, irgb));
+				}
+
+				div = v1 + v2 + v3 + v4 + v5;
+
+				if (div == 0) {
+					a = 0;
+					r = g = b = 0;
+				} else {
+					a = IGET_A(irgb);
+					r = (r1 * v1 + r2 * v2 + r3 * v3 + r4 * v4 + r5 * v5) / div;
+					g = (g1 * v1 + g2 * v2 + g3 * v3 + g4 * v4 + g5 * v5) / div;
+					b = (b1 * v1 + b2 * v2 + b3 * v3 + b4 * v4 + b5 * v5) / div;
+				}
+
+				irgb = IRGBA(r, g, b, a);
+
+			} else {
+				irgb = sdl_light(st->ml, irgb);
+			}
+
+			if (sink) {
+				if (st->yres * sdl_scale - sink * sdl_scale < y) {
+					irgb &= 0xffffff; // zero alpha to make it transparent
+				}
+			}
+
+			if (st->freeze) {
+				irgb = sdl_freeze(st->freeze, irgb);
+			}
+
+			st->pixel[x + y * st->xres * sdl_scale] = irgb;
+		}
+	}
+}
+
+static const char *make_zone[4] = {"sdl_make", "sdl_make 1", "sdl_make 2", "sdl_make 3"};
+
+void sdl_make(struct sdl_texture *st, struct sdl_image *si, int preload)
+{
+	SDL_Texture *texture;
+	struct make_base *base;
+	int scale, sink;
 #ifdef DEVELOPER
 	Uint64 start = SDL_GetTicks();
 #endif
+	PROF_ZONE(make_zone[preload & 3]);
 
 	if (si->xres == 0 || si->yres == 0) {
 		scale = 100; // !!! needs better handling !!!
@@ -865,12 +1180,8 @@ void sdl_make(struct sdl_texture *st, struct sdl_image *si, int preload)
 		if (!(flags_load(st) & SF_DIDALLOC)) {
 			// Only allocate if not already allocated (may be set by caller with mutex protection in multi-threaded
 			// mode)
-#ifdef SDL_FAST_MALLOC
-			st->pixel = MALLOC((size_t)st->xres * st->yres * sizeof(uint32_t) * (size_t)sdl_scale * (size_t)sdl_scale);
-#else
-			st->pixel = xmalloc(
-			    (size_t)st->xres * st->yres * sizeof(uint32_t) * (size_t)sdl_scale * (size_t)sdl_scale, MEM_SDL_PIXEL);
-#endif
+			st->pixel =
+			    sdl_pixel_alloc((size_t)st->xres * st->yres * sizeof(uint32_t) * (size_t)sdl_scale * (size_t)sdl_scale);
 			uint16_t *flags_ptr = (uint16_t *)&st->flags;
 			__atomic_fetch_or(flags_ptr, SF_DIDALLOC, __ATOMIC_RELEASE);
 		}
@@ -908,211 +1219,9 @@ void sdl_make(struct sdl_texture *st, struct sdl_image *si, int preload)
 		start = SDL_GetTicks();
 #endif
 
-		for (y = 0; y < st->yres * sdl_scale; y++) {
-			for (x = 0; x < st->xres * sdl_scale; x++) {
-				if (scale != 100) {
-					ix = x * 100.0 / scale;
-					iy = y * 100.0 / scale;
-
-					if (ceil(ix) >= si->xres * sdl_scale) {
-						ix = si->xres * sdl_scale - 1.001;
-					}
-
-					if (ceil(iy) >= si->yres * sdl_scale) {
-						iy = si->yres * sdl_scale - 1.001;
-					}
-
-					high_x = ix - floor(ix);
-					high_y = iy - floor(iy);
-					low_x = 1 - high_x;
-					low_y = 1 - high_y;
-
-					irgb = si->pixel[(int)(floor(ix) + floor(iy) * si->xres * sdl_scale)];
-
-					if (st->c1 || st->c2 || st->c3) {
-						irgb = sdl_colorize_pix2(irgb, st->c1, st->c2, st->c3, (int)floor(ix), (int)floor(iy), si->xres,
-						    si->yres, si->pixel, (int)st->sprite);
-					}
-					dba = IGET_A(irgb) * low_x * low_y;
-					dbr = IGET_R(irgb) * low_x * low_y;
-					dbg = IGET_G(irgb) * low_x * low_y;
-					dbb = IGET_B(irgb) * low_x * low_y;
-
-					irgb = si->pixel[(int)(ceil(ix) + floor(iy) * si->xres * sdl_scale)];
-
-					if (st->c1 || st->c2 || st->c3) {
-						irgb = sdl_colorize_pix2(irgb, st->c1, st->c2, st->c3, (int)ceil(ix), (int)floor(iy), si->xres,
-						    si->yres, si->pixel, (int)st->sprite);
-					}
-					dba += IGET_A(irgb) * high_x * low_y;
-					dbr += IGET_R(irgb) * high_x * low_y;
-					dbg += IGET_G(irgb) * high_x * low_y;
-					dbb += IGET_B(irgb) * high_x * low_y;
-
-					irgb = si->pixel[(int)(floor(ix) + ceil(iy) * si->xres * sdl_scale)];
-
-					if (st->c1 || st->c2 || st->c3) {
-						irgb = sdl_colorize_pix2(irgb, st->c1, st->c2, st->c3, (int)floor(ix), (int)ceil(iy), si->xres,
-						    si->yres, si->pixel, (int)st->sprite);
-					}
-					dba += IGET_A(irgb) * low_x * high_y;
-					dbr += IGET_R(irgb) * low_x * high_y;
-					dbg += IGET_G(irgb) * low_x * high_y;
-					dbb += IGET_B(irgb) * low_x * high_y;
-
-					irgb = si->pixel[(int)(ceil(ix) + ceil(iy) * si->xres * sdl_scale)];
-
-					if (st->c1 || st->c2 || st->c3) {
-						irgb = sdl_colorize_pix2(irgb, st->c1, st->c2, st->c3, (int)ceil(ix), (int)ceil(iy), si->xres,
-						    si->yres, si->pixel, (int)st->sprite);
-					}
-					dba += IGET_A(irgb) * high_x * high_y;
-					dbr += IGET_R(irgb) * high_x * high_y;
-					dbg += IGET_G(irgb) * high_x * high_y;
-					dbb += IGET_B(irgb) * high_x * high_y;
-
-					irgb = IRGBA((int)dbr, (int)dbg, (int)dbb, (int)dba);
-
-				} else {
-					irgb = si->pixel[x + y * si->xres * sdl_scale];
-					if (st->c1 || st->c2 || st->c3) {
-						irgb = sdl_colorize_pix2(
-						    irgb, st->c1, st->c2, st->c3, x, y, si->xres, si->yres, si->pixel, (int)st->sprite);
-					}
-				}
-
-				if (st->cr || st->cg || st->cb || st->light || st->sat) {
-					irgb = sdl_colorbalance(
-					    irgb, (char)st->cr, (char)st->cg, (char)st->cb, (char)st->light, (char)st->sat);
-				}
-				if (st->shine) {
-					irgb = sdl_shine_pix(irgb, st->shine);
-				}
-
-				if (st->ll != st->ml || st->rl != st->ml || st->ul != st->ml || st->dl != st->ml) {
-					int r, g, b, a;
-					int r1 = 0, r2 = 0, r3 = 0, r4 = 0, r5 = 0;
-					int g1 = 0, g2 = 0, g3 = 0, g4 = 0, g5 = 0;
-					int b1 = 0, b2 = 0, b3 = 0, b4 = 0, b5 = 0;
-					int v1, v2, v3, v4, v5 = 0;
-					int div;
-
-
-					if (y < 10 * sdl_scale + (20 * sdl_scale - abs(20 * sdl_scale - x)) / 2) {
-						// This part calculates a floor tile, or the top of a wall tile
-						if (x / 2 < 20 * sdl_scale - y) {
-							v2 = -(x / 2 - (20 * sdl_scale - y));
-							r2 = IGET_R(sdl_light(st->ll, irgb));
-							g2 = IGET_G(sdl_light(st->ll, irgb));
-							b2 = IGET_B(sdl_light(st->ll, irgb));
-						} else {
-							v2 = 0;
-						}
-						if (x / 2 > 20 * sdl_scale - y) {
-							v3 = (x / 2 - (20 * sdl_scale - y));
-							r3 = IGET_R(sdl_light(st->rl, irgb));
-							g3 = IGET_G(sdl_light(st->rl, irgb));
-							b3 = IGET_B(sdl_light(st->rl, irgb));
-						} else {
-							v3 = 0;
-						}
-						if (x / 2 > y) {
-							v4 = (x / 2 - y);
-							r4 = IGET_R(sdl_light(st->ul, irgb));
-							g4 = IGET_G(sdl_light(st->ul, irgb));
-							b4 = IGET_B(sdl_light(st->ul, irgb));
-						} else {
-							v4 = 0;
-						}
-						if (x / 2 < y) {
-							v5 = -(x / 2 - y);
-							r5 = IGET_R(sdl_light(st->dl, irgb));
-							g5 = IGET_G(sdl_light(st->dl, irgb));
-							b5 = IGET_B(sdl_light(st->dl, irgb));
-						} else {
-							v5 = 0;
-						}
-
-						v1 = 20 * sdl_scale - (v2 + v3 + v4 + v5);
-						r1 = IGET_R(sdl_light(st->ml, irgb));
-						g1 = IGET_G(sdl_light(st->ml, irgb));
-						b1 = IGET_B(sdl_light(st->ml, irgb));
-					} else {
-						// This is for the lower part (left side and front as seen on the screen)
-						if (x < 10 * sdl_scale) {
-							v2 = (10 * sdl_scale - x) * 2 - 2;
-							r2 = IGET_R(sdl_light(st->ll, irgb));
-							g2 = IGET_G(sdl_light(st->ll, irgb));
-							b2 = IGET_B(sdl_light(st->ll, irgb));
-						} else {
-							v2 = 0;
-						}
-						if (x > 10 * sdl_scale && x < 20 * sdl_scale) {
-							v3 = (x - 10 * sdl_scale) * 2 - 2;
-							r3 = IGET_R(sdl_light(st->rl, irgb));
-							g3 = IGET_G(sdl_light(st->rl, irgb));
-							b3 = IGET_B(sdl_light(st->rl, irgb));
-						} else {
-							v3 = 0;
-						}
-						if (x > 20 * sdl_scale && x < 30 * sdl_scale) {
-							v5 = (10 * sdl_scale - (x - 20 * sdl_scale)) * 2 - 2;
-							r5 = IGET_R(sdl_light(st->dl, irgb));
-							g5 = IGET_G(sdl_light(st->dl, irgb));
-							b5 = IGET_B(sdl_light(st->dl, irgb));
-						} else {
-							v5 = 0;
-						}
-						if (x > 30 * sdl_scale) {
-							if (x < 40 * sdl_scale) {
-								v4 = (x - 30 * sdl_scale) * 2 - 2;
-							} else {
-								v4 = 0;
-							}
-							r4 = IGET_R(sdl_light(st->ul, irgb));
-							g4 = IGET_G(sdl_light(st->ul, irgb));
-							b4 = IGET_B(sdl_light(st->ul, irgb));
-						} else {
-							v4 = 0;
-						}
-
-						v1 = 20 * sdl_scale - (v2 + v3 + v4 + v5) / 2;
-						r1 = IGET_R(sdl_light(st->ml, irgb));
-						g1 = IGET_G(sdl_light(st->ml, irgb));
-						b1 = IGET_B(sdl_light(st->ml, irgb));
-					}
-
-					div = v1 + v2 + v3 + v4 + v5;
-
-					if (div == 0) {
-						a = 0;
-						r = g = b = 0;
-					} else {
-						a = IGET_A(irgb);
-						r = (r1 * v1 + r2 * v2 + r3 * v3 + r4 * v4 + r5 * v5) / div;
-						g = (g1 * v1 + g2 * v2 + g3 * v3 + g4 * v4 + g5 * v5) / div;
-						b = (b1 * v1 + b2 * v2 + b3 * v3 + b4 * v4 + b5 * v5) / div;
-					}
-
-					irgb = IRGBA(r, g, b, a);
-
-				} else {
-					irgb = sdl_light(st->ml, irgb);
-				}
-
-				if (sink) {
-					if (st->yres * sdl_scale - sink * sdl_scale < y) {
-						irgb &= 0xffffff; // zero alpha to make it transparent
-					}
-				}
-
-				if (st->freeze) {
-					irgb = sdl_freeze(st->freeze, irgb);
-				}
-
-				st->pixel[x + y * st->xres * sdl_scale] = irgb;
-			}
-		}
+		base = make_base_acquire(st, si, scale);
+		sdl_make_light(st, base ? base->pixel : si->pixel, sink);
+		make_base_release(base);
 		uint16_t *flags_ptr = (uint16_t *)&st->flags;
 		__atomic_fetch_or(flags_ptr, SF_DIDMAKE, __ATOMIC_RELEASE);
 
@@ -1161,11 +1270,7 @@ void sdl_make(struct sdl_texture *st, struct sdl_image *si, int preload)
 		} else {
 			texture = NULL;
 		}
-#ifdef SDL_FAST_MALLOC
-		FREE(st->pixel);
-#else
-		xfree(st->pixel);
-#endif
+		sdl_pixel_free(st->pixel);
 		st->pixel = NULL;
 		st->tex = texture;
 
@@ -152,16 +152,7 @@ struct renderfont {
 
 #define RENDER_TEXT_TERMINATOR '\xB0' // draw text terminator - (zero stays one, too)
 
-struct zip_handles {
-	zip_t *zip1;
-	zip_t *zip2;
-	zip_t *zip1p;
-	zip_t *zip2p;
-	zip_t *zip1m;
-	zip_t *zip2m;
-};
-
-int sdl_ic_load(unsigned int sprite, struct zip_handles *zips);
+int sdl_ic_load(unsigned int sprite);
 int sdl_pre_backgnd(void *ptr);
 int sdl_create_cursors(void);
 SDL_Cursor *sdl_create_cursor(char *filename);
@@ -186,12 +177,6 @@ void png_load_helper_exit(struct png_helper *p);
 // ============================================================================
 extern SDL_Window *sdlwnd;
 extern SDL_Renderer *sdlren;
-extern zip_t *sdl_zip1;
-extern zip_t *sdl_zip2;
-extern zip_t *sdl_zip1p;
-extern zip_t *sdl_zip2p;
-extern zip_t *sdl_zip1m;
-extern zip_t *sdl_zip2m;
 extern SDL_Mutex *premutex;
 extern int *sdli_state; // Image loading state machine
 extern texture_job_queue_t g_tex_jobs; // Texture job queue
@@ -240,18 +225,46 @@ void sdl_dump_spritecache(void);
 #endif
 
 // ============================================================================
-// Internal functions from sdl_image.c
+// Internal functions from sdl_gx.c
+// ============================================================================
+struct sdl_gx_file {
+	const unsigned char *data; // PNG file, may point into the mapped archive
+	size_t size;
+	unsigned char *buf; // owned copy for compressed entries, NULL otherwise
+};
+
+// levels for sdl_gx_read()
+#define SDL_GX_BASE     0 // gx1.zip
+#define SDL_GX_HIRES    1 // gx2/gx3/gx4.zip
+#define SDL_GX_UPSCALED 2 // gx2/gx3/gx4_up.zip, 1X art scaled by bin/upscale
+
+int sdl_gx_open(int scale);
+void sdl_gx_missing(void);
+void sdl_gx_close(void);
+int sdl_gx_read(unsigned int sprite, int level, struct sdl_gx_file *f);
+void sdl_gx_release(struct sdl_gx_file *f);
+
+// ============================================================================
+// Internal functions from sdl_smooth.c
 // ============================================================================
 uint32_t mix_argb(uint32_t c1, uint32_t c2, float w1, float w2);
 void sdl_smoothify(uint32_t *pixel, int xres, int yres, int scale);
+int do_smoothify(int sprite);
+
+// ============================================================================
+// Internal functions from sdl_image.c
+// ============================================================================
 void sdl_premulti(uint32_t *pixel, int xres, int yres, int scale);
 void png_helper_read(png_structp ps, png_bytep buf, png_size_t len);
-int sdl_load_image_png_(struct sdl_image *si, char *filename, zip_t *zip);
-int sdl_load_image_png(struct sdl_image *si, char *filename, zip_t *zip, int smoothify);
-int do_smoothify(int sprite);
-int sdl_load_image(struct sdl_image *si, int sprite, struct zip_handles *zips);
-int sdl_ic_load(unsigned int sprite, struct zip_handles *zips);
+int sdl_load_image_png_(struct sdl_image *si, char *filename, const struct sdl_gx_file *f);
+int sdl_load_image_png(struct sdl_image *si, char *filename, const struct sdl_gx_file *f, int smoothify);
+int sdl_load_image_png_up(struct sdl_image *si, char *filename, const struct sdl_gx_file *f);
+int sdl_load_image(struct sdl_image *si, int sprite);
 void sdl_make(struct sdl_texture *st, struct sdl_image *si, int preload);
+void sdl_make_init(void);
+void sdl_make_exit(void);
+void *sdl_pixel_alloc(size_t size);
+void sdl_pixel_free(void *ptr);
 
 // ============================================================================
 // Internal functions from sdl_effects.c
@@ -283,6 +296,10 @@ int if_single_thread_process_one_job(void);
 // Line clipping function (non-static for testing)
 int clip_line(int *x0, int *y0, int *x1, int *y1, int xmin, int ymin, int xmax, int ymax);
 
+// Texture cache hash functions (wrappers around the static inline versions in sdl_texture.c)
+unsigned int test_hashfunc(unsigned int sprite, int ml, int ll, int rl, int ul, int dl);
+unsigned int test_hashfunc_text(const char *text, int color, int flags);
+
 // Render call counter functions for test verification
 void sdl_test_reset_render_counters(void);
 int sdl_test_get_render_point_count(void);
@@ -294,6 +311,9 @@ int sdl_test_get_render_total_count(void);
 int sdl_test_get_set_draw_color_count(void);
 int sdl_test_get_set_blend_mode_count(void);
 
+// gx1.zip opened with libzip, for tests that enumerate the sprites
+extern zip_t *sdl_zip1;
+
 // Initialize SDL subsystems for testing without window/audio/real I/O
 int sdl_init_for_tests(void);
 
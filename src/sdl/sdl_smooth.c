@@ -0,0 +1,186 @@
+/*
+ * Part of Astonia Client (c) Daniel Brockhaus. Please read license.txt.
+ *
+ * SDL - Smoothing
+ *
+ * Blends the blocks of replicated pixels when 1X art is scaled up. Shared by
+ * the client and the upscale helper, which runs it offline so the client can
+ * load the result from gx{2,3,4}_up.zip instead.
+ */
+
+#include <stdint.h>
+#include <SDL3/SDL.h>
+
+#include "astonia.h"
+#include "sdl/sdl.h"
+#include "sdl/sdl_private.h"
+
+uint32_t mix_argb(uint32_t c1, uint32_t c2, float w1, float w2)
+{
+	int r1, r2, g1, g2, b1, b2, a1, a2;
+	uint32_t r, g, b, a;
+
+	a1 = IGET_A(c1);
+	a2 = IGET_A(c2);
+	if (!a1 && !a2) {
+		return 0; // save some work
+	}
+
+	r1 = IGET_R(c1);
+	g1 = IGET_G(c1);
+	b1 = IGET_B(c1);
+
+	r2 = IGET_R(c2);
+	g2 = IGET_G(c2);
+	b2 = IGET_B(c2);
+
+	a = (uint32_t)((float)a1 * w1 + (float)a2 * w2);
+	r = (uint32_t)((float)r1 * w1 + (float)r2 * w2);
+	g = (uint32_t)((float)g1 * w1 + (float)g2 * w2);
+	b = (uint32_t)((float)b1 * w1 + (float)b2 * w2);
+
+	if (a > 255U) {
+		a = 255U;
+	}
+	if (r > 255U) {
+		r = 255U;
+	}
+	if (g > 255U) {
+		g = 255U;
+	}
+	if (b > 255U) {
+		b = 255U;
+	}
+
+	return IRGBA(r, g, b, a);
+}
+
+void sdl_smoothify(uint32_t *pixel, int xres, int yres, int scale)
+{
+	int x, y;
+	uint32_t c1, c2, c3, c4;
+
+	switch (scale) {
+	case 2:
+		for (x = 0; x < xres - 2; x += 2) {
+			for (y = 0; y < yres - 2; y += 2) {
+				c1 = pixel[x + y * xres]; // top left
+				c2 = pixel[x + y * xres + 2]; // top right
+				c3 = pixel[x + y * xres + xres * 2]; // bottom left
+				c4 = pixel[x + y * xres + 2 + xres * 2]; // bottom right
+
+				pixel[x + y * xres + 1] = mix_argb(c1, c2, 0.5f, 0.5f);
+				pixel[x + y * xres + xres] = mix_argb(c1, c3, 0.5f, 0.5f);
+				pixel[x + y * xres + 1 + xres] =
+				    mix_argb(mix_argb(c1, c2, 0.5f, 0.5f), mix_argb(c3, c4, 0.5f, 0.5f), 0.5f, 0.5f);
+			}
+		}
+		break;
+	case 3:
+		for (x = 0; x < xres - 3; x += 3) {
+			for (y = 0; y < yres - 3; y += 3) {
+				c1 = pixel[x + y * xres]; // top left
+				c2 = pixel[x + y * xres + 3]; // top right
+				c3 = pixel[x + y * xres + xres * 3]; // bottom left
+				c4 = pixel[x + y * xres + 3 + xres * 3]; // bottom right
+
+				pixel[x + y * xres + 1] = mix_argb(c1, c2, 0.667f, 0.333f);
+				pixel[x + y * xres + 2] = mix_argb(c1, c2, 0.333f, 0.667f);
+
+				pixel[x + y * xres + xres * 1] = mix_argb(c1, c3, 0.667f, 0.333f);
+				pixel[x + y * xres + xres * 2] = mix_argb(c1, c3, 0.333f, 0.667f);
+
+				pixel[x + y * xres + 1 + xres * 1] =
+				    mix_argb(mix_argb(c1, c2, 0.5f, 0.5f), mix_argb(c3, c4, 0.5f, 0.5f), 0.5f, 0.5f);
+				pixel[x + y * xres + 2 + xres * 1] =
+				    mix_argb(mix_argb(c1, c2, 0.333f, 0.667f), mix_argb(c3, c4, 0.333f, 0.667f), 0.667f, 0.333f);
+				pixel[x + y * xres + 1 + xres * 2] =
+				    mix_argb(mix_argb(c1, c2, 0.667f, 0.333f), mix_argb(c3, c4, 0.667f, 0.333f), 0.333f, 0.667f);
+				pixel[x + y * xres + 2 + xres * 2] =
+				    mix_argb(mix_argb(c1, c2, 0.333f, 0.667f), mix_argb(c3, c4, 0.333f, 0.667f), 0.333f, 0.667f);
+			}
+		}
+		break;
+
+	case 4:
+		for (x = 0; x < xres - 4; x += 4) {
+			for (y = 0; y < yres - 4; y += 4) {
+				c1 = pixel[x + y * xres]; // top left
+				c2 = pixel[x + y * xres + 4]; // top right
+				c3 = pixel[x + y * xres + xres * 4]; // bottom left
+				c4 = pixel[x + y * xres + 4 + xres * 4]; // bottom right
+
+				pixel[x + y * xres + 1] = mix_argb(c1, c2, 0.75f, 0.25f);
+				pixel[x + y * xres + 2] = mix_argb(c1, c2, 0.5f, 0.5f);
+				pixel[x + y * xres + 3] = mix_argb(c1, c2, 0.25f, 0.75f);
+
+				pixel[x + y * xres + xres * 1] = mix_argb(c1, c3, 0.75f, 0.25f);
+				pixel[x + y * xres + xres * 2] = mix_argb(c1, c3, 0.5f, 0.5f);
+				pixel[x + y * xres + xres * 3] = mix_argb(c1, c3, 0.25f, 0.75f);
+
+				pixel[x + y * xres + 1 + xres * 1] =
+				    mix_argb(mix_argb(c1, c2, 0.75f, 0.25f), mix_argb(c3, c4, 0.75f, 0.25f), 0.75f, 0.25f);
+				pixel[x + y * xres + 1 + xres * 2] =
+				    mix_argb(mix_argb(c1, c2, 0.75f, 0.25f), mix_argb(c3, c4, 0.75f, 0.25f), 0.5f, 0.5f);
+				pixel[x + y * xres + 1 + xres * 3] =
+				    mix_argb(mix_argb(c1, c2, 0.75f, 0.75f), mix_argb(c3, c4, 0.75f, 0.25f), 0.25f, 0.75f);
+
+				pixel[x + y * xres + 2 + xres * 1] =
+				    mix_argb(mix_argb(c1, c2, 0.5f, 0.5f), mix_argb(c3, c4, 0.5f, 0.5f), 0.75f, 0.25f);
+				pixel[x + y * xres + 2 + xres * 2] =
+				    mix_argb(mix_argb(c1, c2, 0.5f, 0.5f), mix_argb(c3, c4, 0.5f, 0.5f), 0.5f, 0.5f);
+				pixel[x + y * xres + 2 + xres * 3] =
+				    mix_argb(mix_argb(c1, c2, 0.5f, 0.5f), mix_argb(c3, c4, 0.5f, 0.5f), 0.25f, 0.75f);
+
+				pixel[x + y * xres + 3 + xres * 1] =
+				    mix_argb(mix_argb(c1, c2, 0.25f, 0.75f), mix_argb(c3, c4, 0.25f, 0.75f), 0.75f, 0.25f);
+				pixel[x + y * xres + 3 + xres * 2] =
+				    mix_argb(mix_argb(c1, c2, 0.25f, 0.75f), mix_argb(c3, c4, 0.25f, 0.75f), 0.5f, 0.5f);
+				pixel[x + y * xres + 3 + xres * 3] =
+				    mix_argb(mix_argb(c1, c2, 0.25f, 0.75f), mix_argb(c3, c4, 0.25f, 0.75f), 0.25f, 0.75f);
+			}
+		}
+		break;
+	default:
+		warn("Unsupported scale %d in sdl_smoothify()", scale);
+		break;
+	}
+}
+
+int do_smoothify(int sprite)
+{
+	// TODO: add more to this list
+	if (sprite >= 50 && sprite <= 56) {
+		return 0;
+	}
+	if (sprite > 0 && sprite <= 1000) {
+		return 1; // GUI
+	}
+	if (sprite >= 10000 && sprite < 11000) {
+		return 1; // items
+	}
+	if (sprite >= 11000 && sprite < 12000) {
+		return 1; // coffin, berries, farn, ...
+	}
+	if (sprite >= 13000 && sprite < 14000) {
+		return 1; // bones and towers, ...
+	}
+	if (sprite >= 16000 && sprite < 17000) {
+		return 1; // cameron doors, carts, ...
+	}
+	if (sprite >= 20025 && sprite < 20034) {
+		return 1; // torches
+	}
+	if (sprite >= 20042 && sprite < 20082) {
+		return 1; // torches
+	}
+	if (sprite >= 20086 && sprite < 20119) {
+		return 1; // chests, chairs
+	}
+
+	if (sprite >= 100000) {
+		return 1; // all character sprites
+	}
+
+	return 0;
+}
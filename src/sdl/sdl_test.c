@@ -18,9 +18,11 @@
 // Forward declarations for test-exposed functions
 extern SDL_AtomicInt worker_quit;
 extern SDL_Thread **worker_threads;
-extern struct zip_handles *worker_zips;
 extern int sdl_multi;
 extern SDL_Semaphore *prework;
+extern SDL_Semaphore *premade;
+
+zip_t *sdl_zip1 = NULL;
 
 // ============================================================================
 // State initialization helpers
@@ -87,15 +89,10 @@ int sdl_init_for_tests(void)
 	// Single-threaded mode
 	sdl_multi = 0;
 
-	// Open graphics ZIP files (needed for real I/O)
+	// Map graphics archives (needed for real I/O), libzip only lists the sprites for the tests
 	sdl_zip1 = zip_open("res/gx1.zip", ZIP_RDONLY, NULL);
-	sdl_zip1p = zip_open("res/gx1_patch.zip", ZIP_RDONLY, NULL);
-	sdl_zip1m = zip_open("res/gx1_mod.zip", ZIP_RDONLY, NULL);
-	sdl_zip2 = zip_open("res/gx2.zip", ZIP_RDONLY, NULL);
-	sdl_zip2p = zip_open("res/gx2_patch.zip", ZIP_RDONLY, NULL);
-	sdl_zip2m = zip_open("res/gx2_mod.zip", ZIP_RDONLY, NULL);
 
-	if (!sdl_zip1) {
+	if (!sdl_zip1 || sdl_gx_open(2) < 0) {
 		fprintf(stderr, "sdl_init_for_tests: Failed to open res/gx1.zip\n");
 		fprintf(stderr, "Make sure to run tests from repository root!\n");
 		return 0;
@@ -103,6 +100,7 @@ int sdl_init_for_tests(void)
 
 	// Initialize job queue
 	tex_jobs_init();
+	sdl_make_init();
 
 	// Create mutex for prefetch operations
 	premutex = SDL_CreateMutex();
@@ -119,6 +117,14 @@ int sdl_init_for_tests(void)
 		return 0;
 	}
 
+	premade = SDL_CreateSemaphore(0);
+	if (!premade) {
+		fprintf(stderr, "sdl_init_for_tests: SDL_CreateSemaphore failed: %s\n", SDL_GetError());
+		SDL_DestroySemaphore(prework);
+		SDL_DestroyMutex(premutex);
+		return 0;
+	}
+
 	SDL_SetAtomicInt(&worker_quit, 0);
 	worker_threads = NULL;
 
@@ -153,9 +159,6 @@ int sdl_init_for_tests_with_workers(int worker_count)
 		return 0;
 	}
 
-	// Don't allocate zip handles for tests - workers will use NULL
-	worker_zips = NULL;
-
 	SDL_SetAtomicInt(&worker_quit, 0);
 
 	for (i = 0; i < worker_count; i++) {
@@ -206,22 +209,10 @@ void sdl_shutdown_for_tests(void)
 	// Close ZIP files
 	if (sdl_zip1) {
 		zip_close(sdl_zip1);
+		sdl_zip1 = NULL;
 	}
-	if (sdl_zip1p) {
-		zip_close(sdl_zip1p);
-	}
-	if (sdl_zip1m) {
-		zip_close(sdl_zip1m);
-	}
-	if (sdl_zip2) {
-		zip_close(sdl_zip2);
-	}
-	if (sdl_zip2p) {
-		zip_close(sdl_zip2p);
-	}
-	if (sdl_zip2m) {
-		zip_close(sdl_zip2m);
-	}
+	sdl_gx_close();
+	sdl_make_exit();
 
 	// Shutdown job queue
 	tex_jobs_shutdown();
@@ -234,6 +225,10 @@ void sdl_shutdown_for_tests(void)
 		SDL_DestroySemaphore(prework);
 		prework = NULL;
 	}
+	if (premade) {
+		SDL_DestroySemaphore(premade);
+		premade = NULL;
+	}
 
 	SDL_Quit();
 }
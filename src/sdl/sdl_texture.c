@@ -201,7 +201,12 @@ static inline unsigned int hashfunc_text(const char *text, int color, int flags)
 }
 
 #ifdef UNIT_TEST
-// Test-only wrapper to expose hashfunc_text for distribution testing
+// Test-only wrappers to expose the hash functions for distribution testing and benchmarks
+unsigned int test_hashfunc(unsigned int sprite, int ml, int ll, int rl, int ul, int dl)
+{
+	return hashfunc(sprite, ml, ll, rl, ul, dl);
+}
+
 unsigned int test_hashfunc_text(const char *text, int color, int flags)
 {
 	return hashfunc_text(text, color, flags);
@@ -524,7 +529,7 @@ static int tex_entry_build_sprite(int cache_index, const struct tex_request *r,
 	int ntx;
 
 	if (r->preload != 1) {
-		if (sdl_ic_load(r->sprite, NULL) < 0) {
+		if (sdl_ic_load(r->sprite) < 0) {
 			return STX_NONE;
 		}
 	}
@@ -662,11 +667,7 @@ static int texcache_acquire_slot(void)
 			}
 		} else if (flags & SF_DIDALLOC) {
 			if (sdlt[cache_index].pixel) {
-#ifdef SDL_FAST_MALLOC
-				FREE(sdlt[cache_index].pixel);
-#else
-				xfree(sdlt[cache_index].pixel);
-#endif
+				sdl_pixel_free(sdlt[cache_index].pixel);
 				sdlt[cache_index].pixel = NULL;
 			}
 		}
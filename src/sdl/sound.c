@@ -10,6 +10,17 @@
  *   1. res/sx_mod.zip/sounds.json   (highest priority, overrides all)
  *   2. res/sx_patch.zip/sounds.json (overrides base)
  *   3. res/sx.zip/sounds.json       (base mappings)
+ *
+ * Startup only locates each mapped file in the archives. Sounds are decoded
+ * on first play, or earlier by the loader thread when prefetch() finds them
+ * in a queued tick. Decoded sounds stay in an LRU capped at
+ * SOUND_BANK_BUDGET bytes; files larger than SOUND_STREAM_SIZE (music,
+ * ambience loops) keep their compressed bytes and are decoded while playing.
+ *
+ * A sounds.json entry is either a path or {"path": ..., "priority": 0-9}.
+ * Built-in sounds compete for tracks by priority, loudness after distance
+ * attenuation and age; a burst of the same sound within one tick plays as
+ * one louder voice.
  */
 
 #include <stdio.h>
@@ -23,6 +34,7 @@
 #include "sdl/sdl.h"
 #include "sdl/sdl_private.h"
 #include "lib/cjson/cJSON.h"
+#include "game/profile.h"
 
 // Mod sound API data structures
 
@@ -34,10 +46,60 @@ static zip_t *sx_zip = NULL; // Base sounds (res/sx.zip)
 static zip_t *sx_patch_zip = NULL; // Patch sounds (res/sx_patch.zip)
 static zip_t *sx_mod_zip = NULL; // Mod sounds (res/sx_mod.zip)
 
-// Mod-loaded sounds (separate from built-in sound_effect[])
-static MIX_Audio *mod_sounds[MAX_MOD_SOUNDS];
+// Sound bank
+
+#define SOUND_BANK_BUDGET  (24 * 1024 * 1024) // decoded bytes kept in memory
+#define SOUND_STREAM_SIZE  (512 * 1024) // files larger than this are not predecoded
+#define SOUND_PREFETCH_MAX 16
+
+struct sound_entry {
+	zip_t *zip; // archive holding the file, NULL if unmapped or not found
+	zip_uint64_t index; // position in the archive's central directory
+	size_t size; // size of the file
+	MIX_Audio *audio; // NULL until first use
+	char *data; // file contents, kept as long as streamed audio exists
+	size_t bytes; // memory charged to the bank
+	uint64_t used; // bank_clock at last use, for the LRU
+	unsigned int gen; // bumped when the slot is freed, a running decode drops its result
+	unsigned int ms; // length in milliseconds, 0 if unknown
+	int queued; // waiting for the loader thread
+	int broken; // reading or decoding failed, don't retry
+};
+
+// Built-in sounds by ID, and mod-loaded sounds by handle
+static struct sound_entry sound_effect[MAXSOUND];
+static struct sound_entry mod_sounds[MAX_MOD_SOUNDS];
 static int mod_sound_count = 0;
 
+static struct sound_entry *track_entry[MAX_SOUND_CHANNELS]; // sound last started on each track
+static size_t bank_bytes = 0;
+static uint64_t bank_clock = 0;
+
+// bank_mutex guards the entries and the zip archives, which libzip doesn't share between threads
+static SDL_Mutex *bank_mutex = NULL;
+static SDL_Condition *bank_cond = NULL;
+static SDL_Thread *bank_thread = NULL;
+static struct sound_entry *prefetch_queue[SOUND_PREFETCH_MAX];
+static int prefetch_head = 0, prefetch_count = 0, bank_quit = 0;
+
+// Voices of built-in sounds, one per track
+
+#define SOUND_PRIO_DEFAULT 2
+#define SOUND_MIN_GAIN     0.02f // quieter sounds are dropped without taking a track
+#define SOUND_MERGE_GAIN   2.0f // loudest a merged burst of one sound may get
+
+struct voice {
+	struct sound_entry *e; // NULL if the track isn't playing a built-in sound
+	float prio; // priority from sounds.json
+	float audible; // master gain times distance attenuation
+	int merged; // number of plays merged into this voice
+	uint64_t start, end; // SDL_GetTicks() at start and estimated end, end 0 if unknown
+	int set; // the track has the values below
+	int distance, angle, volume, merged_set;
+};
+
+static struct voice voices[MAX_SOUND_CHANNELS];
+
 // Track state for channel queries
 typedef struct {
 	int in_use; // Is this channel currently playing?
@@ -58,6 +120,7 @@ static channel_state_t channel_states[MAX_SOUND_CHANNELS];
 
 // Mapping table: sound_id -> path string (NULL if not mapped)
 static char *sound_map[MAX_SOUND_ID];
+static unsigned char sound_prio[MAX_SOUND_ID];
 static int sound_map_loaded = 0;
 
 // Legacy fallback table for backwards compatibility (used if no sounds.json)
@@ -119,10 +182,6 @@ static int sfx_fallback_cnt = (int)(sizeof(sfx_fallback) / sizeof(sfx_fallback[0
 int sound_volume = 128;
 static uint64_t time_play_sound = 0;
 
-static MIX_Audio *sound_effect[MAXSOUND];
-
-MIX_Audio *load_sound_from_zip(zip_t *zip_archive, const char *filename);
-
 /**
  * Load a text file from a zip archive.
  * @return Allocated string (caller must free) or NULL on error.
@@ -188,14 +247,27 @@ static int load_sound_map_from_json(const char *json_str, const char *source_nam
 	cJSON *item;
 	cJSON_ArrayForEach(item, sounds)
 	{
-		if (!cJSON_IsString(item)) {
+		// Key is the sound ID as string, value is the path or an object with path and priority
+		const char *key = item->string;
+		const char *path = NULL;
+		int prio = SOUND_PRIO_DEFAULT;
+
+		if (cJSON_IsString(item)) {
+			path = item->valuestring;
+		} else if (cJSON_IsObject(item)) {
+			cJSON *p = cJSON_GetObjectItem(item, "path");
+			cJSON *pr = cJSON_GetObjectItem(item, "priority");
+			if (cJSON_IsString(p)) {
+				path = p->valuestring;
+			}
+			if (cJSON_IsNumber(pr)) {
+				prio = min(max(pr->valueint, 0), 9);
+			}
+		}
+		if (!path) {
 			continue;
 		}
 
-		// Key is the sound ID as string, value is the path
-		const char *key = item->string;
-		const char *path = item->valuestring;
-
 		int id = atoi(key);
 		if (id < 0 || id >= MAX_SOUND_ID) {
 			warn("%s: sound ID %d out of range (0-%d)", source_name, id, MAX_SOUND_ID - 1);
@@ -211,6 +283,7 @@ static int load_sound_map_from_json(const char *json_str, const char *source_nam
 		size_t path_len = strlen(path) + 1;
 		sound_map[id] = xmalloc(path_len, MEM_GLOB);
 		memcpy(sound_map[id], path, path_len);
+		sound_prio[id] = (unsigned char)prio;
 		count++;
 	}
 
@@ -276,6 +349,7 @@ static void load_sound_mappings(void)
 				size_t len = strlen(sfx_fallback[i]) + 1;
 				sound_map[i] = xmalloc(len, MEM_GLOB);
 				memcpy(sound_map[i], sfx_fallback[i], len);
+				sound_prio[i] = SOUND_PRIO_DEFAULT;
 			}
 		}
 	}
@@ -309,15 +383,279 @@ static void free_sound_mappings(void)
 	sound_map_loaded = 0;
 }
 
+/**
+ * Find a sound file in the archives without reading it.
+ * Search order: sx_mod.zip -> sx_patch.zip -> sx.zip
+ * @return 0 on success, -1 if not found
+ */
+static int bank_locate(struct sound_entry *e, const char *path)
+{
+	zip_t *zips[3] = {sx_mod_zip, sx_patch_zip, sx_zip};
+	zip_stat_t stat;
+
+	for (int i = 0; i < 3; i++) {
+		if (!zips[i]) {
+			continue;
+		}
+		zip_int64_t idx = zip_name_locate(zips[i], path, 0);
+		if (idx < 0) {
+			continue;
+		}
+		if (zip_stat_index(zips[i], (zip_uint64_t)idx, 0, &stat) != 0 || !(stat.valid & ZIP_STAT_SIZE)) {
+			continue;
+		}
+		if (stat.size > INT_MAX) {
+			warn("Sound file %s is too large.", path);
+			return -1;
+		}
+		e->zip = zips[i];
+		e->index = (zip_uint64_t)idx;
+		e->size = (size_t)stat.size;
+		e->broken = 0;
+		return 0;
+	}
+
+	return -1;
+}
+
+// Read the file of e into memory, called with bank_mutex held
+static char *bank_read(struct sound_entry *e)
+{
+	zip_file_t *zip_file;
+	char *buffer;
+
+	zip_file = zip_fopen_index(e->zip, e->index, 0);
+	if (!zip_file) {
+		return NULL;
+	}
+
+	buffer = xmalloc(e->size, MEM_TEMP6);
+	if ((zip_uint64_t)zip_fread(zip_file, buffer, e->size) != e->size) {
+		zip_fclose(zip_file);
+		xfree(buffer);
+		return NULL;
+	}
+	zip_fclose(zip_file);
+
+	return buffer;
+}
+
+/**
+ * Read and decode one sound. Called with bank_mutex held, which is dropped
+ * while decoding so the other thread can keep playing loaded sounds.
+ */
+static void bank_load(struct sound_entry *e)
+{
+	unsigned int gen = e->gen, ms = 0;
+	size_t size = e->size, bytes = 0;
+	int stream = size > SOUND_STREAM_SIZE;
+	SDL_IOStream *rw;
+	SDL_AudioSpec spec;
+	MIX_Audio *audio = NULL;
+	Sint64 frames;
+	char *data;
+
+	data = bank_read(e);
+	if (!data) {
+		warn("Could not read sound file %s from archive.", zip_get_name(e->zip, e->index, 0));
+		e->broken = 1;
+		return;
+	}
+
+	SDL_UnlockMutex(bank_mutex);
+
+	// predecode=false keeps reading from data while the sound plays, closeio=true frees the IOStream
+	rw = SDL_IOFromConstMem(data, size);
+	if (rw) {
+		audio = MIX_LoadAudio_IO(NULL, rw, !stream, true);
+	}
+	if (audio) {
+		// predecoded audio is kept as float samples
+		frames = MIX_GetAudioDuration(audio);
+		if (frames >= 0 && MIX_GetAudioFormat(audio, &spec) && spec.freq > 0) {
+			ms = (unsigned int)(frames * 1000 / spec.freq) + 1;
+			bytes = (size_t)frames * (size_t)spec.channels * sizeof(float);
+		} else {
+			bytes = size * 2; // 16 bit WAV data as float
+		}
+		if (stream) {
+			bytes = size;
+		}
+	}
+	if (!stream || !audio) {
+		xfree(data);
+		data = NULL;
+	}
+
+	SDL_LockMutex(bank_mutex);
+
+	if (e->gen != gen || e->audio) { // unloaded, or loaded by the other thread meanwhile
+		if (audio) {
+			MIX_DestroyAudio(audio);
+		}
+		xfree(data);
+		return;
+	}
+	if (!audio) {
+		warn("Could not decode sound file %s: %s", zip_get_name(e->zip, e->index, 0), SDL_GetError());
+		e->broken = 1;
+		return;
+	}
+
+	e->audio = audio;
+	e->data = data;
+	e->bytes = bytes;
+	e->ms = ms;
+	bank_bytes += bytes;
+}
+
+// Destroy the audio of e, the caller makes sure no track plays it
+static void bank_drop(struct sound_entry *e)
+{
+	if (e->audio) {
+		MIX_DestroyAudio(e->audio);
+		e->audio = NULL;
+	}
+	xfree(e->data);
+	e->data = NULL;
+	bank_bytes -= e->bytes;
+	e->bytes = 0;
+}
+
+// Forget the sound in slot e, called with bank_mutex held
+static void bank_free(struct sound_entry *e)
+{
+	unsigned int gen = e->gen;
+
+	bank_drop(e);
+	memset(e, 0, sizeof(*e));
+	e->gen = gen + 1;
+}
+
+static int bank_busy(struct sound_entry *e)
+{
+	for (int i = 0; i < MAX_SOUND_CHANNELS; i++) {
+		if (track_entry[i] == e && sdl_tracks[i] && MIX_TrackPlaying(sdl_tracks[i])) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Evict least recently used sounds until the bank fits its budget, main thread only
+static void bank_trim(struct sound_entry *keep)
+{
+	while (bank_bytes > SOUND_BANK_BUDGET) {
+		struct sound_entry *best = NULL;
+
+		for (int i = 1; i < MAXSOUND + MAX_MOD_SOUNDS; i++) {
+			struct sound_entry *e = i < MAXSOUND ? &sound_effect[i] : &mod_sounds[i - MAXSOUND];
+			if (e == keep || !e->audio || (best && e->used >= best->used) || bank_busy(e)) {
+				continue;
+			}
+			best = e;
+		}
+		if (!best) {
+			break; // everything left is playing
+		}
+		bank_drop(best);
+	}
+}
+
+// Return the audio of e, decoding it first if needed, main thread only
+static MIX_Audio *bank_get(struct sound_entry *e)
+{
+	MIX_Audio *audio;
+
+	SDL_LockMutex(bank_mutex);
+	if (!e->audio && e->zip && !e->broken) {
+		bank_load(e);
+	}
+	e->used = ++bank_clock;
+	audio = e->audio;
+	bank_trim(e);
+	SDL_UnlockMutex(bank_mutex);
+
+	return audio;
+}
+
+static int bank_worker(void *data __attribute__((unused)))
+{
+	struct sound_entry *e;
+
+	prof_thread_name("sound loader");
+
+	SDL_LockMutex(bank_mutex);
+	while (1) {
+		while (!prefetch_count && !bank_quit) {
+			SDL_WaitCondition(bank_cond, bank_mutex);
+		}
+		if (bank_quit) {
+			break;
+		}
+		e = prefetch_queue[prefetch_head];
+		prefetch_head = (prefetch_head + 1) % SOUND_PREFETCH_MAX;
+		prefetch_count--;
+
+		e->queued = 0;
+		if (!e->audio && e->zip && !e->broken) {
+			bank_load(e);
+		}
+	}
+	SDL_UnlockMutex(bank_mutex);
+
+	return 0;
+}
+
+/**
+ * Decode a built-in sound in the background, ahead of play_sound().
+ * Called by prefetch() for sounds in queued ticks.
+ */
+void sound_prefetch(unsigned int nr)
+{
+	struct sound_entry *e;
+
+	if (!(game_options & GO_SOUND) || !bank_cond) {
+		return;
+	}
+
+	if (nr < 1U || nr >= (unsigned int)MAXSOUND) {
+		return;
+	}
+	e = &sound_effect[nr];
+
+	SDL_LockMutex(bank_mutex);
+	if (e->audio || e->queued || !e->zip || e->broken || prefetch_count == SOUND_PREFETCH_MAX) {
+		SDL_UnlockMutex(bank_mutex);
+		return;
+	}
+	if (!bank_thread) {
+		bank_thread = SDL_CreateThread(bank_worker, "sound loader", NULL);
+		if (!bank_thread) {
+			warn("Could not start sound loader thread: %s", SDL_GetError());
+			SDL_DestroyCondition(bank_cond); // play_sdl_sound() still decodes on first use
+			bank_cond = NULL;
+			SDL_UnlockMutex(bank_mutex);
+			return;
+		}
+	}
+	e->used = bank_clock;
+	e->queued = 1;
+	prefetch_queue[(prefetch_head + prefetch_count) % SOUND_PREFETCH_MAX] = e;
+	prefetch_count++;
+	SDL_SignalCondition(bank_cond);
+	SDL_UnlockMutex(bank_mutex);
+}
+
 int init_sound(void)
 {
-	int err;
+	int err, cnt = 0;
 
 	if (!(game_options & GO_SOUND)) {
 		return -1;
 	}
 
-	// Open sound zip archives (keep open for mod sound loading)
+	// Open sound zip archives (keep open for sound loading)
 	// Base sounds - required
 	sx_zip = zip_open("res/sx.zip", ZIP_RDONLY, &err);
 	if (!sx_zip) {
@@ -340,97 +678,72 @@ int init_sound(void)
 	// Load sound ID mappings from sounds.json files
 	load_sound_mappings();
 
-	// Pre-load all mapped sound effects
+	// Locate all mapped sound effects, they are decoded on first use. No lock
+	// needed, the loader thread is only started by the first sound_prefetch()
 	for (int i = 1; i < MAXSOUND && i < MAX_SOUND_ID; i++) {
 		const char *path = get_sound_path(i);
-		if (path) {
-			// Try to load from all zips (mod -> patch -> base)
-			MIX_Audio *audio = NULL;
-			if (sx_mod_zip) {
-				audio = load_sound_from_zip(sx_mod_zip, path);
-			}
-			if (!audio && sx_patch_zip) {
-				audio = load_sound_from_zip(sx_patch_zip, path);
-			}
-			if (!audio && sx_zip) {
-				audio = load_sound_from_zip(sx_zip, path);
-			}
-			sound_effect[i] = audio;
+		if (path && bank_locate(&sound_effect[i], path) == 0) {
+			cnt++;
+		}
+	}
+	note("Indexed %d sound effects", cnt);
+
+	bank_mutex = SDL_CreateMutex();
+	bank_cond = SDL_CreateCondition();
+	if (!bank_mutex || !bank_cond) {
+		warn("Could not create sound loader lock: %s", SDL_GetError());
+		if (bank_cond) {
+			SDL_DestroyCondition(bank_cond);
+			bank_cond = NULL;
+		}
+		if (bank_mutex) {
+			SDL_DestroyMutex(bank_mutex);
+			bank_mutex = NULL;
 		}
 	}
 
 	return 0;
 }
 
-MIX_Audio *load_sound_from_zip(zip_t *zip_archive, const char *filename)
+void sound_exit(void)
 {
-	zip_stat_t stat;
-	zip_file_t *zip_file;
-	char *buffer;
-	zip_uint64_t len;
-	SDL_IOStream *rw;
-	MIX_Audio *audio;
-
-	if (!zip_archive || !filename) {
-		return NULL;
-	}
-
-	// Get file stats from zip - silent on not found (we try multiple zips)
-	if (zip_stat(zip_archive, filename, 0, &stat) != 0 || !(stat.valid & ZIP_STAT_SIZE)) {
-		return NULL;
-	}
-	len = stat.size;
-	if (len > INT_MAX) {
-		warn("Sound file %s is too large.", filename);
-		return NULL;
-	}
-
-	// Open file in zip
-	zip_file = zip_fopen(zip_archive, filename, 0);
-	if (!zip_file) {
-		return NULL;
-	}
+	int i;
 
-	// Allocate buffer and read file data
-	buffer = xmalloc(len, MEM_TEMP6);
-	if ((zip_uint64_t)zip_fread(zip_file, buffer, len) != len) {
-		warn("Could not read sound file %s from archive.", filename);
-		zip_fclose(zip_file);
-		xfree(buffer);
-		return NULL;
+	if (bank_thread) {
+		SDL_LockMutex(bank_mutex);
+		bank_quit = 1;
+		SDL_SignalCondition(bank_cond);
+		SDL_UnlockMutex(bank_mutex);
+		SDL_WaitThread(bank_thread, NULL);
+		bank_thread = NULL;
 	}
-	zip_fclose(zip_file);
 
-	// Create an SDL_IOStream from the memory buffer
-	rw = SDL_IOFromConstMem(buffer, (size_t)len);
-	if (!rw) {
-		warn("Could not create SDL_IOStream for sound %s.", filename);
-		xfree(buffer);
-		return NULL;
+	// Streamed sounds read from their data while playing
+	for (i = 0; i < MAX_SOUND_CHANNELS; i++) {
+		if (sdl_tracks[i]) {
+			MIX_StopTrack(sdl_tracks[i], 0);
+		}
+		track_entry[i] = NULL;
 	}
-
-	// Load WAV from the IOStream
-	// mixer=NULL means use first created mixer, predecode=true loads fully into memory, closeio=true frees the IOStream
-	audio = MIX_LoadAudio_IO(NULL, rw, true, true);
-	xfree(buffer); // Free the original buffer to prevent a memory leak.
-
-	return audio;
-}
-
-void sound_exit(void)
-{
-	int i;
+	memset(voices, 0, sizeof(voices));
 
 	// Cleanup mod sounds first
 	sound_cleanup_mod_sounds();
 
 	// Free all built-in sound effects
 	for (i = 1; i < MAXSOUND; i++) {
-		if (sound_effect[i]) {
-			MIX_DestroyAudio(sound_effect[i]);
-			sound_effect[i] = NULL;
-		}
+		bank_free(&sound_effect[i]);
+	}
+
+	if (bank_cond) {
+		SDL_DestroyCondition(bank_cond);
+		bank_cond = NULL;
+	}
+	if (bank_mutex) {
+		SDL_DestroyMutex(bank_mutex);
+		bank_mutex = NULL;
 	}
+	prefetch_head = prefetch_count = bank_quit = 0;
 
 	// Free sound ID mappings
 	free_sound_mappings();
@@ -452,12 +765,81 @@ void sound_exit(void)
 	return;
 }
 
-static void play_sdl_sound(unsigned int nr, int distance, int angle);
+// Track i is held by the mod API
+static int voice_reserved(int i)
+{
+	if (!channel_states[i].in_use) {
+		return 0;
+	}
+	if (channel_states[i].looping || MIX_TrackPlaying(sdl_tracks[i])) {
+		return 1;
+	}
+	channel_states[i].in_use = 0;
+	return 0;
+}
+
+static int voice_active(int i, uint64_t now)
+{
+	if (!voices[i].e) {
+		return 0;
+	}
+	if (voices[i].end) {
+		return now < voices[i].end;
+	}
+	return MIX_TrackPlaying(sdl_tracks[i]);
+}
+
+// Worth of keeping a voice: priority times loudness, fading with age
+static float voice_score(const struct voice *v, uint64_t now)
+{
+	float age = (float)(now - v->start) / 1000.0f;
+
+	return ((float)v->prio + 1.0f) * v->audible * (float)v->merged / (1.0f + age);
+}
+
+// Set position and gain of track i, skipping the mixer calls if they didn't change
+static void voice_set(int i, int distance, int angle)
+{
+	struct voice *v = &voices[i];
+	MIX_Track *track = sdl_tracks[i];
+
+	if (!v->set || v->distance != distance || v->angle != angle) {
+		// Convert angle/distance to 3D position for SDL3_mixer
+		// SDL2_mixer used angle (degrees) and distance (0-255)
+		// SDL3_mixer uses 3D coordinates via MIX_Point3D struct
+		const float radians = (float)angle * (SDL_PI_F / 180.0f);
+		const float f_dist = (float)distance / 255.0f; // Normalize to 0.0-1.0
+		MIX_Point3D position = {.x = SDL_cosf(radians) * f_dist,
+		    .y = 0.0f, // Keep vertically centered
+		    .z = SDL_sinf(radians) * f_dist};
+
+		MIX_SetTrack3DPosition(track, &position);
+		v->distance = distance;
+		v->angle = angle;
+	}
+
+	if (!v->set || v->volume != sound_volume || v->merged_set != v->merged) {
+		// Note: sound_volume is an int (0 to -128) for backwards compatibility with the server protocol.
+		// 0 = maximum volume (gain 1.0), -128 = silence (gain 0.0)
+		// Convert from negative attenuation to positive gain: gain = 1.0 + (sound_volume / 128.0)
+		// A merged burst gets louder with the square root of its size
+		float gain = 1.0f + ((float)sound_volume / 128.0f);
+		MIX_SetTrackGain(track, gain * min(SDL_sqrtf((float)v->merged), SOUND_MERGE_GAIN));
+		v->volume = sound_volume;
+		v->merged_set = v->merged;
+	}
+
+	v->set = 1;
+}
 
 static void play_sdl_sound(unsigned int nr, int distance, int angle)
 {
-	static int sound_channel = 0;
-	uint64_t time_start;
+	uint64_t time_start, now;
+	struct sound_entry *e;
+	struct voice *v;
+	MIX_Audio *audio;
+	int i, best = -1, best_free = 0;
+	float low = 0.0f;
 
 	// Check if sound is enabled
 	if (!(game_options & GO_SOUND)) {
@@ -468,53 +850,82 @@ static void play_sdl_sound(unsigned int nr, int distance, int angle)
 		return;
 	}
 
-	if (!sound_effect[nr]) {
-		return; // Audio not loaded
-	}
-
 	// For debugging/optimization
-	time_start = SDL_GetTicks();
+	time_start = now = SDL_GetTicks();
 
 #if 0
 	const char *path = get_sound_path(nr);
 	note("nr = %d: %s, distance = %d, angle = %d", nr, path ? path : "(unmapped)", distance, angle);
 #endif
 
-	// Get the track for this channel
-	MIX_Track *track = sdl_tracks[sound_channel];
-	if (!track) {
-		warn("Track %d is NULL - audio system not initialized correctly", sound_channel);
+	// master gain as in voice_set(), attenuated by distance
+	float gain = 1.0f + ((float)sound_volume / 128.0f);
+	float audible = gain * (1.0f - (float)distance / 255.0f);
+
+	if (audible < SOUND_MIN_GAIN) {
+		return; // inaudible, don't spend a track or a decode on it
+	}
+
+	e = &sound_effect[nr];
+
+	// The same sound again within one tick: make the running voice louder instead
+	for (i = 0; i < MAX_SOUND_CHANNELS; i++) {
+		v = &voices[i];
+		if (v->e != e || now - v->start >= MPT || !voice_active(i, now)) {
+			continue;
+		}
+		v->merged++;
+		if (audible > v->audible) { // follow the closest source
+			v->audible = audible;
+			voice_set(i, distance, angle);
+		} else {
+			voice_set(i, v->distance, v->angle);
+		}
+		time_play_sound += SDL_GetTicks() - time_start;
 		return;
 	}
 
-	// Convert angle/distance to 3D position for SDL3_mixer
-	// SDL2_mixer used angle (degrees) and distance (0-255)
-	// SDL3_mixer uses 3D coordinates via MIX_Point3D struct
-	const float radians = (float)angle * (SDL_PI_F / 180.0f);
-	const float f_dist = (float)distance / 255.0f; // Normalize to 0.0-1.0
-	MIX_Point3D position = {.x = SDL_cosf(radians) * f_dist,
-	    .y = 0.0f, // Keep vertically centered
-	    .z = SDL_sinf(radians) * f_dist};
+	// Pick a free track, or the voice least worth keeping
+	for (i = 0; i < MAX_SOUND_CHANNELS; i++) {
+		if (!sdl_tracks[i] || voice_reserved(i)) {
+			continue;
+		}
+		if (!voice_active(i, now)) {
+			best = i;
+			best_free = 1;
+			break;
+		}
+		float score = voice_score(&voices[i], now);
+		if (best == -1 || score < low) {
+			best = i;
+			low = score;
+		}
+	}
+	if (best == -1 || (!best_free && ((float)sound_prio[nr] + 1.0f) * audible <= low)) {
+		return; // every track is busy with something more important
+	}
+
+	audio = bank_get(e);
+	if (!audio) {
+		return; // Unmapped or failed to load
+	}
 
-	// Set 3D position
-	MIX_SetTrack3DPosition(track, &position);
+	MIX_Track *track = sdl_tracks[best];
 
-	// Set volume gain
-	// Note: sound_volume is an int (0 to -128) for backwards compatibility with the server protocol.
-	// 0 = maximum volume (gain 1.0), -128 = silence (gain 0.0)
-	// Convert from negative attenuation to positive gain: gain = 1.0 + (sound_volume / 128.0)
-	float gain = 1.0f + ((float)sound_volume / 128.0f);
-	MIX_SetTrackGain(track, gain);
+	v = &voices[best];
+	v->merged = 1;
+	voice_set(best, distance, angle);
 
 	// Assign the audio to the track and play it
-	MIX_SetTrackAudio(track, sound_effect[nr]);
+	MIX_SetTrackAudio(track, audio);
 	MIX_PlayTrack(track, 0); // 0 means use default properties
+	track_entry[best] = e;
 
-	// Increment sound channel so the next sound played is on its own layer
-	sound_channel++;
-	if (sound_channel >= MAX_SOUND_CHANNELS) {
-		sound_channel = 0;
-	}
+	v->e = e;
+	v->prio = (float)sound_prio[nr];
+	v->audible = audible;
+	v->start = now;
+	v->end = e->ms ? now + e->ms : 0;
 
 	// For debug/optimization
 	time_play_sound += SDL_GetTicks() - time_start;
@@ -569,36 +980,13 @@ void play_sound(unsigned int nr, int vol, int p)
 // Mod sound API implementation
 
 /**
- * Try to load a sound from a zip archive.
- * @param zip_archive  The zip archive to search
- * @param path         Path within the archive
- * @return             MIX_Audio* on success, NULL if not found
- */
-static MIX_Audio *try_load_sound_from_zip(zip_t *zip_archive, const char *path)
-{
-	if (!zip_archive) {
-		return NULL;
-	}
-
-	// Check if file exists in this archive
-	zip_stat_t stat;
-	if (zip_stat(zip_archive, path, 0, &stat) != 0) {
-		return NULL; // File not found in this archive
-	}
-
-	return load_sound_from_zip(zip_archive, path);
-}
-
-/**
- * Load a sound effect from zip archives.
+ * Load a sound effect from zip archives. The file is decoded on first play.
  * Search order: sx_mod.zip -> sx_patch.zip -> sx.zip
  * @param path   Path to sound file within zip (e.g., "weather/rain_loop.ogg")
  * @return       Sound handle (>0) on success, 0 on failure
  */
 int sound_load(const char *path)
 {
-	MIX_Audio *audio = NULL;
-
 	if (!path || !path[0]) {
 		warn("sound_load: NULL or empty path");
 		return 0;
@@ -609,38 +997,26 @@ int sound_load(const char *path)
 		return 0;
 	}
 
-	// Search for sound in zip archives (priority: mod > patch > base)
-	// 1. Try sx_mod.zip first (mod additions)
-	audio = try_load_sound_from_zip(sx_mod_zip, path);
-
-	// 2. Try sx_patch.zip (patches/overrides)
-	if (!audio) {
-		audio = try_load_sound_from_zip(sx_patch_zip, path);
-	}
-
-	// 3. Fall back to sx.zip (base sounds)
-	if (!audio) {
-		audio = try_load_sound_from_zip(sx_zip, path);
-	}
-
-	if (!audio) {
-		warn("sound_load: Could not find '%s' in any sound archive", path);
-		return 0;
-	}
-
-	// Find a free slot (start at 1, slot 0 is reserved for "invalid")
+	// Find a free slot (start at 1, slot 0 is reserved for "invalid"). The
+	// loader thread may be reading the archives, libzip needs bank_mutex
+	SDL_LockMutex(bank_mutex);
 	for (int i = 1; i < MAX_MOD_SOUNDS; i++) {
-		if (!mod_sounds[i]) {
-			mod_sounds[i] = audio;
+		if (!mod_sounds[i].zip) {
+			if (bank_locate(&mod_sounds[i], path) < 0) {
+				SDL_UnlockMutex(bank_mutex);
+				warn("sound_load: Could not find '%s' in any sound archive", path);
+				return 0;
+			}
 			if (i >= mod_sound_count) {
 				mod_sound_count = i + 1;
 			}
+			SDL_UnlockMutex(bank_mutex);
 			return i; // Return handle (1-based index)
 		}
 	}
+	SDL_UnlockMutex(bank_mutex);
 
 	// Should not reach here if count check passed, but be safe
-	MIX_DestroyAudio(audio);
 	warn("sound_load: No free slots available");
 	return 0;
 }
@@ -655,15 +1031,22 @@ void sound_unload(int handle)
 		return;
 	}
 
-	if (mod_sounds[handle]) {
+	if (mod_sounds[handle].zip) {
 		// Stop any channels playing this sound
 		for (int i = 0; i < MAX_SOUND_CHANNELS; i++) {
 			if (channel_states[i].in_use && channel_states[i].sound_handle == handle) {
 				sound_stop(i + 1); // Channel IDs are 1-based
 			}
+			if (track_entry[i] == &mod_sounds[handle]) {
+				if (sdl_tracks[i]) {
+					MIX_StopTrack(sdl_tracks[i], 0);
+				}
+				track_entry[i] = NULL;
+			}
 		}
-		MIX_DestroyAudio(mod_sounds[handle]);
-		mod_sounds[handle] = NULL;
+		SDL_LockMutex(bank_mutex);
+		bank_free(&mod_sounds[handle]);
+		SDL_UnlockMutex(bank_mutex);
 	}
 }
 
@@ -687,12 +1070,15 @@ static int sound_play_internal(int handle, float volume, int loop)
 	}
 
 	// Validate handle
-	if (handle < 1 || handle >= MAX_MOD_SOUNDS || !mod_sounds[handle]) {
+	if (handle < 1 || handle >= MAX_MOD_SOUNDS || !mod_sounds[handle].zip) {
 		warn("sound_play: Invalid sound handle %d", handle);
 		return 0;
 	}
 
-	audio = mod_sounds[handle];
+	audio = bank_get(&mod_sounds[handle]);
+	if (!audio) {
+		return 0;
+	}
 
 	// Find a free channel or use round-robin
 	channel = next_channel;
@@ -717,6 +1103,8 @@ static int sound_play_internal(int handle, float volume, int loop)
 	if (channel_states[channel].in_use) {
 		MIX_StopTrack(track, 0); // 0 = immediate stop (no fade)
 	}
+	voices[channel].e = NULL;
+	voices[channel].set = 0; // the mod API sets its own gain
 
 	// Clamp volume
 	if (volume < 0.0f) {
@@ -739,6 +1127,7 @@ static int sound_play_internal(int handle, float volume, int loop)
 
 	// Play the track
 	MIX_PlayTrack(track, 0);
+	track_entry[channel] = &mod_sounds[handle];
 
 	// Update channel state
 	channel_states[channel].in_use = 1;
@@ -1001,12 +1390,11 @@ void sound_cleanup_mod_sounds(void)
 	sound_stop_all();
 
 	// Free all mod sounds
+	SDL_LockMutex(bank_mutex);
 	for (int i = 1; i < MAX_MOD_SOUNDS; i++) {
-		if (mod_sounds[i]) {
-			MIX_DestroyAudio(mod_sounds[i]);
-			mod_sounds[i] = NULL;
-		}
+		bank_free(&mod_sounds[i]);
 	}
+	SDL_UnlockMutex(bank_mutex);
 	mod_sound_count = 0;
 
 	// Reset channel states
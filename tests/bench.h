@@ -0,0 +1,46 @@
+/*
+ * Minimal micro-benchmark harness - shared between the benchmark sources
+ *
+ * Usage:
+ *   static void bench_my_func(int iters)
+ *   {
+ *       for (int i = 0; i < iters; i++) {
+ *           bench_sink += my_func(i);
+ *       }
+ *   }
+ *
+ *   bench_run("my_func", bench_my_func, 100000);
+ *
+ * bench_run() warms up, repeats the function and records ns per iteration.
+ * Results are reported as median / p10 / p90 / min.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+typedef void (*bench_fn)(int iters);
+
+// Accumulate results here so the compiler can't drop the measured work
+extern volatile uint32_t bench_sink;
+
+void bench_run(const char *name, bench_fn fn, int iters);
+
+// Game-side benchmarks (bench_micro_game.c)
+void bench_game(void);
+
+// Seeded PRNG of bench_render.c, [0, n)
+int bench_rng(int n);
+
+// Render scenes (bench_render_game.c), frame counts from the first warm-up frame.
+// scene_init() returns 0 if there are too few sprites to draw them.
+int scene_init(const unsigned int *sprites, int cnt);
+void scene_chat_add(int frame);
+void scene_map(int frame);
+void scene_chars(int frame);
+void scene_particles(int frame);
+void scene_chat(void);
+void scene_prefetch(int frame);
+
+#endif /* BENCH_H */
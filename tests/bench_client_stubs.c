@@ -0,0 +1,73 @@
+/*
+ * Benchmark stubs - GUI, sound and mod entry points of client.c / protocol.c
+ *
+ * client.c and protocol.c are linked as they are; what they call in gui/,
+ * the sound code and the mods does nothing here. The network layer is left
+ * to each benchmark. Shared by bench_micro and bench_tick.
+ */
+
+#include "../src/astonia.h"
+#include "../src/client/client.h"
+#include "../src/gui/gui.h"
+#include "../src/modder/modder.h"
+#include "../src/sdl/sdl.h"
+
+int sv_ver = 30;
+int nocut = 0, teleporter = 0, show_look = 0, show_tutor = 0, update_skltab = 0, playersprite_override = 0;
+char tutor_text[1024];
+
+int hover_capture_text(char *line __attribute__((unused)))
+{
+	return 0;
+}
+
+void hover_capture_tick(void)
+{
+}
+
+void hover_invalidate_inv(int slot __attribute__((unused)))
+{
+}
+
+void hover_invalidate_inv_delayed(int slot __attribute__((unused)))
+{
+}
+
+void hover_invalidate_con(int slot __attribute__((unused)))
+{
+}
+
+void minimap_clear(void)
+{
+}
+
+void play_sound(unsigned int nr __attribute__((unused)), int vol __attribute__((unused)), int p __attribute__((unused)))
+{
+}
+
+void sound_prefetch(unsigned int nr __attribute__((unused)))
+{
+}
+
+void sound_fade_tick(void)
+{
+}
+
+void amod_areachange(void)
+{
+}
+
+int amod_is_playersprite(int sprite __attribute__((unused)))
+{
+	return 0;
+}
+
+int amod_process(const unsigned char *buf __attribute__((unused)))
+{
+	return 0;
+}
+
+int amod_prefetch(const unsigned char *buf __attribute__((unused)))
+{
+	return 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * Benchmark stubs - Screen layout behind game_core.c and render.c
+ *
+ * game_core.c and render.c are linked as they are; the map offsets and the
+ * GUI dots they read live in gui/, which the benchmarks don't link. Every dot
+ * sits at the top left corner. Shared by bench_render, bench_micro and
+ * bench_tick.
+ */
+
+#include "../src/astonia.h"
+#include "../src/game/game.h"
+#include "../src/gui/gui.h"
+
+int mapaddx = 0, mapaddy = 0;
+int __textdisplay_sy = 0;
+
+void mtos(unsigned int mapx, unsigned int mapy, int *scrx, int *scry)
+{
+	*scrx = (int)mapx * 20;
+	*scry = (int)mapy * 10;
+}
+
+void set_mapoff(int cx __attribute__((unused)), int cy __attribute__((unused)), int mdx __attribute__((unused)),
+    int mdy __attribute__((unused)))
+{
+}
+
+void set_mapadd(int addx __attribute__((unused)), int addy __attribute__((unused))) {}
+
+int dotx(int didx __attribute__((unused)))
+{
+	return 0;
+}
+
+int doty(int didx __attribute__((unused)))
+{
+	return 0;
+}
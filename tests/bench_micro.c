@@ -0,0 +1,429 @@
+/*
+ * Micro-benchmarks - Inner-loop client primitives
+ *
+ * Times the texture cache hashes and lookups, sdl_make(), sdl_smoothify() and
+ * sdl_colorize_pix2() on real sprites from res/gx1.zip. The game-side
+ * primitives (dl_qcmp sorting, sprite_config lookups) live in
+ * bench_micro_game.c.
+ *
+ * Each benchmark is warmed up, then repeated; median / p10 / p90 / min ns per
+ * iteration are printed to stderr and written as JSON. With --baseline, every
+ * result is compared against a previous JSON run and the exit code is 2 if
+ * any median got slower than --threshold percent. --offset skips that many
+ * usable sprites, so a run can pick its test sprites from a different part of
+ * the archive.
+ *
+ * Usage: bench_micro [--reps N] [--filter substr] [--offset N] [--out file] [--baseline file] [--threshold pct]
+ */
+
+#include "../src/astonia.h"
+#include "../src/sdl/sdl_private.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zip.h>
+
+#define MAX_RESULTS  64
+#define MAX_REPS     101
+#define SCAN_SPRITES 256 // candidates for the test sprites, taken in archive order
+
+struct result {
+	char name[48];
+	double median, p10, p90, min;
+};
+
+volatile uint32_t bench_sink;
+
+static struct result results[MAX_RESULTS];
+static int num_results = 0;
+static int reps = 15;
+static const char *filter = NULL;
+
+static unsigned int sprite_small, sprite_make; // smallest sprite and one close to character size
+static int sprite_offset = 0;
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+void bench_run(const char *name, bench_fn fn, int iters)
+{
+	double t[MAX_REPS];
+	struct result *r;
+
+	if (filter && !strstr(name, filter)) {
+		return;
+	}
+	if (num_results >= MAX_RESULTS) {
+		fprintf(stderr, "bench_micro: too many benchmarks, skipping %s\n", name);
+		return;
+	}
+
+	fn(iters); // warm-up: caches, branch predictors, lazy allocations
+	fn(iters);
+
+	for (int n = 0; n < reps; n++) {
+		uint64_t start = SDL_GetTicksNS();
+		fn(iters);
+		t[n] = (double)(SDL_GetTicksNS() - start) / iters;
+	}
+	qsort(t, (size_t)reps, sizeof(double), cmp_double);
+
+	r = &results[num_results++];
+	snprintf(r->name, sizeof(r->name), "%s", name);
+	r->median = t[reps / 2];
+	r->p10 = t[reps / 10];
+	r->p90 = t[(reps * 9) / 10];
+	r->min = t[0];
+
+	fprintf(stderr, "  %-32s %12.1f ns  (p10 %.1f, p90 %.1f)\n", r->name, r->median, r->p10, r->p90);
+}
+
+// ============================================================================
+// Texture cache hashes and lookups
+// ============================================================================
+
+static const char *chat_lines[] = {"Hello there!", "Player says: \"anyone selling a sword?\"",
+    "You have been hit for 12 points.", "Level up!", "Gold: 1234", "The door is locked.",
+    "Welcome to the Aston marketplace", "Mana", "Hitpoints", "Endurance", "Scroll of Recall", "42"};
+#define NUM_CHAT_LINES ((int)(sizeof(chat_lines) / sizeof(chat_lines[0])))
+
+static void bench_hashfunc(int iters)
+{
+	for (int i = 0; i < iters; i++) {
+		bench_sink += test_hashfunc((unsigned int)(i * 7919) % MAXSPRITE, i & 15, (i >> 4) & 15, 15, 15, 15);
+	}
+}
+
+static void bench_hashfunc_text(int iters)
+{
+	for (int i = 0; i < iters; i++) {
+		bench_sink += test_hashfunc_text(chat_lines[i % NUM_CHAT_LINES], 0x7fff, i & 7);
+	}
+}
+
+// Every filled key is the small sprite with a unique lighting combination
+static int texcache_filled = 0;
+
+static int texcache_key(int k, int checkonly)
+{
+	return sdl_tx_load(sprite_small, 0, 0, 100, 0, 0, 0, 0, 0, 0, 0, 0, 0, (char)(k & 15), (char)((k >> 4) & 15),
+	    (char)((k >> 8) & 15), (char)((k >> 12) & 15), 0, NULL, 0, 0, NULL, checkonly, 0);
+}
+
+static void texcache_fill(int entries)
+{
+	while (texcache_filled < entries) {
+		texcache_key(texcache_filled++, 0);
+	}
+}
+
+static void bench_texcache_hit(int iters)
+{
+	for (int i = 0; i < iters; i++) {
+		bench_sink += (uint32_t)texcache_key((i * 7919) % texcache_filled, 1);
+	}
+}
+
+static void bench_texcache_miss(int iters)
+{
+	for (int i = 0; i < iters; i++) {
+		bench_sink += (uint32_t)texcache_key(0x8000 + (i & 0x7fff), 1);
+	}
+}
+
+static void bench_texcache(void)
+{
+	static const int percent[] = {25, 50, 95};
+	char name[48];
+
+	for (int n = 0; n < (int)(sizeof(percent) / sizeof(percent[0])); n++) {
+		texcache_fill(MAX_TEXCACHE * percent[n] / 100);
+
+		snprintf(name, sizeof(name), "texcache_lookup_hit_%d%%", percent[n]);
+		bench_run(name, bench_texcache_hit, 100000);
+		snprintf(name, sizeof(name), "texcache_lookup_miss_%d%%", percent[n]);
+		bench_run(name, bench_texcache_miss, 100000);
+	}
+}
+
+// ============================================================================
+// Sprite processing
+// ============================================================================
+
+static struct sdl_texture make_st;
+
+static void make_setup(unsigned char scale, unsigned short c1, unsigned short c2, unsigned short c3, char ll)
+{
+	memset(&make_st, 0, sizeof(make_st));
+	make_st.sprite = sprite_make;
+	make_st.scale = scale;
+	make_st.c1 = c1;
+	make_st.c2 = c2;
+	make_st.c3 = c3;
+	make_st.ml = make_st.rl = make_st.ul = make_st.dl = 15;
+	make_st.ll = ll;
+
+	sdl_make(&make_st, &sdli[sprite_make], 1); // allocate once, benchmark only the pixel pass
+}
+
+static void make_teardown(void)
+{
+	sdl_pixel_free(make_st.pixel);
+	make_st.pixel = NULL;
+}
+
+static void bench_sdl_make(int iters)
+{
+	for (int i = 0; i < iters; i++) {
+		__atomic_fetch_and((uint16_t *)&make_st.flags, (uint16_t)~SF_DIDMAKE, __ATOMIC_RELAXED);
+		sdl_make(&make_st, &sdli[sprite_make], 2);
+		bench_sink += make_st.pixel[0];
+	}
+}
+
+static void bench_make(void)
+{
+	static const unsigned char scales[] = {50, 85, 100, 150};
+	char name[48];
+
+	for (int n = 0; n < (int)sizeof(scales); n++) {
+		make_setup(scales[n], 0, 0, 0, 15);
+		snprintf(name, sizeof(name), "sdl_make_scale_%d", scales[n]);
+		bench_run(name, bench_sdl_make, 20);
+		make_teardown();
+	}
+
+	make_setup(100, 0x7c00, 0x03e0, 0x001f, 15);
+	bench_run("sdl_make_colorized", bench_sdl_make, 20);
+	make_teardown();
+
+	make_setup(100, 0, 0, 0, 4);
+	bench_run("sdl_make_edge_light", bench_sdl_make, 20);
+	make_teardown();
+}
+
+static uint32_t smooth_buf[64 * 4 * 64 * 4];
+static int smooth_scale;
+
+static void bench_sdl_smoothify(int iters)
+{
+	for (int i = 0; i < iters; i++) {
+		sdl_smoothify(smooth_buf, 64 * smooth_scale, 64 * smooth_scale, smooth_scale);
+		bench_sink += smooth_buf[i & 63];
+	}
+}
+
+static void bench_smoothify(void)
+{
+	char name[48];
+
+	for (int n = 0; n < (int)(sizeof(smooth_buf) / sizeof(smooth_buf[0])); n++) {
+		smooth_buf[n] = (uint32_t)n * 2654435761u;
+	}
+	for (smooth_scale = 2; smooth_scale <= 4; smooth_scale++) {
+		snprintf(name, sizeof(name), "sdl_smoothify_x%d_64px", smooth_scale);
+		bench_run(name, bench_sdl_smoothify, 50);
+	}
+}
+
+static int colorize_sprite;
+
+static void bench_sdl_colorize_pix2(int iters)
+{
+	struct sdl_image *si = &sdli[sprite_make];
+	int size = si->xres * si->yres;
+
+	for (int i = 0; i < iters; i++) {
+		int p = i % size;
+		bench_sink += sdl_colorize_pix2(si->pixel[p], 0x7c00, 0x03e0, 0x001f, p % si->xres, p / si->xres, si->xres,
+		    si->yres, si->pixel, colorize_sprite);
+	}
+}
+
+static void bench_colorize(void)
+{
+	colorize_sprite = 1000; // below 220000: old algorithm
+	bench_run("sdl_colorize_pix2_old", bench_sdl_colorize_pix2, 100000);
+	colorize_sprite = 230000;
+	bench_run("sdl_colorize_pix2_new", bench_sdl_colorize_pix2, 100000);
+}
+
+// ============================================================================
+// Setup, output and baseline comparison
+// ============================================================================
+
+static int pick_sprites(void)
+{
+	zip_int64_t n = zip_get_num_entries(sdl_zip1, 0);
+	int found = 0, skip = sprite_offset, small_area = 0, make_diff = 0;
+
+	for (zip_int64_t i = 0; i < n && found < SCAN_SPRITES; i++) {
+		const char *name = zip_get_name(sdl_zip1, (zip_uint64_t)i, 0);
+		unsigned int nr;
+		int area, diff;
+
+		if (!name || sscanf(name, "%u.png", &nr) != 1 || nr >= MAXSPRITE) {
+			continue;
+		}
+		if (sdl_ic_load(nr) < 0 || sdli[nr].xres <= 0 || sdli[nr].yres <= 0) {
+			continue;
+		}
+		if (skip > 0) {
+			skip--;
+			continue;
+		}
+
+		area = sdli[nr].xres * sdli[nr].yres;
+		diff = abs(area - 64 * 96);
+		if (!found || area < small_area) {
+			sprite_small = nr;
+			small_area = area;
+		}
+		if (!found || diff < make_diff) {
+			sprite_make = nr;
+			make_diff = diff;
+		}
+		found++;
+	}
+
+	return found;
+}
+
+static void write_json(FILE *fp)
+{
+	fprintf(fp, "{\n  \"benchmark\": \"micro\",\n  \"reps\": %d,\n  \"results\": {\n", reps);
+	for (int n = 0; n < num_results; n++) {
+		fprintf(fp, "    \"%s\": {\"median_ns\": %.2f, \"p10_ns\": %.2f, \"p90_ns\": %.2f, \"min_ns\": %.2f}%s\n",
+		    results[n].name, results[n].median, results[n].p10, results[n].p90, results[n].min,
+		    n + 1 < num_results ? "," : "");
+	}
+	fprintf(fp, "  }\n}\n");
+}
+
+// Reads back the format written by write_json(). Returns the number of regressions.
+static int compare_baseline(const char *filename, double threshold)
+{
+	FILE *fp;
+	char *buf, key[64];
+	long size;
+	int regressions = 0;
+
+	fp = fopen(filename, "rb");
+	if (!fp) {
+		fprintf(stderr, "bench_micro: cannot read baseline %s\n", filename);
+		return 0;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	buf = calloc(1, (size_t)size + 1);
+	if (!buf || fread(buf, 1, (size_t)size, fp) != (size_t)size) {
+		fclose(fp);
+		free(buf);
+		return 0;
+	}
+	fclose(fp);
+
+	fprintf(stderr, "\n  %-32s %12s %12s %8s\n", "vs baseline", "before", "after", "change");
+	for (int n = 0; n < num_results; n++) {
+		const char *p;
+		double before, change;
+
+		snprintf(key, sizeof(key), "\"%s\": {\"median_ns\": ", results[n].name);
+		p = strstr(buf, key);
+		if (!p) {
+			fprintf(stderr, "  %-32s %12s %12.1f\n", results[n].name, "-", results[n].median);
+			continue;
+		}
+		before = strtod(p + strlen(key), NULL);
+		change = before > 0 ? (results[n].median - before) * 100.0 / before : 0;
+		fprintf(stderr, "  %-32s %12.1f %12.1f %+7.1f%%%s\n", results[n].name, before, results[n].median, change,
+		    change > threshold ? "  REGRESSION" : "");
+		if (change > threshold) {
+			regressions++;
+		}
+	}
+	free(buf);
+
+	return regressions;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *out = NULL, *baseline = NULL;
+	double threshold = 10.0;
+	int regressions = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--reps") && i + 1 < argc) {
+			reps = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+			filter = argv[++i];
+		} else if (!strcmp(argv[i], "--offset") && i + 1 < argc) {
+			sprite_offset = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+			out = argv[++i];
+		} else if (!strcmp(argv[i], "--baseline") && i + 1 < argc) {
+			baseline = argv[++i];
+		} else if (!strcmp(argv[i], "--threshold") && i + 1 < argc) {
+			threshold = atof(argv[++i]);
+		} else {
+			fprintf(stderr,
+			    "usage: %s [--reps N] [--filter substr] [--offset N] [--out file] [--baseline file] "
+			    "[--threshold pct]\n",
+			    argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (reps < 1 || reps > MAX_REPS) {
+		fprintf(stderr, "bench_micro: --reps must be 1..%d\n", MAX_REPS);
+		return EXIT_FAILURE;
+	}
+
+	if (!sdl_init_for_tests()) {
+		return EXIT_FAILURE;
+	}
+	if (!pick_sprites()) {
+		fprintf(stderr, "bench_micro: no usable sprites in res/gx1.zip\n");
+		sdl_shutdown_for_tests();
+		return EXIT_FAILURE;
+	}
+
+	fprintf(stderr, "bench_micro: %d reps, sprites %u (%dx%d) and %u (%dx%d)\n", reps, sprite_make,
+	    sdli[sprite_make].xres, sdli[sprite_make].yres, sprite_small, sdli[sprite_small].xres,
+	    sdli[sprite_small].yres);
+
+	bench_run("hashfunc", bench_hashfunc, 1000000);
+	bench_run("hashfunc_text", bench_hashfunc_text, 1000000);
+	bench_make();
+	bench_smoothify();
+	bench_colorize();
+	bench_game();
+	bench_texcache(); // last, it fills the cache
+
+	if (out) {
+		FILE *fp = fopen(out, "w");
+		if (fp) {
+			write_json(fp);
+			fclose(fp);
+		} else {
+			fprintf(stderr, "bench_micro: cannot write %s\n", out);
+		}
+	} else {
+		write_json(stdout);
+	}
+
+	if (baseline) {
+		regressions = compare_baseline(baseline, threshold);
+	}
+
+	sdl_shutdown_for_tests();
+
+	return regressions ? 2 : EXIT_SUCCESS;
+}
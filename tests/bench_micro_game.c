@@ -0,0 +1,308 @@
+/*
+ * Micro-benchmarks - Game-side primitives
+ *
+ * Display list sorting with dl_qcmp(), the sprite_config lookups behind
+ * trans_charno() / trans_asprite(), render_text_length() on the font tables
+ * of font.c and the sv_map01 / sv_map10 / sv_map11 decoders on fixed
+ * payloads. game_core.c, render.c, font.c, client.c and protocol.c are linked
+ * as they are; the screen layout is stubbed in bench_game_stubs.c, the GUI,
+ * sound and mods in bench_client_stubs.c and the network here.
+ */
+
+#include "../src/astonia.h"
+#include "../src/game/game.h"
+#include "../src/game/game_private.h"
+#include "../src/game/sprite_config.h"
+#include "../src/gui/gui.h"
+#include "../src/client/client.h"
+#include "../src/client/client_private.h"
+#include "../src/client/protocol.h"
+#include "astonia_net.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_DL    2500 // display list entries on a busy screen
+#define BENCH_TILES ((DIST_DEFAULT * 2 + 1) * (DIST_DEFAULT * 2 + 1))
+
+// ============================================================================
+// Stubs - network, client.c never gets to connect
+// ============================================================================
+
+astonia_sock *astonia_net_connect(const char *host __attribute__((unused)), uint16_t port __attribute__((unused)),
+    int timeout_ms __attribute__((unused)))
+{
+	return NULL;
+}
+
+int astonia_net_poll(astonia_sock *s __attribute__((unused)), int mask __attribute__((unused)),
+    int timeout_ms __attribute__((unused)))
+{
+	return -1;
+}
+
+ptrdiff_t astonia_net_recv(astonia_sock *s __attribute__((unused)), void *dst __attribute__((unused)),
+    size_t cap __attribute__((unused)))
+{
+	return -1;
+}
+
+ptrdiff_t astonia_net_send(astonia_sock *s __attribute__((unused)), const void *src __attribute__((unused)),
+    size_t len __attribute__((unused)))
+{
+	return -1;
+}
+
+int astonia_net_set_nodelay(astonia_sock *s __attribute__((unused)), int on __attribute__((unused)))
+{
+	return -1;
+}
+
+int astonia_net_local_ipv4(astonia_sock *s __attribute__((unused)), uint32_t *out_be __attribute__((unused)))
+{
+	return -1;
+}
+
+int astonia_net_peer_ipv4(astonia_sock *s __attribute__((unused)), uint32_t *out_be __attribute__((unused)))
+{
+	return -1;
+}
+
+void astonia_net_close(astonia_sock *s __attribute__((unused)))
+{
+}
+
+// ============================================================================
+// Display list sorting
+// ============================================================================
+
+static DL dl_pool[BENCH_DL];
+static DL *dl_random[BENCH_DL], *dl_sorted[BENCH_DL], *dl_work[BENCH_DL];
+
+static void dl_setup(void)
+{
+	srand(42);
+	for (int n = 0; n < BENCH_DL; n++) {
+		DL *dl = &dl_pool[n];
+
+		memset(dl, 0, sizeof(*dl));
+		if (n % 16 == 0) {
+			dl->call = DLC_DUMMY; // dl_next() inserts these every 16 entries
+		}
+		dl->layer = rand() % 4 * 10;
+		dl->x = rand() % 800;
+		dl->y = rand() % 600;
+		dl->renderfx.sprite = (unsigned int)(rand() % 60000);
+		dl_random[n] = dl;
+	}
+	memcpy(dl_sorted, dl_random, sizeof(dl_sorted));
+	qsort(dl_sorted, BENCH_DL, sizeof(DL *), dl_qcmp);
+}
+
+static void bench_dl_sort_random(int iters)
+{
+	for (int i = 0; i < iters; i++) {
+		memcpy(dl_work, dl_random, sizeof(dl_work));
+		qsort(dl_work, BENCH_DL, sizeof(DL *), dl_qcmp);
+		bench_sink += (uint32_t)dl_work[BENCH_DL / 2]->x;
+	}
+}
+
+// The map is added row by row, so most of a frame's list arrives nearly in order
+static void bench_dl_sort_sorted(int iters)
+{
+	for (int i = 0; i < iters; i++) {
+		memcpy(dl_work, dl_sorted, sizeof(dl_work));
+		qsort(dl_work, BENCH_DL, sizeof(DL *), dl_qcmp);
+		bench_sink += (uint32_t)dl_work[BENCH_DL / 2]->x;
+	}
+}
+
+// ============================================================================
+// Sprite config lookups
+// ============================================================================
+
+static void bench_lookup_character(int iters)
+{
+	for (int i = 0; i < iters; i++) {
+		bench_sink += sprite_config_lookup_character(i & 1023) != NULL;
+	}
+}
+
+static void bench_lookup_animated(int iters)
+{
+	for (int i = 0; i < iters; i++) {
+		bench_sink += sprite_config_lookup_animated((unsigned int)(i * 7) % 61000) != NULL;
+	}
+}
+
+static void bench_lookup_metadata(int iters)
+{
+	for (int i = 0; i < iters; i++) {
+		bench_sink += sprite_config_lookup_metadata((unsigned int)(i * 7) % 61000) != NULL;
+	}
+}
+
+// Body of _trans_asprite() in sprite.c
+static void bench_trans_asprite(int iters)
+{
+	unsigned char scale, cr, cg, cb, light, sat;
+	unsigned short c1, c2, c3, shine;
+
+	for (int i = 0; i < iters; i++) {
+		unsigned int sprite = (unsigned int)(i * 7) % 61000;
+		const AnimatedVariant *v = sprite_config_lookup_animated(sprite);
+
+		bench_sink += sprite_config_apply_animated(v, (map_index_t)(i % (MAPDX * MAPDY)), MAPDX, sprite, (tick_t)i,
+		    &scale, &cr, &cg, &cb, &light, &sat, &c1, &c2, &c3, &shine);
+	}
+}
+
+// ============================================================================
+// Text width
+// ============================================================================
+
+static const char *text_line[] = {
+    "Player42 says: \"Anyone selling a sword?\"",
+    "You hit the Skeleton Warrior for 14 damage.",
+    "Earth Demon",
+    "The door is locked.",
+    "Gold: 12345",
+    "Now entering Aston",
+};
+#define TEXT_LINES (int)(sizeof(text_line) / sizeof(text_line[0]))
+
+static void bench_render_text_length(int iters)
+{
+	for (int i = 0; i < iters; i++) {
+		bench_sink += (uint32_t)render_text_length(i & 1 ? RENDER_TEXT_SMALL : 0, text_line[i % TEXT_LINES]);
+	}
+}
+
+// ============================================================================
+// Map decoders
+// ============================================================================
+
+static unsigned char map01_buf[BENCH_TILES * 9], map10_buf[BENCH_TILES / 4 * 15], map11_buf[BENCH_TILES * 21];
+static size_t map01_len, map10_len, map11_len;
+
+static unsigned char *put16(unsigned char *p, unsigned int v)
+{
+	store_u16(p, (uint16_t)v);
+	return p + 2;
+}
+
+static unsigned char *put32(unsigned char *p, uint32_t v)
+{
+	store_u32(p, v);
+	return p + 4;
+}
+
+// One command per tile the way a login tick fills the map, sprites and values from rand()
+static void map_setup(void)
+{
+	unsigned char *p;
+	unsigned int n;
+
+	srand(42);
+	map_init();
+
+	// sv_map01: two effects on every tile
+	for (p = map01_buf, n = 0; n < BENCH_TILES; n++) {
+		*p++ = SV_MAP01 | SV_MAPNEXT | 1 | 2;
+		p = put32(p, (uint32_t)rand());
+		p = put32(p, (uint32_t)rand());
+	}
+	map01_len = (size_t)(p - map01_buf);
+
+	// sv_map10: a character with action and stats on every fourth tile
+	for (p = map10_buf, n = 3; n < BENCH_TILES; n += 4) {
+		*p++ = SV_MAP10 | SV_MAPOFF | 1 | 2 | 4;
+		*p++ = 4;
+		p = put32(p, 1000u + (unsigned int)(rand() % 500));
+		p = put16(p, n);
+		*p++ = (unsigned char)(rand() % 8);
+		*p++ = (unsigned char)(4 + rand() % 8);
+		*p++ = 0;
+		*p++ = (unsigned char)(1 + rand() % 8);
+		*p++ = (unsigned char)(rand() % 101);
+		*p++ = (unsigned char)(rand() % 101);
+		*p++ = (unsigned char)(rand() % 101);
+	}
+	map10_len = (size_t)(p - map10_buf);
+
+	// sv_map11: ground, floor, item and flags on every tile, every 16th item colorized
+	for (p = map11_buf, n = 0; n < BENCH_TILES; n++) {
+		*p++ = SV_MAP11 | SV_MAPNEXT | 1 | 2 | 4 | 8;
+		p = put32(p, (uint32_t)(rand() % 60000));
+		p = put32(p, n % 4 ? 0u : (uint32_t)(rand() % 60000));
+		if (n % 16 == 0) {
+			p = put32(p, (uint32_t)(rand() % 60000) | 0x80000000u);
+			p = put16(p, (unsigned int)rand() & 0x7fff);
+			p = put16(p, (unsigned int)rand() & 0x7fff);
+			p = put16(p, (unsigned int)rand() & 0x7fff);
+		} else {
+			p = put32(p, 0);
+		}
+		p = put16(p, CMF_VISIBLE | (unsigned int)(rand() % (CMF_LIGHT + 1)));
+	}
+	map11_len = (size_t)(p - map11_buf);
+}
+
+// One command per iteration, starting over at the end of the payload
+static void map_decode(int iters, size_t (*decode)(unsigned char *, int *, struct map *), unsigned char *buf,
+    size_t len)
+{
+	size_t pos = 0;
+	int last = -1;
+
+	for (int i = 0; i < iters; i++) {
+		if (pos >= len) {
+			pos = 0;
+			last = -1;
+		}
+		pos += decode(buf + pos, &last, map);
+	}
+	bench_sink += (uint32_t)last;
+}
+
+static void bench_sv_map01(int iters)
+{
+	map_decode(iters, test_sv_map01, map01_buf, map01_len);
+}
+
+static void bench_sv_map10(int iters)
+{
+	map_decode(iters, test_sv_map10, map10_buf, map10_len);
+}
+
+static void bench_sv_map11(int iters)
+{
+	map_decode(iters, test_sv_map11, map11_buf, map11_len);
+}
+
+void bench_game(void)
+{
+	dl_setup();
+	bench_run("dl_qcmp_sort_2500_random", bench_dl_sort_random, 20);
+	bench_run("dl_qcmp_sort_2500_sorted", bench_dl_sort_sorted, 20);
+
+	bench_run("render_text_length", bench_render_text_length, 1000000);
+
+	map_setup();
+	bench_run("sv_map01", bench_sv_map01, 1000000);
+	bench_run("sv_map10", bench_sv_map10, 1000000);
+	bench_run("sv_map11", bench_sv_map11, 1000000);
+
+	if (sprite_config_init() < 0) {
+		fprintf(stderr, "bench_micro: sprite_config_init failed, skipping sprite_config benchmarks\n");
+		return;
+	}
+	bench_run("sprite_config_lookup_character", bench_lookup_character, 1000000);
+	bench_run("sprite_config_lookup_animated", bench_lookup_animated, 1000000);
+	bench_run("sprite_config_lookup_metadata", bench_lookup_metadata, 1000000);
+	bench_run("trans_asprite", bench_trans_asprite, 1000000);
+	sprite_config_shutdown();
+}
@@ -0,0 +1,216 @@
+/*
+ * Headless Render Benchmark - Synthetic scenes through the display list
+ *
+ * Builds each scene with dl_next_set() / dl_call_*() and draws it with
+ * dl_play(), so the display list sort, render_sprite_fx() and the effect
+ * drawing in render.c run as they do in the game, down to sdl_tx_load() and
+ * sdl_blit(). Real sprites from res/gx1.zip, the stubbed GPU layer from
+ * sdl_test.c and the screen stubs from bench_game_stubs.c. No window, no GPU,
+ * no server. The scenes live in bench_render_game.c, the game and SDL headers
+ * don't mix; this file picks the sprites and keeps the texture cache counters.
+ *
+ * Scenes per frame:
+ *   map        - 51x51 diamond of floor and object sprites with per-tile lighting
+ *   characters - 300 colorized, scaled and animated character sprites
+ *   particles  - bless, heal, potion, pulse and strike effects
+ *   chat       - full chat panel through render_text(), one new line every few frames
+ *   prefetch   - next frame's characters through dl_prefetch() and one pre tick
+ *
+ * Prints one JSON object to stdout (frames/sec, frame time percentiles,
+ * per-scene averages and texture cache hit rates).
+ *
+ * The seed decides which sprite lands on which tile and character and where
+ * the particles go; the PGO comparison runs with a different seed than the
+ * training run.
+ *
+ * Usage: bench_render [--frames N] [--warmup N] [--workers N] [--seed N] [--out file]
+ */
+
+#include "../src/astonia.h"
+#include "../src/sdl/sdl_private.h"
+#include "../src/sdl/sdl.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zip.h>
+
+#define BENCH_SPRITES 512 // fixed subset of gx1.zip, taken in archive order
+
+enum { SCENE_MAP, SCENE_CHARS, SCENE_PARTICLES, SCENE_CHAT, SCENE_PREFETCH, SCENE_MAX };
+static const char *scene_name[SCENE_MAX] = {"map", "characters", "particles", "chat", "prefetch"};
+
+static unsigned int sprites[BENCH_SPRITES];
+static int num_sprites = 0;
+
+// Simple deterministic PRNG (xorshift32), so every run with the same seed draws the same scenes
+static uint32_t rng_state = 0x2545F491u;
+
+int bench_rng(int n)
+{
+	uint32_t x = rng_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	rng_state = x;
+	return (int)(x % (uint32_t)n);
+}
+
+static void build_sprite_list(void)
+{
+	zip_int64_t n = zip_get_num_entries(sdl_zip1, 0);
+
+	for (zip_int64_t i = 0; i < n && num_sprites < BENCH_SPRITES; i++) {
+		const char *name = zip_get_name(sdl_zip1, (zip_uint64_t)i, 0);
+		unsigned int nr;
+
+		if (!name || sscanf(name, "%u.png", &nr) != 1 || nr >= MAXSPRITE) {
+			continue;
+		}
+		if (sdl_ic_load(nr) < 0 || sdli[nr].xres <= 0 || sdli[nr].yres <= 0) {
+			continue;
+		}
+		sprites[num_sprites++] = nr;
+	}
+
+	for (int i = num_sprites - 1; i > 0; i--) {
+		int j = bench_rng(i + 1);
+		unsigned int tmp = sprites[i];
+
+		sprites[i] = sprites[j];
+		sprites[j] = tmp;
+	}
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double ms(uint64_t ns)
+{
+	return (double)ns / 1000000.0;
+}
+
+int main(int argc, char *argv[])
+{
+	int frames = 600, warmup = 60, workers = 0, f, s;
+	const char *out = NULL;
+	uint64_t *ft, scene_ns[SCENE_MAX] = {0}, total = 0;
+	long long hit, miss, pre;
+	FILE *fp = stdout;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+			frames = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--warmup") && i + 1 < argc) {
+			warmup = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--workers") && i + 1 < argc) {
+			workers = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+			rng_state = (uint32_t)strtoul(argv[++i], NULL, 0);
+		} else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+			out = argv[++i];
+		} else {
+			fprintf(stderr, "usage: %s [--frames N] [--warmup N] [--workers N] [--seed N] [--out file]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (frames < 1 || warmup < 0 || !rng_state) {
+		fprintf(stderr, "bench_render: bad frame count or seed\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!(workers ? sdl_init_for_tests_with_workers(workers) : sdl_init_for_tests())) {
+		return EXIT_FAILURE;
+	}
+
+	build_sprite_list();
+	if (!scene_init(sprites, num_sprites)) {
+		fprintf(stderr, "bench_render: only %d usable sprites in res/gx1.zip\n", num_sprites);
+		sdl_shutdown_for_tests();
+		return EXIT_FAILURE;
+	}
+
+	fprintf(stderr, "bench_render: %d sprites, %d warm-up + %d frames, %d workers\n", num_sprites, warmup, frames,
+	    workers);
+
+	ft = calloc((size_t)frames, sizeof(uint64_t));
+	if (!ft) {
+		sdl_shutdown_for_tests();
+		return EXIT_FAILURE;
+	}
+
+	hit = miss = pre = 0;
+	for (f = -warmup; f < frames; f++) {
+		uint64_t t[SCENE_MAX + 1];
+
+		if (f == 0) {
+			hit = texc_hit;
+			miss = texc_miss;
+			pre = texc_pre;
+		}
+		if (f % 8 == 0) {
+			scene_chat_add(f);
+		}
+
+		t[0] = SDL_GetTicksNS();
+		scene_map(f + warmup);
+		t[1] = SDL_GetTicksNS();
+		scene_chars(f + warmup);
+		t[2] = SDL_GetTicksNS();
+		scene_particles(f + warmup);
+		t[3] = SDL_GetTicksNS();
+		scene_chat();
+		t[4] = SDL_GetTicksNS();
+		scene_prefetch(f + warmup);
+		sdl_pre_tick_for_tests();
+		t[5] = SDL_GetTicksNS();
+
+		if (f >= 0) {
+			for (s = 0; s < SCENE_MAX; s++) {
+				scene_ns[s] += t[s + 1] - t[s];
+			}
+			ft[f] = t[SCENE_MAX] - t[0];
+			total += ft[f];
+		}
+	}
+	hit = texc_hit - hit;
+	miss = texc_miss - miss;
+	pre = texc_pre - pre;
+
+	qsort(ft, (size_t)frames, sizeof(uint64_t), cmp_u64);
+
+	if (out) {
+		fp = fopen(out, "w");
+		if (!fp) {
+			fprintf(stderr, "bench_render: cannot write %s\n", out);
+			fp = stdout;
+		}
+	}
+
+	fprintf(fp, "{\n  \"benchmark\": \"render\",\n  \"frames\": %d,\n  \"workers\": %d,\n  \"sprites\": %d,\n", frames,
+	    workers, num_sprites);
+	fprintf(fp, "  \"fps\": %.1f,\n", total ? (double)frames * 1000000000.0 / (double)total : 0.0);
+	fprintf(fp, "  \"frame_ms\": {\"avg\": %.3f, \"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f},\n",
+	    ms(total) / frames, ms(ft[frames / 2]), ms(ft[(frames * 99) / 100]), ms(ft[frames - 1]));
+	fprintf(fp, "  \"scene_ms\": {");
+	for (s = 0; s < SCENE_MAX; s++) {
+		fprintf(fp, "%s\"%s\": %.3f", s ? ", " : "", scene_name[s], ms(scene_ns[s]) / frames);
+	}
+	fprintf(fp, "},\n");
+	fprintf(fp, "  \"texcache\": {\"hit\": %lld, \"miss\": %lld, \"pre\": %lld, \"hit_rate\": %.4f, \"used\": %d}\n}\n",
+	    hit, miss, pre, hit + miss ? (double)hit / (double)(hit + miss) : 0.0, texc_used);
+
+	if (fp != stdout) {
+		fclose(fp);
+	}
+
+	free(ft);
+	sdl_shutdown_for_tests();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,176 @@
+/*
+ * Headless Render Benchmark - Scenes
+ *
+ * The game side of bench_render: every scene goes into the display list
+ * through dl_next_set() and the dl_call_*() effects of game_effects.c and is
+ * drawn by dl_play(), the chat through render_text(). game_core.c,
+ * game_effects.c, render.c and font.c are linked as they are.
+ */
+
+#include "../src/astonia.h"
+#include "../src/game/game.h"
+#include "../src/game/game_private.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_MAP_SIZE   51 // DIST * 2 + 1
+#define BENCH_CHARS      300
+#define BENCH_ANIM       8 // animation frames per character
+#define BENCH_PARTICLES  64
+#define BENCH_CHAT_LINES 24
+#define BENCH_SCREEN_X   800
+#define BENCH_SCREEN_Y   600
+
+// ============================================================================
+// Stubs for game_core.c and render.c, client.c isn't linked
+// ============================================================================
+
+uint16_t originx = 0, originy = 0;
+unsigned int map_dist = DIST_DEFAULT;
+tick_t tick = 0;
+
+// ============================================================================
+// Scenes
+// ============================================================================
+
+static const unsigned int *sprites;
+static int num_sprites = 0;
+
+static char chat[BENCH_CHAT_LINES][80];
+static int chat_pos = 0;
+
+int scene_init(const unsigned int *list, int cnt)
+{
+	if (cnt < BENCH_ANIM * 4) {
+		return 0;
+	}
+	sprites = list;
+	num_sprites = cnt;
+
+	// clipping and the shaded and framed fonts
+	render_init();
+	for (int f = 0; f < BENCH_CHAT_LINES; f++) {
+		scene_chat_add(-f);
+	}
+
+	return 1;
+}
+
+void scene_chat_add(int frame)
+{
+	snprintf(chat[chat_pos], sizeof(chat[chat_pos]), "Player%d says: \"Frame %d, anyone selling a sword?\"",
+	    bench_rng(1000), frame);
+	chat_pos = (chat_pos + 1) % BENCH_CHAT_LINES;
+}
+
+void scene_map(int frame)
+{
+	int x, y, floors = num_sprites * 3 / 4;
+
+	for (y = 0; y < BENCH_MAP_SIZE; y++) {
+		for (x = 0; x < BENCH_MAP_SIZE; x++) {
+			int sx = (x - y) * 20 + BENCH_SCREEN_X / 2, sy = (x + y) * 10 - 200;
+			int light = 15 - (abs(x - BENCH_MAP_SIZE / 2) + abs(y - BENCH_MAP_SIZE / 2)) / 4;
+			unsigned int tile = (unsigned int)(x * 7 + y * 13);
+
+			if (light < 0) {
+				light = 0;
+			}
+			dl_next_set(GND_LAY, sprites[tile % (unsigned int)floors], sx, sy, (unsigned char)light);
+			if (tile % 5 == 0) {
+				// objects: walls, trees, furniture. every 64th frame a door or torch changes state
+				dl_next_set(GME_LAY, sprites[(tile + (unsigned int)(frame / 64)) % (unsigned int)floors], sx, sy,
+				    (unsigned char)light);
+			}
+		}
+	}
+	dl_play();
+}
+
+static void char_params(int n, int frame, unsigned int *sprite, unsigned char *scale, int *c1, int *c2, int *c3)
+{
+	int base = num_sprites * 3 / 4, range = num_sprites - base - BENCH_ANIM;
+
+	*sprite = sprites[base + (n * 17) % (range > 0 ? range : 1) + (frame + n) % BENCH_ANIM];
+	*scale = (unsigned char)(85 + (n % 4) * 10);
+	*c1 = (n * 0x0421) & 0x7fff;
+	*c2 = (n * 0x1063) & 0x7fff;
+	*c3 = (n * 0x2108) & 0x7fff;
+}
+
+static void chars_list(int frame)
+{
+	for (int n = 0; n < BENCH_CHARS; n++) {
+		unsigned int sprite;
+		unsigned char scale;
+		int c1, c2, c3;
+		DL *dl;
+
+		char_params(n, frame, &sprite, &scale, &c1, &c2, &c3);
+		dl = dl_next_set(GME_LAY, sprite, (n * 37 + frame) % BENCH_SCREEN_X, 100 + (n * 53) % 400, 15);
+		if (dl) {
+			dl->renderfx.scale = scale;
+			dl->renderfx.c1 = (unsigned short)c1;
+			dl->renderfx.c2 = (unsigned short)c2;
+			dl->renderfx.c3 = (unsigned short)c3;
+		}
+	}
+}
+
+void scene_chars(int frame)
+{
+	chars_list(frame);
+	dl_play();
+}
+
+void scene_particles(int frame)
+{
+	for (int n = 0; n < BENCH_PARTICLES; n++) {
+		int cx = (n * 97) % BENCH_SCREEN_X + bench_rng(16), cy = (n * 61) % BENCH_SCREEN_Y + bench_rng(16);
+		int ticker = (frame + n * 7) % 64;
+
+		// the game queues bless, heal and potion twice, in front of and behind the character
+		switch (n % 5) {
+		case 0:
+			dl_call_bless(GME_LAY, cx, cy, ticker, 40, 1);
+			dl_call_bless(GME_LAY, cx, cy, ticker, 40, 0);
+			break;
+		case 1:
+			dl_call_heal(GME_LAY, cx, cy, ticker, 1);
+			dl_call_heal(GME_LAY, cx, cy, ticker, 0);
+			break;
+		case 2:
+			dl_call_potion(GME_LAY, cx, cy, ticker, 40, 1);
+			dl_call_potion(GME_LAY, cx, cy, ticker, 40, 0);
+			break;
+		case 3:
+			dl_call_pulse(GME_LAY, cx, cy, ticker, 8 + ticker % 24, IRGB(0, 31, 0));
+			break;
+		default:
+			dl_call_strike(GME_LAY, cx, cy, 40, cx + 60, cy - 20, 40);
+			break;
+		}
+	}
+	dl_play();
+}
+
+void scene_chat(void)
+{
+	render_shaded_rect(0, 400, 400, BENCH_SCREEN_Y, 0, 160);
+	for (int n = 0; n < BENCH_CHAT_LINES; n++) {
+		const char *line = chat[(chat_pos + n) % BENCH_CHAT_LINES];
+
+		if (*line) {
+			render_text(4, 404 + n * 8, IRGB(16, 31, 16), RENDER_TEXT_LEFT | RENDER_TEXT_SMALL, line);
+		}
+	}
+}
+
+// Queue next frame's characters through dl_prefetch(), the pre tick is up to the caller
+void scene_prefetch(int frame)
+{
+	chars_list(frame + 1);
+	dl_prefetch();
+}
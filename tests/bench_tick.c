@@ -0,0 +1,564 @@
+/*
+ * Headless Tick Benchmark - Generated server traffic through the client tick path
+ *
+ * Generates a server stream from a seed and hands it to the real client.c
+ * through stubbed astonia_net_*() calls, one tick per loop, so poll_network(),
+ * next_tick() / prefetch(), do_tick() / process() and the sv_map* decoders run
+ * exactly as they do against a server. After every tick the loop runs
+ * set_map_values() on map2 and map like prefetch_game() and set_cmd_states()
+ * do. No window, no GPU, no server.
+ *
+ * Stream:
+ *   login   - SV_LOGINDONE, origin, stats, then the map in chunks
+ *   walk    - a scroll every few ticks with the new edge row/column
+ *   actors  - characters walking, fighting and leaving the view
+ *   changes - doors, items, light and effects on random tiles
+ *   stats   - hp/mana/endurance every tick, values, gold and exp now and then
+ * Ticks are deflated on one stream like the server does.
+ *
+ * Prints one JSON object to stdout (ticks/sec, tick time percentiles and
+ * stream size). The login ticks are not timed.
+ *
+ * Usage: bench_tick [--ticks N] [--seed N] [--out file]
+ */
+
+#include "../src/astonia.h"
+#include "../src/client/client.h"
+#include "../src/client/client_private.h"
+#include "../src/client/protocol.h"
+#include "../src/game/game.h"
+#include "../src/game/sprite_config.h"
+#include "../src/gui/gui.h"
+#include "../src/modder/modder.h"
+#include "../src/sdl/sdl.h"
+#include "astonia_net.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#define TICK_W       ((int)(DIST_DEFAULT * 2 + 1))
+#define TICK_RAW     16384 // = sizeof(queue[].buf), the largest tick the client takes
+#define TICK_CHUNK   600 // tiles per login tick
+#define TICK_ACTORS  80
+#define TICK_CHANGES 20 // tiles changing per tick
+#define TICK_WALK    4 // ticks per step
+#define TICK_PALETTE 32 // sprites per kind, a quarter of them with animated variants
+
+// Simple deterministic PRNG (xorshift32), so every run with the same seed gets the same stream
+static uint32_t rng_state;
+
+static int rng(int n)
+{
+	uint32_t x = rng_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	rng_state = x;
+	return (int)(x % (uint32_t)n);
+}
+
+static unsigned int ground[TICK_PALETTE], object[TICK_PALETTE], items[TICK_PALETTE], character[TICK_PALETTE];
+
+static struct actor {
+	int x, y;
+	unsigned int csprite;
+	unsigned short cn;
+} actor[TICK_ACTORS];
+
+// content moves by dx,dy when the player steps the other way
+static const struct {
+	unsigned char cmd;
+	int dx, dy;
+} scroll[8] = {
+    {SV_SCROLL_RIGHT, -1, 0},
+    {SV_SCROLL_RIGHTDOWN, -1, -1},
+    {SV_SCROLL_DOWN, 0, -1},
+    {SV_SCROLL_LEFTDOWN, 1, -1},
+    {SV_SCROLL_LEFT, 1, 0},
+    {SV_SCROLL_LEFTUP, 1, 1},
+    {SV_SCROLL_UP, 0, 1},
+    {SV_SCROLL_RIGHTUP, -1, 1},
+};
+
+static unsigned char raw[TICK_RAW];
+static size_t raw_len;
+
+static z_stream zs;
+static unsigned char *stream;
+static size_t stream_len, stream_cap, *tick_end;
+static int stream_ticks;
+
+// ============================================================================
+// Stream generator
+// ============================================================================
+
+static void put8(unsigned int v)
+{
+	raw[raw_len++] = (unsigned char)v;
+}
+
+static void put16(unsigned int v)
+{
+	store_u16(raw + raw_len, (uint16_t)v);
+	raw_len += 2;
+}
+
+static void put32(uint32_t v)
+{
+	store_u32(raw + raw_len, v);
+	raw_len += 4;
+}
+
+// map command header, addressing the tile the way the server would
+enum { AT_POS, AT_NEXT, AT_BELOW };
+
+static void put_map(unsigned int cmd, int at, int x, int y)
+{
+	switch (at) {
+	case AT_NEXT:
+		put8(cmd | SV_MAPNEXT);
+		break;
+	case AT_BELOW:
+		put8(cmd | SV_MAPOFF);
+		put8((unsigned int)TICK_W);
+		break;
+	default:
+		put8(cmd | SV_MAPPOS);
+		put16((unsigned int)(x + y * TICK_W));
+		break;
+	}
+}
+
+static void put_tile(int at, int x, int y)
+{
+	unsigned int isprite, flags;
+
+	put_map(SV_MAP11 | 1 | 2 | 4 | 8, at, x, y);
+	put32(ground[rng(TICK_PALETTE)] | (rng(8) ? 0u : ground[rng(TICK_PALETTE)] << 16));
+	put32(rng(4) ? 0u : object[rng(TICK_PALETTE)]);
+	isprite = rng(16) ? 0u : items[rng(TICK_PALETTE)];
+	if (isprite && !rng(4)) {
+		put32(isprite | 0x80000000u);
+		put16((unsigned int)rng(0x8000));
+		put16((unsigned int)rng(0x8000));
+		put16((unsigned int)rng(0x8000));
+	} else {
+		put32(isprite);
+	}
+	flags = rng(12) ? CMF_VISIBLE | (unsigned int)rng(CMF_LIGHT + 1) : 0;
+	if (flags & 0xFF) {
+		put16(flags);
+	} else {
+		put8(0);
+	}
+	put8(SV_MAP10 | SV_MAPTHIS | 8); // nobody standing there yet
+}
+
+static void put_actor(const struct actor *a, unsigned int action)
+{
+	put_map(SV_MAP10 | 1 | 2 | 4, AT_POS, a->x, a->y);
+	put32(a->csprite);
+	put16(a->cn);
+	put8(action);
+	put8(action ? 4u + (unsigned int)rng(8) : 0u);
+	put8(0);
+	put8(1u + (unsigned int)rng(8));
+	put8((unsigned int)rng(101));
+	put8((unsigned int)rng(101));
+	put8((unsigned int)rng(101));
+}
+
+static void spawn_actor(struct actor *a)
+{
+	a->x = rng(TICK_W);
+	a->y = rng(TICK_W);
+	put_actor(a, 0);
+}
+
+static void stream_add(const unsigned char *src, size_t len)
+{
+	if (stream_len + len > stream_cap) {
+		stream_cap = (stream_cap + len) * 2;
+		stream = realloc(stream, stream_cap);
+		if (!stream) {
+			fprintf(stderr, "bench_tick: out of memory\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	memcpy(stream + stream_len, src, len);
+	stream_len += len;
+}
+
+// frames the tick in raw[] like the server: small ones plain, the rest deflated
+static void end_tick(void)
+{
+	static unsigned char out[TICK_RAW + TICK_RAW / 8 + 64];
+	unsigned char head[2];
+	size_t len;
+
+	if (raw_len < 64) {
+		head[0] = (unsigned char)(0x40 | raw_len);
+		stream_add(head, 1);
+		stream_add(raw, raw_len);
+	} else {
+		zs.next_in = raw;
+		zs.avail_in = (unsigned int)raw_len;
+		zs.next_out = out + 2;
+		zs.avail_out = (unsigned int)(sizeof(out) - 2);
+		if (deflate(&zs, Z_SYNC_FLUSH) != Z_OK || zs.avail_in) {
+			fprintf(stderr, "bench_tick: deflate failed\n");
+			exit(EXIT_FAILURE);
+		}
+		len = sizeof(out) - 2 - zs.avail_out;
+		if (len > 0x3FFF) {
+			fprintf(stderr, "bench_tick: tick %d too large (%zu bytes)\n", stream_ticks, len);
+			exit(EXIT_FAILURE);
+		}
+		out[0] = (unsigned char)(0x80 | (len >> 8));
+		out[1] = (unsigned char)(len & 0xFF);
+		stream_add(out, len + 2);
+	}
+	tick_end[stream_ticks++] = stream_len;
+	raw_len = 0;
+}
+
+static void fill_palette(unsigned int *pal, unsigned int limit, int chars)
+{
+	int n = 0;
+
+	for (unsigned int id = 1 + (unsigned int)rng((int)limit / 2); id < limit && n < TICK_PALETTE / 4; id++) {
+		if (chars ? sprite_config_lookup_character((int)id) != NULL : sprite_config_lookup_animated(id) != NULL) {
+			pal[n++] = id;
+		}
+	}
+	while (n < TICK_PALETTE) {
+		pal[n++] = 1 + (unsigned int)rng((int)limit - 1);
+	}
+}
+
+static void gen_stats(int t)
+{
+	put8(SV_SETHP);
+	put16(200u + (unsigned int)rng(100));
+	put8(SV_SETMANA);
+	put16(100u + (unsigned int)rng(50));
+	put8(SV_ENDURANCE);
+	put16((unsigned int)rng(50));
+	if (t % 8 == 0) {
+		put8(SV_SETVAL0);
+		put8((unsigned int)rng(*game_v_max));
+		put16((unsigned int)rng(200));
+	}
+	if (t % 16 == 0) {
+		put8(rng(2) ? SV_GOLD : SV_EXP);
+		put32((uint32_t)rng(1000000));
+	}
+}
+
+static void gen_scroll(int dir, int *ox, int *oy)
+{
+	int dx = scroll[dir].dx, dy = scroll[dir].dy, i;
+
+	put8(scroll[dir].cmd);
+	*ox -= dx;
+	*oy -= dy;
+	put8(SV_SETORIGIN);
+	put16((unsigned int)*ox);
+	put16((unsigned int)*oy);
+
+	// the tiles that came into view, wrapped-around content included
+	if (dy) {
+		for (i = 0; i < TICK_W; i++) {
+			put_tile(i ? AT_NEXT : AT_POS, i, dy < 0 ? TICK_W - 1 : 0);
+		}
+	}
+	if (dx) {
+		for (i = 0; i < TICK_W; i++) {
+			put_tile(i ? AT_BELOW : AT_POS, dx < 0 ? TICK_W - 1 : 0, i);
+		}
+	}
+
+	for (i = 0; i < TICK_ACTORS; i++) {
+		struct actor *a = &actor[i];
+
+		a->x += dx;
+		a->y += dy;
+		if (a->x < 0 || a->x >= TICK_W || a->y < 0 || a->y >= TICK_W) {
+			spawn_actor(a);
+		}
+	}
+}
+
+static void gen_actors(void)
+{
+	for (int i = 0; i < TICK_ACTORS; i++) {
+		struct actor *a = &actor[i];
+		int r = rng(8), x, y;
+
+		if (r < 3) { // walk
+			x = a->x + rng(3) - 1;
+			y = a->y + rng(3) - 1;
+			if (x < 0 || x >= TICK_W || y < 0 || y >= TICK_W) {
+				continue;
+			}
+			put_map(SV_MAP10 | 8, AT_POS, a->x, a->y);
+			a->x = x;
+			a->y = y;
+			put_actor(a, 1);
+		} else if (r < 5) { // fight
+			put_map(SV_MAP10 | 2 | 4, AT_POS, a->x, a->y);
+			put8(2u + (unsigned int)rng(4));
+			put8(4u + (unsigned int)rng(8));
+			put8(0);
+			put8(1u + (unsigned int)rng(8));
+			put8((unsigned int)rng(101));
+			put8((unsigned int)rng(101));
+			put8((unsigned int)rng(101));
+		}
+	}
+}
+
+static void gen_changes(void)
+{
+	for (int i = 0; i < TICK_CHANGES; i++) {
+		int x = rng(TICK_W), y = rng(TICK_W);
+
+		switch (rng(3)) {
+		case 0: // door opens, item dropped or picked up
+			put_map(SV_MAP11 | 2 | 4, AT_POS, x, y);
+			put32(rng(2) ? 0u : object[rng(TICK_PALETTE)]);
+			put32(rng(2) ? 0u : items[rng(TICK_PALETTE)]);
+			break;
+		case 1: // light changes
+			put_map(SV_MAP11 | 8, AT_POS, x, y);
+			put16(CMF_VISIBLE | (unsigned int)rng(CMF_LIGHT + 1));
+			break;
+		default: // effect starts or ends
+			put_map(SV_MAP01 | 1, AT_POS, x, y);
+			put32(rng(3) ? 0u : (uint32_t)(1 + rng(1000)));
+			break;
+		}
+	}
+}
+
+static int gen_stream(int ticks)
+{
+	int t, i, login, ox = 512, oy = 512, dir = 0;
+
+	tick_end = calloc((size_t)ticks + TICK_W * TICK_W / TICK_CHUNK + 2, sizeof(size_t));
+	if (!tick_end || deflateInit(&zs, Z_DEFAULT_COMPRESSION) != Z_OK) {
+		return -1;
+	}
+
+	fill_palette(ground, 0x10000, 0);
+	fill_palette(object, 0x10000, 0);
+	fill_palette(items, 0x10000, 0);
+	fill_palette(character, 400, 1);
+
+	put8(SV_LOGINDONE);
+	put8(SV_SETORIGIN);
+	put16((unsigned int)ox);
+	put16((unsigned int)oy);
+	for (i = 0; i < TICK_W * TICK_W; i++) {
+		if (i && i % TICK_CHUNK == 0) {
+			end_tick();
+		}
+		put_tile(i % TICK_CHUNK ? AT_NEXT : AT_POS, i % TICK_W, i / TICK_W);
+	}
+	for (i = 0; i < TICK_ACTORS; i++) {
+		actor[i].csprite = character[rng(TICK_PALETTE)];
+		actor[i].cn = (unsigned short)(1 + i);
+		spawn_actor(&actor[i]);
+	}
+	gen_stats(0);
+	end_tick();
+	login = stream_ticks;
+
+	for (t = 0; t < ticks; t++) {
+		// walk for a while, then stand for a while
+		if (t % 96 < 64 && t % TICK_WALK == 0) {
+			if (t % 32 == 0) {
+				dir = rng(8);
+			}
+			gen_scroll(dir, &ox, &oy);
+		}
+		gen_actors();
+		gen_changes();
+		gen_stats(t + 1);
+		end_tick();
+	}
+
+	deflateEnd(&zs);
+
+	return login;
+}
+
+// ============================================================================
+// Stubs - network, the stream is served through astonia_net_recv()
+// GUI, sound and mod entry points are in bench_client_stubs.c
+// ============================================================================
+
+static int bench_sock; // only its address is handed around
+static size_t served, arrived;
+
+astonia_sock *astonia_net_connect(const char *host __attribute__((unused)), uint16_t port __attribute__((unused)),
+    int timeout_ms __attribute__((unused)))
+{
+	return (astonia_sock *)&bench_sock;
+}
+
+int astonia_net_poll(astonia_sock *s __attribute__((unused)), int mask, int timeout_ms __attribute__((unused)))
+{
+	return (mask & 2) | ((mask & 1) && served < arrived);
+}
+
+ptrdiff_t astonia_net_recv(astonia_sock *s __attribute__((unused)), void *dst, size_t cap)
+{
+	size_t n = arrived - served < cap ? arrived - served : cap;
+
+	if (!n) {
+		return -1;
+	}
+	memcpy(dst, stream + served, n);
+	served += n;
+
+	return (ptrdiff_t)n;
+}
+
+ptrdiff_t astonia_net_send(astonia_sock *s __attribute__((unused)), const void *src __attribute__((unused)), size_t len)
+{
+	return (ptrdiff_t)len;
+}
+
+int astonia_net_set_nodelay(astonia_sock *s __attribute__((unused)), int on __attribute__((unused)))
+{
+	return 0;
+}
+
+int astonia_net_local_ipv4(astonia_sock *s __attribute__((unused)), uint32_t *out_be __attribute__((unused)))
+{
+	return -1;
+}
+
+int astonia_net_peer_ipv4(astonia_sock *s __attribute__((unused)), uint32_t *out_be __attribute__((unused)))
+{
+	return -1;
+}
+
+void astonia_net_close(astonia_sock *s __attribute__((unused)))
+{
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double us(uint64_t ns)
+{
+	return (double)ns / 1000.0;
+}
+
+int main(int argc, char *argv[])
+{
+	int ticks = 2000, login, t, n = 0;
+	unsigned long seed = 0x9E3779B9u;
+	const char *out = NULL;
+	uint64_t *tt, total = 0;
+	tick_t attick;
+	FILE *fp = stdout;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--ticks") && i + 1 < argc) {
+			ticks = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+			seed = strtoul(argv[++i], NULL, 0);
+		} else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+			out = argv[++i];
+		} else {
+			fprintf(stderr, "usage: %s [--ticks N] [--seed N] [--out file]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (ticks < 1 || !(uint32_t)seed) {
+		fprintf(stderr, "bench_tick: bad tick count or seed\n");
+		return EXIT_FAILURE;
+	}
+	rng_state = (uint32_t)seed;
+
+	if (sprite_config_init() < 0) {
+		fprintf(stderr, "bench_tick: no sprite config, animated variants are not covered\n");
+	}
+	map_init();
+	init_game(0, 0);
+
+	login = gen_stream(ticks);
+	tt = calloc((size_t)ticks, sizeof(uint64_t));
+	if (login < 0 || !tt) {
+		fprintf(stderr, "bench_tick: setup failed\n");
+		return EXIT_FAILURE;
+	}
+
+	fprintf(stderr, "bench_tick: %d login + %d ticks, %zu bytes, seed 0x%08X\n", login, ticks, stream_len,
+	    (unsigned int)seed);
+
+	target_server = "bench";
+	for (t = 0; t < stream_ticks && sockstate >= 0; t++) {
+		uint64_t t0;
+
+		arrived = tick_end[t]; // the server sends one tick per frame
+
+		t0 = SDL_GetTicksNS();
+		poll_network();
+		while ((attick = next_tick())) {
+			set_map_values(map2, attick);
+		}
+		if (do_tick()) {
+			set_map_values(map, tick);
+		}
+		if (t >= login) {
+			tt[n] = SDL_GetTicksNS() - t0;
+			total += tt[n++];
+		}
+	}
+	if (n != ticks || served != stream_len || !login_done) {
+		fprintf(stderr, "bench_tick: client stopped after %d of %d ticks (state %d)\n", n, ticks, sockstate);
+		return EXIT_FAILURE;
+	}
+
+	qsort(tt, (size_t)ticks, sizeof(uint64_t), cmp_u64);
+
+	if (out) {
+		fp = fopen(out, "w");
+		if (!fp) {
+			fprintf(stderr, "bench_tick: cannot write %s\n", out);
+			fp = stdout;
+		}
+	}
+
+	fprintf(fp, "{\n  \"benchmark\": \"tick\",\n  \"ticks\": %d,\n  \"stream_bytes\": %zu,\n", ticks, stream_len);
+	fprintf(fp, "  \"ticks_per_sec\": %.1f,\n", total ? (double)ticks * 1000000000.0 / (double)total : 0.0);
+	fprintf(fp, "  \"tick_us\": {\"avg\": %.3f, \"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f}\n}\n",
+	    us(total) / ticks, us(tt[ticks / 2]), us(tt[(ticks * 99) / 100]), us(tt[ticks - 1]));
+
+	if (fp != stdout) {
+		fclose(fp);
+	}
+
+	free(tt);
+	free(tick_end);
+	free(stream);
+	exit_game();
+	map_exit();
+	sprite_config_shutdown();
+
+	return EXIT_SUCCESS;
+}
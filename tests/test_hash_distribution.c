@@ -42,7 +42,7 @@ static void build_valid_sprite_list(void)
 		unsigned int sprite_num = 0;
 		if (sscanf(name, "%u.png", &sprite_num) == 1) {
 			// Try to load it (validates PNG)
-			if (sdl_ic_load(sprite_num, NULL) >= 0) {
+			if (sdl_ic_load(sprite_num) >= 0) {
 				if (sdli[sprite_num].xres > 0 && sdli[sprite_num].yres > 0) {
 					valid_sprites[num_valid_sprites++] = sprite_num;
 				}
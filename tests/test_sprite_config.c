@@ -481,6 +481,90 @@ TEST(coverage_no_lighting_sprites)
         "No-lighting sprite count below minimum - possible data loss");
 }
 
+/* ========== Binary config tests ========== */
+
+#define TEST_BLOB_PATH "bin/test_sprite_config.bin"
+
+/* FNV-1a over every entry the lookups return, to compare JSON and blob */
+static uint64_t lookup_hash(void)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    const unsigned char *p;
+    size_t len, i;
+
+    for (unsigned int id = 0; id < 65536; id++) {
+        const CharacterVariant *c = sprite_config_lookup_character((int)id);
+        const AnimatedVariant *a = sprite_config_lookup_animated(id);
+        const SpriteMetadata *m = sprite_config_lookup_metadata(id);
+
+        if (c) {
+            for (p = (const unsigned char *)c, len = sizeof(*c), i = 0; i < len; i++) {
+                hash = (hash ^ p[i]) * 0x100000001b3ull;
+            }
+        }
+        if (a) {
+            for (p = (const unsigned char *)a, len = sizeof(*a), i = 0; i < len; i++) {
+                hash = (hash ^ p[i]) * 0x100000001b3ull;
+            }
+        }
+        if (m) {
+            for (p = (const unsigned char *)m, len = sizeof(*m), i = 0; i < len; i++) {
+                hash = (hash ^ p[i]) * 0x100000001b3ull;
+            }
+        }
+    }
+
+    return hash;
+}
+
+TEST(binary_config_round_trip)
+{
+    size_t json_chars, json_anims, bin_chars, bin_anims;
+    uint64_t json_hash;
+
+    ASSERT_EQ(0, sprite_config_compile(TEST_BLOB_PATH), "Compiling the blob should succeed");
+    sprite_config_get_stats(&json_chars, &json_anims);
+    json_hash = lookup_hash();
+
+    ASSERT_EQ(0, sprite_config_load_binary(TEST_BLOB_PATH), "Loading the fresh blob should succeed");
+    sprite_config_get_stats(&bin_chars, &bin_anims);
+    ASSERT_EQ(json_chars, bin_chars, "Character variant count should match JSON");
+    ASSERT_EQ(json_anims, bin_anims, "Animated variant count should match JSON");
+    ASSERT_TRUE(json_hash == lookup_hash(), "Every lookup should return the same entry as with JSON");
+}
+
+TEST(binary_config_rejects_garbage)
+{
+    FILE *f = fopen(TEST_BLOB_PATH, "wb");
+    ASSERT_TRUE(f != NULL, "Should be able to write test file");
+    fprintf(f, "this is not a sprite config blob, just some text that is long enough for a header");
+    fclose(f);
+
+    ASSERT_EQ(-1, sprite_config_load_binary(TEST_BLOB_PATH), "Garbage blob should be rejected");
+    ASSERT_EQ(-1, sprite_config_load_binary("bin/does_not_exist.bin"), "Missing blob should be rejected");
+    remove(TEST_BLOB_PATH);
+}
+
+TEST(binary_config_extend_at_runtime)
+{
+    const char *json = "{\"character_variants\": [{\"id\": 1000, \"base_sprite\": 8, \"scale\": 90}]}";
+    const CharacterVariant *v;
+
+    ASSERT_EQ(0, sprite_config_compile(TEST_BLOB_PATH), "Compiling the blob should succeed");
+    ASSERT_EQ(0, sprite_config_load_binary(TEST_BLOB_PATH), "Loading the fresh blob should succeed");
+    remove(TEST_BLOB_PATH);
+
+    /* Mods may add variants after startup, the blob is copied into the hash tables */
+    ASSERT_EQ(1, sprite_config_load_from_buffer(json, strlen(json)), "Buffer should add one variant");
+    v = sprite_config_lookup_character(1000);
+    ASSERT_TRUE(v != NULL, "Sprite 1000 should have the added variant");
+    ASSERT_EQ(90, v->scale, "Added variant should have scale 90");
+    v = sprite_config_lookup_character(121);
+    ASSERT_TRUE(v != NULL, "Sprite 121 should still have its variant");
+    ASSERT_EQ(8, v->base_sprite, "Sprite 121 should still map to base sprite 8");
+    ASSERT_TRUE(sprite_config_lookup_metadata(11104) != NULL, "Sprite 11104 should still have its metadata");
+}
+
 /* ========== Main test runner ========== */
 
 int main(int argc, char *argv[])
@@ -571,6 +655,12 @@ int main(int argc, char *argv[])
     RUN_TEST(coverage_no_lighting_sprites);
     printf("\n");
 
+    printf("[binary config]\n");
+    RUN_TEST(binary_config_round_trip);
+    RUN_TEST(binary_config_rejects_garbage);
+    RUN_TEST(binary_config_extend_at_runtime);
+    printf("\n");
+
     /* Cleanup */
     sprite_config_shutdown();
 
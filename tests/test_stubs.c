@@ -55,6 +55,15 @@ void warn(const char *format, ...)
 	fprintf(stderr, "\n");
 }
 
+void addline(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	vfprintf(stdout, format, args);
+	va_end(args);
+	fprintf(stdout, "\n");
+}
+
 // ============================================================================
 // Game state stubs
 // ============================================================================
@@ -67,13 +76,13 @@ int xmemcheck_failed = 0;
 // SDL worker thread globals (defined in sdl_core.c, not here)
 // extern SDL_AtomicInt worker_quit;
 // extern SDL_Thread **worker_threads;
-// extern struct zip_handles *worker_zips;
 
 // ============================================================================
 // Render stubs
 // ============================================================================
 
-void render_set_offset(int x __attribute__((unused)), int y __attribute__((unused)))
+// weak, the benchmarks that link render.c get the real one
+__attribute__((weak)) void render_set_offset(int x __attribute__((unused)), int y __attribute__((unused)))
 {
 	// No-op in tests
 }
@@ -118,12 +127,10 @@ void display_messagebox(const char *title __attribute__((unused)), const char *m
 // Random number stub
 // ============================================================================
 
-int rrand(int min, int max)
+// Same as main.c
+int rrand(int range)
 {
-	if (max <= min) {
-		return min;
-	}
-	return min + (rand() % (max - min + 1));
+	return rand() % range;
 }
 
 // ============================================================================
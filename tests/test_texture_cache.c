@@ -85,7 +85,7 @@ static void build_valid_sprite_list(void)
 
 			// Step 2: Try to actually load it with sdl_ic_load
 			// This validates the PNG can be decoded and has valid dimensions
-			if (sdl_ic_load(sprite_num, NULL) < 0) {
+			if (sdl_ic_load(sprite_num) < 0) {
 				filtered_load_failed++;
 				continue;
 			}
@@ -80,7 +80,7 @@ static void enumerate_valid_sprites(void)
 
 			// Step 2: Try to actually load it with sdl_ic_load
 			// This validates the PNG can be decoded and has valid dimensions
-			if (sdl_ic_load(sprite_num, NULL) < 0) {
+			if (sdl_ic_load(sprite_num) < 0) {
 				filtered_load_failed++;
 				continue;
 			}